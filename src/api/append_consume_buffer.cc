@@ -1,5 +1,6 @@
 #include "api/append_consume_buffer.h"
 
+#include <cstdio>
 #include <glm/vec4.hpp>
 #include "shaders/sparkle/interop.h"
 
@@ -17,15 +18,18 @@ void SwapUint(unsigned int &a, unsigned int &b) {
 
 /* -------------------------------------------------------------------------- */
 
+unsigned int const AppendConsumeBuffer::kReadbackRingSize;
+
+/* -------------------------------------------------------------------------- */
+
 void AppendConsumeBuffer::initialize() {
   /* Storage buffers */
-  glGenBuffers(2u, gl_storage_buffer_ids_);
-
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_storage_buffer_ids_[0u]);
-  glBufferStorage(GL_SHADER_STORAGE_BUFFER, storage_buffer_size_, nullptr, 0);
+  glGenBuffers(num_storage_buffers(), gl_storage_buffer_ids_);
 
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_storage_buffer_ids_[1u]);
-  glBufferStorage(GL_SHADER_STORAGE_BUFFER, storage_buffer_size_, nullptr, 0);
+  for (unsigned int i = 0u; i < num_storage_buffers(); ++i) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_storage_buffer_ids_[i]);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, storage_buffer_size_, nullptr, 0);
+  }
 
   /* Atomic Counter buffers */
   GLuint const default_values[2u] = {0u, 0u};
@@ -44,11 +48,38 @@ void AppendConsumeBuffer::initialize() {
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
   glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0u);
 
+  /* Readback ring, mapped once to be read whenever its fence is signaled. */
+  GLbitfield const readback_flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  GLsizeiptr const readback_size = kReadbackRingSize * sizeof(GLuint);
+  glGenBuffers(1u, &gl_readback_buffer_id_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, gl_readback_buffer_id_);
+  glBufferStorage(GL_COPY_WRITE_BUFFER, readback_size, nullptr, readback_flags);
+  readback_ptr_ = reinterpret_cast<GLuint const*>(
+    glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, readback_size, readback_flags)
+  );
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+
+  front_storage_index_ = 0u;
+  readback_first_ = 0u;
+  readback_pending_ = 0u;
+  has_readback_ = false;
+
   CHECKGLERROR();
 }
 
 void AppendConsumeBuffer::deinitialize() {
-  glDeleteBuffers(2u, gl_storage_buffer_ids_);
+  for (; readback_pending_ > 0u; --readback_pending_) {
+    glDeleteSync(readback_slots_[readback_first_].fence);
+    readback_first_ = (readback_first_ + 1u) % kReadbackRingSize;
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, gl_readback_buffer_id_);
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0u);
+  readback_ptr_ = nullptr;
+
+  glDeleteBuffers(1u, &gl_readback_buffer_id_);
+  glDeleteBuffers(num_storage_buffers(), gl_storage_buffer_ids_);
   glDeleteBuffers(2u, gl_atomic_buffer_ids_);
 
   CHECKGLERROR();
@@ -65,26 +96,26 @@ void AppendConsumeBuffer::unbind() {
 }
 
 void AppendConsumeBuffer::bind_attributes() {
-#if SPARKLE_USE_SOA_LAYOUT
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_A,  gl_storage_buffer_ids_[0u], 0*single_attrib_buffer_size_, single_attrib_buffer_size_);
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_VELOCITIES_A, gl_storage_buffer_ids_[0u], 1*single_attrib_buffer_size_, single_attrib_buffer_size_);
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_ATTRIBUTES_A, gl_storage_buffer_ids_[0u], 2*single_attrib_buffer_size_, single_attrib_buffer_size_);
+  bind_storage(0u, STORAGE_BINDING_PARTICLES_FIRST);
+  if (!single_storage_) {
+    bind_storage(1u, STORAGE_BINDING_PARTICLES_SECOND);
+  }
+}
 
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_B,  gl_storage_buffer_ids_[1u], 0*single_attrib_buffer_size_, single_attrib_buffer_size_);
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_VELOCITIES_B, gl_storage_buffer_ids_[1u], 1*single_attrib_buffer_size_, single_attrib_buffer_size_);
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_ATTRIBUTES_B, gl_storage_buffer_ids_[1u], 2*single_attrib_buffer_size_, single_attrib_buffer_size_);
-#else
-  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_FIRST, 2u, gl_storage_buffer_ids_);
-#endif
+void AppendConsumeBuffer::bind_storage(unsigned int const index, GLuint const binding) {
+  if (split_attributes_) {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding + 0u, gl_storage_buffer_ids_[index], 0*single_attrib_buffer_size_, single_attrib_buffer_size_);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding + 1u, gl_storage_buffer_ids_[index], 1*single_attrib_buffer_size_, single_attrib_buffer_size_);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding + 2u, gl_storage_buffer_ids_[index], 2*single_attrib_buffer_size_, single_attrib_buffer_size_);
+  } else {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, gl_storage_buffer_ids_[index]);
+  }
 }
 
 void AppendConsumeBuffer::unbind_attributes() {
-#if SPARKLE_USE_SOA_LAYOUT
-  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_A, attrib_buffer_count_, nullptr);
-  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_B, attrib_buffer_count_, nullptr);
-#else
-  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_FIRST, 2u, nullptr); //
-#endif
+  GLsizei const count = split_attributes_ ? attrib_buffer_count_ : 1u;
+  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_FIRST,  count, nullptr);
+  glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_SECOND, count, nullptr);
 }
 
 void AppendConsumeBuffer::bind_atomics() {
@@ -100,16 +131,14 @@ void AppendConsumeBuffer::swap_atomics() {
 }
 
 void AppendConsumeBuffer::swap_storage() {
-#if 1
-  // Costly but safe.
-  glCopyNamedBufferSubData(
-    gl_storage_buffer_ids_[1u], gl_storage_buffer_ids_[0u],
-    0u, 0u, storage_buffer_size_);
-#else
-  // Cheapest alternative but can makes some particle flicks
-  // due to non updated rendering params (workaround possible).
+  if (single_storage_) {
+    return;
+  }
+
+  // Ping-pong, anything sourcing the storage directly (eg. vertex arrays)
+  // has to follow front_storage_index().
   SwapUint(gl_storage_buffer_ids_[0u], gl_storage_buffer_ids_[1u]);
-#endif
+  front_storage_index_ ^= 1u;
 }
 
 unsigned int AppendConsumeBuffer::get_num_alive_particles_from_device() {
@@ -126,4 +155,65 @@ unsigned int AppendConsumeBuffer::get_num_alive_particles_from_device() {
   return num_alived_particles;
 }
 
+void AppendConsumeBuffer::readback_num_alive_particles(unsigned int const frame) {
+  /* Recycle the oldest slot when the ring is full. */
+  if (readback_pending_ == kReadbackRingSize) {
+    _receive_readback(true);
+  }
+  if (readback_pending_ == kReadbackRingSize) {
+    fprintf(stderr, "AppendConsumeBuffer: readback of frame %u skipped.\n", frame);
+    return;
+  }
+
+  unsigned int const slot = (readback_first_ + readback_pending_) % kReadbackRingSize;
+
+  /* The second counter holds the particles written by the simulation. */
+  glCopyNamedBufferSubData(
+    gl_atomic_buffer_ids_[1u], gl_readback_buffer_id_, 0u, slot * sizeof(GLuint), sizeof(GLuint)
+  );
+  readback_slots_[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readback_slots_[slot].frame = frame;
+  ++readback_pending_;
+
+  CHECKGLERROR();
+}
+
+bool AppendConsumeBuffer::latest_num_alive_particles(unsigned int &count, unsigned int &frame) {
+  _receive_readback(false);
+
+  count = readback_count_;
+  frame = readback_frame_;
+
+  return has_readback_;
+}
+
+// ----------------------------------------------------------------------------
+
+void AppendConsumeBuffer::_receive_readback(bool const wait) {
+  /* Slots are signaled in order, stop at the first one still in flight. */
+  GLuint64 const timeout = wait ? ~GLuint64(0u) : 0u;
+
+  while (readback_pending_ > 0u) {
+    auto &slot = readback_slots_[readback_first_];
+
+    GLenum const status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED)) {
+      break;
+    }
+    glDeleteSync(slot.fence);
+
+    readback_count_ = readback_ptr_[readback_first_];
+    readback_frame_ = slot.frame;
+    has_readback_ = true;
+
+    readback_first_ = (readback_first_ + 1u) % kReadbackRingSize;
+    --readback_pending_;
+
+    /* Only wait to free one slot. */
+    if (wait) {
+      break;
+    }
+  }
+}
+
 /* -------------------------------------------------------------------------- */
@@ -10,15 +10,36 @@
  */
 class AppendConsumeBuffer {
 public:
-  AppendConsumeBuffer(unsigned int const element_count, unsigned int const attrib_buffer_count)
+  /* Maximum number of counter readbacks in flight. */
+  static unsigned int const kReadbackRingSize = 3u;
+
+  /// @param split_attributes bind each vec4 attribute of the buffers to its
+  /// own binding (structure of arrays), instead of the whole buffers.
+  /// @param single_storage only allocate the first storage buffer, for pools
+  /// updating their particles in place. It is then never swapped.
+  AppendConsumeBuffer(unsigned int const element_count,
+                      unsigned int const attrib_buffer_count,
+                      bool const split_attributes = false,
+                      bool const single_storage = false)
     : element_count_(element_count),
 
       attrib_buffer_count_(attrib_buffer_count),
+      split_attributes_(split_attributes),
+      single_storage_(single_storage),
       single_attrib_buffer_size_(element_count_ * sizeof(float) * 4u), //
       storage_buffer_size_(single_attrib_buffer_size_ * attrib_buffer_count_), //
 
       gl_storage_buffer_ids_{0u, 0u},
-      gl_atomic_buffer_ids_{0u, 0u}
+      gl_atomic_buffer_ids_{0u, 0u},
+      front_storage_index_(0u),
+
+      gl_readback_buffer_id_(0u),
+      readback_ptr_(nullptr),
+      readback_first_(0u),
+      readback_pending_(0u),
+      readback_count_(0u),
+      readback_frame_(0u),
+      has_readback_(false)
   {}
 
   void initialize();
@@ -29,6 +50,10 @@ public:
 
   void bind_attributes();
   void unbind_attributes();
+
+  /// Bind the first (0) or second (1) storage buffer to the bindings of the
+  /// A or B particles, eg. to copy particles from another pool.
+  void bind_storage(unsigned int const index, GLuint const binding);
   void bind_atomics();
   void unbind_atomics();
 
@@ -36,16 +61,29 @@ public:
   void swap_storage();
 
 
+  /// Read the number of alive particles, stalling until the device is done.
   unsigned int get_num_alive_particles_from_device();
 
+  /// Copy the alive particles counter into the readback ring, tagged with a
+  /// frame index. Only stalls when kReadbackRingSize copies are in flight.
+  void readback_num_alive_particles(unsigned int const frame);
+
+  /// Retrieve the most recent counter value available without stalling and
+  /// the frame it was tagged with. Return false if none was received yet.
+  bool latest_num_alive_particles(unsigned int &count, unsigned int &frame);
+
   /* Getters */
   unsigned int element_count() const { return element_count_; }
   unsigned int single_attrib_buffer_size() const { return single_attrib_buffer_size_; }
   unsigned int storage_buffer_size() const { return storage_buffer_size_; }
+  unsigned int num_storage_buffers() const { return single_storage_ ? 1u : 2u; }
 
   GLuint first_storage_buffer_id() const { return gl_storage_buffer_ids_[0u]; }   //
   GLuint second_storage_buffer_id() const { return gl_storage_buffer_ids_[1u]; }  //
 
+  /// Index, in their initial order, of the storage buffer currently first.
+  unsigned int front_storage_index() const { return front_storage_index_; }
+
   GLuint first_atomic_buffer_id() const { return gl_atomic_buffer_ids_[0u]; }   //
   GLuint second_atomic_buffer_id() const { return gl_atomic_buffer_ids_[1u]; }  //
 
@@ -53,11 +91,29 @@ private:
   unsigned int const element_count_;                  //< number of elements in one buffer
 
   unsigned int const attrib_buffer_count_;
+  bool const split_attributes_;
+  bool const single_storage_;
   unsigned int const single_attrib_buffer_size_;
   unsigned int const storage_buffer_size_;            //< one buffer bytesize
 
   GLuint gl_storage_buffer_ids_[2u];                  //< ShaderStorage buffer (Append and Consume)
   GLuint gl_atomic_buffer_ids_[2u];                   //< AtomicCounter buffer (contains 2 atomic counter)
+  unsigned int front_storage_index_;                  //< flipped by each storage swap.
+
+  void _receive_readback(bool const wait);
+
+  struct {
+    GLsync fence;
+    unsigned int frame;
+  } readback_slots_[kReadbackRingSize];               //< in flight counter copies.
+
+  GLuint gl_readback_buffer_id_;                      //< persistently mapped counter copies.
+  GLuint const* readback_ptr_;
+  unsigned int readback_first_;                       //< oldest slot in flight.
+  unsigned int readback_pending_;                     //< number of slots in flight.
+  unsigned int readback_count_;                       //< last counter value received.
+  unsigned int readback_frame_;                       //< frame of the last value received.
+  bool has_readback_;
 };
 
 // ----------------------------------------------------------------------------
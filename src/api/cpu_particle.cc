@@ -0,0 +1,1113 @@
+#include "api/cpu_particle.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include "api/random.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SPARKLE_CPU_USE_SSE   1
+#include <emmintrin.h>
+#else
+#define SPARKLE_CPU_USE_SSE   0
+#endif
+
+/* ========================================================================== */
+
+unsigned int const CPUParticle::kDefaultMaxParticleCount;
+
+/* -------------------------------------------------------------------------- */
+
+namespace {
+
+float const kTwoPi       = 6.283185f;
+float const kGoldenAngle = 2.399963f;
+float const kEpsilon     = 1e-12f;
+
+/* -- Emitter distributions (see inc_math.glsl) -- */
+
+glm::vec3 DiskEvenDistribution(float const radius, unsigned int const id, unsigned int const total) {
+  float const theta = id * kGoldenAngle;
+  float const r = radius * std::sqrt(id / static_cast<float>(total));
+  return glm::vec3(r * std::cos(theta), 0.0f, r * std::sin(theta));
+}
+
+glm::vec3 SphereDistribution(float const radius, float const rx, float const ry) {
+  float const phi = kTwoPi * rx;
+  float const z = radius * (2.0f * ry - 1.0f);
+  float const r = std::sqrt(std::max(radius * radius - z * z, 0.0f));
+  return glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+glm::vec3 BallDistribution(float const radius, glm::vec3 const& rn) {
+  float const costheta = 2.0f * rn.x - 1.0f;
+  float const phi = kTwoPi * rn.y;
+  float const theta = std::acos(costheta);
+  float const r = radius * std::cbrt(rn.z);
+  float const s = std::sin(theta);
+  return r * glm::vec3(s * std::cos(phi), s * std::sin(phi), costheta);
+}
+
+/* -- Perlin noise (see inc_perlin.glsl and inc_perlin_3d.glsl) -- */
+
+float Mod289(float const x) {
+  return x - std::floor(x * (1.0f / 289.0f)) * 289.0f;
+}
+
+float Permute(float const x, float const permutation) {
+  return Mod289((x * 34.0f + 1.0f) * x + permutation);
+}
+
+float Fade(float const t) {
+  return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+/* Classical perlin noise, as pnoise, the permutation being offset by the
+ * seed of the run (see PerlinPermutationSeed). */
+float Perlin(glm::vec3 const& pt, float const permutation) {
+  glm::vec3 const ipt(std::floor(pt.x), std::floor(pt.y), std::floor(pt.z));
+  glm::vec3 const f0 = pt - ipt;
+  glm::vec3 const f1 = f0 - glm::vec3(1.0f);
+
+  float const ix[2] = { Mod289(ipt.x), Mod289(ipt.x + 1.0f) };
+  float const iy[2] = { Mod289(ipt.y), Mod289(ipt.y + 1.0f) };
+  float const iz[2] = { Mod289(ipt.z), Mod289(ipt.z + 1.0f) };
+  float const fx[2] = { f0.x, f1.x };
+  float const fy[2] = { f0.y, f1.y };
+  float const fz[2] = { f0.z, f1.z };
+
+  /* Gradients dot products, corner c being (c & 1, (c >> 1) & 1, c >> 2). */
+  float n[8u];
+  for (unsigned int c = 0u; c < 8u; ++c) {
+    unsigned int const bx = c & 1u;
+    unsigned int const by = (c >> 1u) & 1u;
+    unsigned int const bz = c >> 2u;
+
+    float const ixy = Permute(Permute(ix[bx], permutation) + iy[by], permutation);
+    float const h = Permute(ixy + iz[bz], permutation);
+
+    float gx = h * (1.0f / 7.0f);
+    float gy = std::floor(gx) * (1.0f / 7.0f);
+    gy = (gy - std::floor(gy)) - 0.5f;
+    gx = gx - std::floor(gx);
+    float const gz = 0.5f - std::abs(gx) - std::abs(gy);
+    if (gz <= 0.0f) {
+      gx -= (gx >= 0.0f) ? 0.5f : -0.5f;
+      gy -= (gy >= 0.0f) ? 0.5f : -0.5f;
+    }
+
+    float const norm = 1.0f / std::sqrt(gx*gx + gy*gy + gz*gz);
+    n[c] = (gx * norm) * fx[bx] + (gy * norm) * fy[by] + (gz * norm) * fz[bz];
+  }
+
+  float const ux = Fade(f0.x);
+  float const uy = Fade(f0.y);
+  float const uz = Fade(f0.z);
+  float const nxy0 = glm::mix(glm::mix(n[0u], n[1u], ux), glm::mix(n[2u], n[3u], ux), uy);
+  float const nxy1 = glm::mix(glm::mix(n[4u], n[5u], ux), glm::mix(n[6u], n[7u], ux), uy);
+
+  return glm::mix(nxy0, nxy1, uz);
+}
+
+/* -- Curl noise (see inc_curlnoise.glsl and inc_distance_func.glsl) -- */
+
+float SampleDistance(glm::vec3 const& p) {
+  return p.y;
+}
+
+float ComputeGradient(glm::vec3 const& p, glm::vec3 &normal) {
+  float const d = SampleDistance(p);
+  float const eps = 1e-2f;
+  normal.x = SampleDistance(p + glm::vec3(eps, 0.0f, 0.0f)) - d;
+  normal.y = SampleDistance(p + glm::vec3(0.0f, eps, 0.0f)) - d;
+  normal.z = SampleDistance(p + glm::vec3(0.0f, 0.0f, eps)) - d;
+  normal = glm::normalize(normal);
+  return d;
+}
+
+float Ramp(float const x) {
+  float const t = glm::clamp(0.5f * (x + 1.0f), 0.0f, 1.0f);
+  return 2.0f * (t * t * t * (10.0f + t * (-15.0f + 6.0f * t))) - 1.0f;
+}
+
+glm::vec3 Noise3d(glm::vec3 const& seed, float const permutation) {
+  return glm::vec3(
+    Perlin(seed, permutation),
+    Perlin(seed + glm::vec3(31.416f, -47.853f, 12.793f), permutation),
+    Perlin(seed + glm::vec3(-233.145f, -113.408f, -185.31f), permutation)
+  );
+}
+
+glm::vec3 SamplePotential(glm::vec3 const& p, float const permutation) {
+  unsigned int const num_octaves = 4u;
+
+  glm::vec3 psi(0.0f);
+  glm::vec3 normal;
+  float const distance = ComputeGradient(p, normal);
+
+  float noise_gain = 1.0f;
+  for (unsigned int i = 0u; i < num_octaves; ++i, noise_gain *= 0.5f) {
+    float const inv_noise_scale = 1.0f / noise_gain;
+    glm::vec3 const n = Noise3d(p * inv_noise_scale, permutation);
+
+    float const alpha = Ramp(std::abs(distance) * inv_noise_scale);
+    float const dp = glm::dot(psi, normal);
+    psi = glm::mix(dp * normal, psi, alpha);
+    psi += noise_gain * n;
+  }
+
+  return psi;
+}
+
+glm::vec3 ComputeCurl(glm::vec3 const& p, float const permutation) {
+  float const eps = 1e-4f;
+  glm::vec3 const dx(eps, 0.0f, 0.0f);
+  glm::vec3 const dy(0.0f, eps, 0.0f);
+  glm::vec3 const dz(0.0f, 0.0f, eps);
+
+  glm::vec3 const p00 = SamplePotential(p + dx, permutation);
+  glm::vec3 const p01 = SamplePotential(p - dx, permutation);
+  glm::vec3 const p10 = SamplePotential(p + dy, permutation);
+  glm::vec3 const p11 = SamplePotential(p - dy, permutation);
+  glm::vec3 const p20 = SamplePotential(p + dz, permutation);
+  glm::vec3 const p21 = SamplePotential(p - dz, permutation);
+
+  glm::vec3 v;
+  v.x = p11.z - p10.z - p21.y + p20.y;
+  v.y = p21.x - p20.x - p01.z + p00.z;
+  v.z = p01.y - p00.y - p11.x + p10.x;
+  return v / (2.0f * eps);
+}
+
+/* -- Integration kernels (see cs_simulation.glsl) -- */
+
+struct TIntegrationParams {
+  float time_step;
+  float velocity_factor;
+  float half_volume_size;
+  int bounding_volume;
+  bool enable_velocity_control;
+};
+
+struct TStreams {
+  float *px, *py, *pz;
+  float *vx, *vy, *vz;
+  float *rewind;
+  float *fx, *fy, *fz;
+};
+
+bool CollideAxis(float const c, float &p, float &v) {
+  if ((p < -c) || (p > c)) {
+    p = glm::clamp(p, -c, c);
+    v = -v;
+    return true;
+  }
+  return false;
+}
+
+void IntegrateScalar(TIntegrationParams const& k, TStreams const& s,
+                     unsigned int const first, unsigned int const last) {
+  float const dt = k.time_step;
+  float const r = k.half_volume_size;
+
+  for (unsigned int i = first; i < last; ++i) {
+    float vx = s.vx[i] + s.fx[i] * dt;
+    float vy = s.vy[i] + s.fy[i] * dt;
+    float vz = s.vz[i] + s.fz[i] * dt;
+
+    if (k.enable_velocity_control) {
+      float const d2 = std::max(vx*vx + vy*vy + vz*vz, kEpsilon);
+      float const scale = k.velocity_factor / std::sqrt(d2);
+      vx *= scale; vy *= scale; vz *= scale;
+    }
+
+    float px = s.px[i] + vx * dt;
+    float py = s.py[i] + vy * dt;
+    float pz = s.pz[i] + vz * dt;
+    bool collided = false;
+
+    if (k.bounding_volume == GPUParticle::VOLUME_SPHERE) {
+      float const d2 = px*px + py*py + pz*pz;
+      if (d2 > r*r) {
+        collided = true;
+        float const inv_length = 1.0f / std::sqrt(d2);
+        float const nx = -px * inv_length;
+        float const ny = -py * inv_length;
+        float const nz = -pz * inv_length;
+        float const vdn = 2.0f * (vx*nx + vy*ny + vz*nz);
+        vx -= vdn * nx; vy -= vdn * ny; vz -= vdn * nz;
+        px = -r * nx; py = -r * ny; pz = -r * nz;
+      }
+    } else if (k.bounding_volume == GPUParticle::VOLUME_BOX) {
+      collided |= CollideAxis(r, px, vx);
+      collided |= CollideAxis(r, py, vy);
+      collided |= CollideAxis(r, pz, vz);
+    }
+
+    s.px[i] = px; s.py[i] = py; s.pz[i] = pz;
+    s.vx[i] = vx; s.vy[i] = vy; s.vz[i] = vz;
+    s.rewind[i] = collided ? 0.0f : 1.0f;
+  }
+}
+
+#if SPARKLE_CPU_USE_SSE
+
+inline __m128 Select(__m128 const mask, __m128 const a, __m128 const b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline __m128 Dot3(__m128 const ax, __m128 const ay, __m128 const az,
+                   __m128 const bx, __m128 const by, __m128 const bz) {
+  return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+inline __m128 CollideAxisSSE(__m128 const r, __m128 const neg_r, __m128 const sign_mask,
+                             __m128 &p, __m128 &v) {
+  __m128 const outside = _mm_or_ps(_mm_cmplt_ps(p, neg_r), _mm_cmpgt_ps(p, r));
+  p = _mm_min_ps(_mm_max_ps(p, neg_r), r);
+  v = _mm_xor_ps(v, _mm_and_ps(outside, sign_mask));
+  return outside;
+}
+
+/* Process four particles per iteration, the remaining tail is left scalar. */
+void IntegrateSSE(TIntegrationParams const& k, TStreams const& s,
+                  unsigned int const first, unsigned int const last) {
+  __m128 const dt        = _mm_set1_ps(k.time_step);
+  __m128 const vfactor   = _mm_set1_ps(k.velocity_factor);
+  __m128 const eps       = _mm_set1_ps(kEpsilon);
+  __m128 const one       = _mm_set1_ps(1.0f);
+  __m128 const two       = _mm_set1_ps(2.0f);
+  __m128 const r         = _mm_set1_ps(k.half_volume_size);
+  __m128 const neg_r     = _mm_set1_ps(-k.half_volume_size);
+  __m128 const r2        = _mm_mul_ps(r, r);
+  __m128 const sign_mask = _mm_set1_ps(-0.0f);
+
+  unsigned int i = first;
+  for (; i + 4u <= last; i += 4u) {
+    __m128 vx = _mm_add_ps(_mm_loadu_ps(s.vx + i), _mm_mul_ps(_mm_loadu_ps(s.fx + i), dt));
+    __m128 vy = _mm_add_ps(_mm_loadu_ps(s.vy + i), _mm_mul_ps(_mm_loadu_ps(s.fy + i), dt));
+    __m128 vz = _mm_add_ps(_mm_loadu_ps(s.vz + i), _mm_mul_ps(_mm_loadu_ps(s.fz + i), dt));
+
+    if (k.enable_velocity_control) {
+      __m128 const d2 = _mm_max_ps(Dot3(vx, vy, vz, vx, vy, vz), eps);
+      __m128 const scale = _mm_div_ps(vfactor, _mm_sqrt_ps(d2));
+      vx = _mm_mul_ps(vx, scale);
+      vy = _mm_mul_ps(vy, scale);
+      vz = _mm_mul_ps(vz, scale);
+    }
+
+    __m128 px = _mm_add_ps(_mm_loadu_ps(s.px + i), _mm_mul_ps(vx, dt));
+    __m128 py = _mm_add_ps(_mm_loadu_ps(s.py + i), _mm_mul_ps(vy, dt));
+    __m128 pz = _mm_add_ps(_mm_loadu_ps(s.pz + i), _mm_mul_ps(vz, dt));
+    __m128 collided = _mm_setzero_ps();
+
+    if (k.bounding_volume == GPUParticle::VOLUME_SPHERE) {
+      __m128 const d2 = Dot3(px, py, pz, px, py, pz);
+      __m128 const outside = _mm_cmpgt_ps(d2, r2);
+      collided = outside;
+
+      if (_mm_movemask_ps(outside)) {
+        __m128 const inv_length = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(d2, eps)));
+        __m128 const nx = _mm_xor_ps(_mm_mul_ps(px, inv_length), sign_mask);
+        __m128 const ny = _mm_xor_ps(_mm_mul_ps(py, inv_length), sign_mask);
+        __m128 const nz = _mm_xor_ps(_mm_mul_ps(pz, inv_length), sign_mask);
+        __m128 const vdn = _mm_mul_ps(two, Dot3(vx, vy, vz, nx, ny, nz));
+
+        vx = Select(outside, _mm_sub_ps(vx, _mm_mul_ps(vdn, nx)), vx);
+        vy = Select(outside, _mm_sub_ps(vy, _mm_mul_ps(vdn, ny)), vy);
+        vz = Select(outside, _mm_sub_ps(vz, _mm_mul_ps(vdn, nz)), vz);
+        px = Select(outside, _mm_mul_ps(neg_r, nx), px);
+        py = Select(outside, _mm_mul_ps(neg_r, ny), py);
+        pz = Select(outside, _mm_mul_ps(neg_r, nz), pz);
+      }
+    } else if (k.bounding_volume == GPUParticle::VOLUME_BOX) {
+      collided = _mm_or_ps(collided, CollideAxisSSE(r, neg_r, sign_mask, px, vx));
+      collided = _mm_or_ps(collided, CollideAxisSSE(r, neg_r, sign_mask, py, vy));
+      collided = _mm_or_ps(collided, CollideAxisSSE(r, neg_r, sign_mask, pz, vz));
+    }
+
+    _mm_storeu_ps(s.px + i, px);
+    _mm_storeu_ps(s.py + i, py);
+    _mm_storeu_ps(s.pz + i, pz);
+    _mm_storeu_ps(s.vx + i, vx);
+    _mm_storeu_ps(s.vy + i, vy);
+    _mm_storeu_ps(s.vz + i, vz);
+    _mm_storeu_ps(s.rewind + i, _mm_andnot_ps(collided, one));
+  }
+
+  IntegrateScalar(k, s, i, last);
+}
+
+#endif  // SPARKLE_CPU_USE_SSE
+
+void Integrate(TIntegrationParams const& k, TStreams const& s,
+               unsigned int const first, unsigned int const last) {
+#if SPARKLE_CPU_USE_SSE
+  IntegrateSSE(k, s, first, last);
+#else
+  IntegrateScalar(k, s, first, last);
+#endif
+}
+
+/* -- Forces kernels (see cs_simulation.glsl) -- */
+
+struct TForcesParams {
+  bool enable_scattering;
+  float scattering_factor;
+  bool enable_curlnoise;
+  float curlnoise_factor;
+  float inv_curlnoise_scale;
+  float perlin_permutation;         //< see PerlinPermutationSeed.
+  unsigned int frame;
+  unsigned int seed;
+};
+
+glm::vec3 ScatteringForce(TForcesParams const& k, unsigned int const id) {
+  glm::vec3 const rn(Random4(id, k.frame, kRandomStreamScattering, k.seed));
+  return k.scattering_factor * (2.0f * rn - 1.0f);
+}
+
+void ForcesScalar(TForcesParams const& k, TStreams const& s,
+                  unsigned int const first, unsigned int const last) {
+  for (unsigned int i = first; i < last; ++i) {
+    glm::vec3 force(0.0f);
+    if (k.enable_scattering) {
+      force += ScatteringForce(k, i);
+    }
+    if (k.enable_curlnoise) {
+      glm::vec3 const p(s.px[i], s.py[i], s.pz[i]);
+      force += k.curlnoise_factor * ComputeCurl(p * k.inv_curlnoise_scale, k.perlin_permutation);
+    }
+
+    s.fx[i] = force.x;
+    s.fy[i] = force.y;
+    s.fz[i] = force.z;
+  }
+}
+
+#if SPARKLE_CPU_USE_SSE
+
+/* Four particles vectors, one per lane. */
+struct TVec3SSE {
+  __m128 x, y, z;
+};
+
+inline TVec3SSE Add(TVec3SSE const& a, TVec3SSE const& b) {
+  return { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) };
+}
+
+inline TVec3SSE Sub(TVec3SSE const& a, TVec3SSE const& b) {
+  return { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+}
+
+inline TVec3SSE Scale(TVec3SSE const& a, __m128 const s) {
+  return { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+}
+
+inline TVec3SSE Offset(TVec3SSE const& a, float const x, float const y, float const z) {
+  return { _mm_add_ps(a.x, _mm_set1_ps(x)), _mm_add_ps(a.y, _mm_set1_ps(y)), _mm_add_ps(a.z, _mm_set1_ps(z)) };
+}
+
+/* Valid for |x| < 2^31, as SSE2 has no rounding instruction. */
+inline __m128 FloorSSE(__m128 const x) {
+  __m128 const t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+inline __m128 FractSSE(__m128 const x) {
+  return _mm_sub_ps(x, FloorSSE(x));
+}
+
+inline __m128 Mod289SSE(__m128 const x) {
+  __m128 const m = _mm_set1_ps(289.0f);
+  return _mm_sub_ps(x, _mm_mul_ps(FloorSSE(_mm_mul_ps(x, _mm_set1_ps(1.0f / 289.0f))), m));
+}
+
+inline __m128 PermuteSSE(__m128 const x, __m128 const permutation) {
+  __m128 const t = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(34.0f)), _mm_set1_ps(1.0f));
+  return Mod289SSE(_mm_add_ps(_mm_mul_ps(t, x), permutation));
+}
+
+/* Perlin noise, as Perlin, with the eight corners of each lane cell evaluated
+ * in turn. */
+__m128 PerlinSSE(TVec3SSE const& p, __m128 const permutation) {
+  __m128 const zero     = _mm_setzero_ps();
+  __m128 const one      = _mm_set1_ps(1.0f);
+  __m128 const half     = _mm_set1_ps(0.5f);
+  __m128 const inv7     = _mm_set1_ps(1.0f / 7.0f);
+  __m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  TVec3SSE const pi0 = { FloorSSE(p.x), FloorSSE(p.y), FloorSSE(p.z) };
+  TVec3SSE const pf0 = Sub(p, pi0);
+  TVec3SSE const pf1 = Offset(pf0, -1.0f, -1.0f, -1.0f);
+
+  __m128 const ix[2] = { Mod289SSE(pi0.x), Mod289SSE(_mm_add_ps(pi0.x, one)) };
+  __m128 const iy[2] = { Mod289SSE(pi0.y), Mod289SSE(_mm_add_ps(pi0.y, one)) };
+  __m128 const iz[2] = { Mod289SSE(pi0.z), Mod289SSE(_mm_add_ps(pi0.z, one)) };
+  __m128 const fx[2] = { pf0.x, pf1.x };
+  __m128 const fy[2] = { pf0.y, pf1.y };
+  __m128 const fz[2] = { pf0.z, pf1.z };
+
+  /* Gradients dot products, corner c being (c & 1, (c >> 1) & 1, c >> 2). */
+  __m128 n[8u];
+  for (unsigned int c = 0u; c < 8u; ++c) {
+    unsigned int const bx = c & 1u;
+    unsigned int const by = (c >> 1u) & 1u;
+    unsigned int const bz = c >> 2u;
+
+    __m128 const ixy = PermuteSSE(_mm_add_ps(PermuteSSE(ix[bx], permutation), iy[by]), permutation);
+    __m128 const h = PermuteSSE(_mm_add_ps(ixy, iz[bz]), permutation);
+
+    __m128 gx = _mm_mul_ps(h, inv7);
+    __m128 gy = _mm_sub_ps(FractSSE(_mm_mul_ps(FloorSSE(gx), inv7)), half);
+    gx = FractSSE(gx);
+    __m128 const gz = _mm_sub_ps(_mm_sub_ps(half, _mm_and_ps(gx, abs_mask)), _mm_and_ps(gy, abs_mask));
+    __m128 const sz = _mm_cmple_ps(gz, zero);
+    __m128 const sx = Select(_mm_cmpge_ps(gx, zero), half, _mm_set1_ps(-0.5f));
+    __m128 const sy = Select(_mm_cmpge_ps(gy, zero), half, _mm_set1_ps(-0.5f));
+    gx = _mm_sub_ps(gx, _mm_and_ps(sz, sx));
+    gy = _mm_sub_ps(gy, _mm_and_ps(sz, sy));
+
+    __m128 const norm = _mm_div_ps(one, _mm_sqrt_ps(Dot3(gx, gy, gz, gx, gy, gz)));
+    n[c] = Dot3(_mm_mul_ps(gx, norm), _mm_mul_ps(gy, norm), _mm_mul_ps(gz, norm), fx[bx], fy[by], fz[bz]);
+  }
+
+  /* Quintic fade, then trilinear blend. */
+  auto const fade = [](__m128 const t) {
+    __m128 const u = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), u);
+  };
+  auto const mix = [](__m128 const a, __m128 const b, __m128 const t) {
+    return _mm_add_ps(a, _mm_mul_ps(t, _mm_sub_ps(b, a)));
+  };
+  __m128 const ux = fade(pf0.x);
+  __m128 const uy = fade(pf0.y);
+  __m128 const uz = fade(pf0.z);
+
+  __m128 const nxy0 = mix(mix(n[0u], n[1u], ux), mix(n[2u], n[3u], ux), uy);
+  __m128 const nxy1 = mix(mix(n[4u], n[5u], ux), mix(n[6u], n[7u], ux), uy);
+
+  return mix(nxy0, nxy1, uz);
+}
+
+TVec3SSE Noise3dSSE(TVec3SSE const& seed, __m128 const permutation) {
+  return {
+    PerlinSSE(seed, permutation),
+    PerlinSSE(Offset(seed, 31.416f, -47.853f, 12.793f), permutation),
+    PerlinSSE(Offset(seed, -233.145f, -113.408f, -185.31f), permutation)
+  };
+}
+
+TVec3SSE SamplePotentialSSE(TVec3SSE const& p, __m128 const permutation) {
+  unsigned int const num_octaves = 4u;
+  __m128 const zero     = _mm_setzero_ps();
+  __m128 const one      = _mm_set1_ps(1.0f);
+  __m128 const abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  /* Gradient of the distance field (see SampleDistance). */
+  float const eps = 1e-2f;
+  __m128 const distance = p.y;
+  TVec3SSE normal = {
+    _mm_sub_ps(p.y, distance),
+    _mm_sub_ps(_mm_add_ps(p.y, _mm_set1_ps(eps)), distance),
+    _mm_sub_ps(p.y, distance)
+  };
+  normal = Scale(normal, _mm_div_ps(one, _mm_sqrt_ps(Dot3(normal.x, normal.y, normal.z,
+                                                          normal.x, normal.y, normal.z))));
+  __m128 const abs_distance = _mm_and_ps(distance, abs_mask);
+
+  TVec3SSE psi = { zero, zero, zero };
+  float noise_gain = 1.0f;
+  for (unsigned int i = 0u; i < num_octaves; ++i, noise_gain *= 0.5f) {
+    __m128 const inv_noise_scale = _mm_set1_ps(1.0f / noise_gain);
+    TVec3SSE const n = Noise3dSSE(Scale(p, inv_noise_scale), permutation);
+
+    /* Ramp of the scaled distance. */
+    __m128 t = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_add_ps(_mm_mul_ps(abs_distance, inv_noise_scale), one));
+    t = _mm_min_ps(_mm_max_ps(t, zero), one);
+    __m128 const smooth = _mm_add_ps(_mm_set1_ps(10.0f), _mm_mul_ps(t, _mm_add_ps(_mm_set1_ps(-15.0f), _mm_mul_ps(t, _mm_set1_ps(6.0f)))));
+    __m128 const alpha = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(2.0f), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), smooth)), one);
+
+    __m128 const dp = Dot3(psi.x, psi.y, psi.z, normal.x, normal.y, normal.z);
+    TVec3SSE const projected = Scale(normal, dp);
+    psi = Add(projected, Scale(Sub(psi, projected), alpha));
+    psi = Add(psi, Scale(n, _mm_set1_ps(noise_gain)));
+  }
+
+  return psi;
+}
+
+TVec3SSE ComputeCurlSSE(TVec3SSE const& p, __m128 const permutation) {
+  float const eps = 1e-4f;
+
+  TVec3SSE const p00 = SamplePotentialSSE(Offset(p, +eps, 0.0f, 0.0f), permutation);
+  TVec3SSE const p01 = SamplePotentialSSE(Offset(p, -eps, 0.0f, 0.0f), permutation);
+  TVec3SSE const p10 = SamplePotentialSSE(Offset(p, 0.0f, +eps, 0.0f), permutation);
+  TVec3SSE const p11 = SamplePotentialSSE(Offset(p, 0.0f, -eps, 0.0f), permutation);
+  TVec3SSE const p20 = SamplePotentialSSE(Offset(p, 0.0f, 0.0f, +eps), permutation);
+  TVec3SSE const p21 = SamplePotentialSSE(Offset(p, 0.0f, 0.0f, -eps), permutation);
+
+  TVec3SSE const v = {
+    _mm_add_ps(_mm_sub_ps(_mm_sub_ps(p11.z, p10.z), p21.y), p20.y),
+    _mm_add_ps(_mm_sub_ps(_mm_sub_ps(p21.x, p20.x), p01.z), p00.z),
+    _mm_add_ps(_mm_sub_ps(_mm_sub_ps(p01.y, p00.y), p11.x), p10.x)
+  };
+  return Scale(v, _mm_set1_ps(1.0f / (2.0f * eps)));
+}
+
+/* Process four particles per iteration, the remaining tail is left scalar.
+ * The scattering hash stays scalar per lane, SSE2 lacking 32bit multiplies. */
+void ForcesSSE(TForcesParams const& k, TStreams const& s,
+               unsigned int const first, unsigned int const last) {
+  __m128 const zero = _mm_setzero_ps();
+  __m128 const inv_scale = _mm_set1_ps(k.inv_curlnoise_scale);
+  __m128 const curl_factor = _mm_set1_ps(k.curlnoise_factor);
+  __m128 const permutation = _mm_set1_ps(k.perlin_permutation);
+
+  unsigned int i = first;
+  for (; i + 4u <= last; i += 4u) {
+    TVec3SSE force = { zero, zero, zero };
+
+    if (k.enable_scattering) {
+      glm::vec3 const f0 = ScatteringForce(k, i + 0u);
+      glm::vec3 const f1 = ScatteringForce(k, i + 1u);
+      glm::vec3 const f2 = ScatteringForce(k, i + 2u);
+      glm::vec3 const f3 = ScatteringForce(k, i + 3u);
+      force.x = _mm_setr_ps(f0.x, f1.x, f2.x, f3.x);
+      force.y = _mm_setr_ps(f0.y, f1.y, f2.y, f3.y);
+      force.z = _mm_setr_ps(f0.z, f1.z, f2.z, f3.z);
+    }
+    if (k.enable_curlnoise) {
+      TVec3SSE const p = {
+        _mm_mul_ps(_mm_loadu_ps(s.px + i), inv_scale),
+        _mm_mul_ps(_mm_loadu_ps(s.py + i), inv_scale),
+        _mm_mul_ps(_mm_loadu_ps(s.pz + i), inv_scale)
+      };
+      force = Add(force, Scale(ComputeCurlSSE(p, permutation), curl_factor));
+    }
+
+    _mm_storeu_ps(s.fx + i, force.x);
+    _mm_storeu_ps(s.fy + i, force.y);
+    _mm_storeu_ps(s.fz + i, force.z);
+  }
+
+  ForcesScalar(k, s, i, last);
+}
+
+#endif  // SPARKLE_CPU_USE_SSE
+
+void ComputeForces(TForcesParams const& k, TStreams const& s,
+                   unsigned int const first, unsigned int const last) {
+#if SPARKLE_CPU_USE_SSE
+  ForcesSSE(k, s, first, last);
+#else
+  ForcesScalar(k, s, first, last);
+#endif
+}
+
+/* -- Compaction kernels -- */
+
+/* Attributes kept from a step to the next, the forces being recomputed. */
+unsigned int const kNumKeptAttribs = 9u;
+
+struct TCompactionStreams {
+  float const *src[kNumKeptAttribs];
+  float *dst[kNumKeptAttribs];
+  float const *age;                   //< source ages, particles with none left are dropped.
+};
+
+unsigned int CountAliveScalar(float const* age, unsigned int const first, unsigned int const last) {
+  unsigned int count = 0u;
+  for (unsigned int i = first; i < last; ++i) {
+    count += (age[i] > 0.0f) ? 1u : 0u;
+  }
+  return count;
+}
+
+/* Copy the survivors of [first, last) from write_index, in order. */
+void CompactScalar(TCompactionStreams const& s, unsigned int const first, unsigned int const last,
+                   unsigned int write_index) {
+  for (unsigned int i = first; i < last; ++i) {
+    if (s.age[i] <= 0.0f) {
+      continue;
+    }
+    for (unsigned int a = 0u; a < kNumKeptAttribs; ++a) {
+      s.dst[a][write_index] = s.src[a][i];
+    }
+    ++write_index;
+  }
+}
+
+#if SPARKLE_CPU_USE_SSE
+
+unsigned int const kMaskBitCount[16u] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+unsigned int CountAliveSSE(float const* age, unsigned int const first, unsigned int const last) {
+  __m128 const zero = _mm_setzero_ps();
+  unsigned int count = 0u;
+  unsigned int i = first;
+  for (; i + 4u <= last; i += 4u) {
+    count += kMaskBitCount[_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(age + i), zero))];
+  }
+  return count + CountAliveScalar(age, i, last);
+}
+
+/* Blocks of four survivors are copied whole, mixed ones lane by lane. */
+void CompactSSE(TCompactionStreams const& s, unsigned int const first, unsigned int const last,
+                unsigned int write_index) {
+  __m128 const zero = _mm_setzero_ps();
+  unsigned int i = first;
+  for (; i + 4u <= last; i += 4u) {
+    int const mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(s.age + i), zero));
+    if (mask == 0xf) {
+      for (unsigned int a = 0u; a < kNumKeptAttribs; ++a) {
+        _mm_storeu_ps(s.dst[a] + write_index, _mm_loadu_ps(s.src[a] + i));
+      }
+      write_index += 4u;
+    } else if (mask) {
+      CompactScalar(s, i, i + 4u, write_index);
+      write_index += kMaskBitCount[mask];
+    }
+  }
+
+  CompactScalar(s, i, last, write_index);
+}
+
+#endif  // SPARKLE_CPU_USE_SSE
+
+unsigned int CountAlive(float const* age, unsigned int const first, unsigned int const last) {
+#if SPARKLE_CPU_USE_SSE
+  return CountAliveSSE(age, first, last);
+#else
+  return CountAliveScalar(age, first, last);
+#endif
+}
+
+void Compact(TCompactionStreams const& s, unsigned int const first, unsigned int const last,
+             unsigned int const write_index) {
+#if SPARKLE_CPU_USE_SSE
+  CompactSSE(s, first, last, write_index);
+#else
+  CompactScalar(s, first, last, write_index);
+#endif
+}
+
+/* -- Vertex kernels, to the GPUParticle SoA layout -- */
+
+struct TVertexStreams {
+  float const *px, *py, *pz, *rewind;
+  float const *vx, *vy, *vz;
+  float const *start_age, *age;
+  glm::vec4 *positions, *velocities, *attributes;
+};
+
+void PackVerticesScalar(TVertexStreams const& s, unsigned int const first, unsigned int const last) {
+  for (unsigned int i = first; i < last; ++i) {
+    s.positions[i]  = glm::vec4(s.px[i], s.py[i], s.pz[i], s.rewind[i]);
+    s.velocities[i] = glm::vec4(s.vx[i], s.vy[i], s.vz[i], 0.0f);
+    s.attributes[i] = glm::vec4(s.start_age[i], s.age[i], 0.0f, 0.0f);
+  }
+}
+
+#if SPARKLE_CPU_USE_SSE
+
+/* Transpose four particles per iteration, the remaining tail is left scalar. */
+void PackVerticesSSE(TVertexStreams const& s, unsigned int const first, unsigned int const last) {
+  unsigned int i = first;
+  for (; i + 4u <= last; i += 4u) {
+    __m128 px = _mm_loadu_ps(s.px + i);
+    __m128 py = _mm_loadu_ps(s.py + i);
+    __m128 pz = _mm_loadu_ps(s.pz + i);
+    __m128 pw = _mm_loadu_ps(s.rewind + i);
+    _MM_TRANSPOSE4_PS(px, py, pz, pw);
+    float *positions = &s.positions[i].x;
+    _mm_storeu_ps(positions +  0, px);
+    _mm_storeu_ps(positions +  4, py);
+    _mm_storeu_ps(positions +  8, pz);
+    _mm_storeu_ps(positions + 12, pw);
+
+    __m128 vx = _mm_loadu_ps(s.vx + i);
+    __m128 vy = _mm_loadu_ps(s.vy + i);
+    __m128 vz = _mm_loadu_ps(s.vz + i);
+    __m128 vw = _mm_setzero_ps();
+    _MM_TRANSPOSE4_PS(vx, vy, vz, vw);
+    float *velocities = &s.velocities[i].x;
+    _mm_storeu_ps(velocities +  0, vx);
+    _mm_storeu_ps(velocities +  4, vy);
+    _mm_storeu_ps(velocities +  8, vz);
+    _mm_storeu_ps(velocities + 12, vw);
+
+    /* (start_age, age, 0, 0) per particle. */
+    __m128 const start_age = _mm_loadu_ps(s.start_age + i);
+    __m128 const age = _mm_loadu_ps(s.age + i);
+    __m128 const lo = _mm_unpacklo_ps(start_age, age);
+    __m128 const hi = _mm_unpackhi_ps(start_age, age);
+    __m128 const zero = _mm_setzero_ps();
+    float *attributes = &s.attributes[i].x;
+    _mm_storeu_ps(attributes +  0, _mm_movelh_ps(lo, zero));
+    _mm_storeu_ps(attributes +  4, _mm_movehl_ps(zero, lo));
+    _mm_storeu_ps(attributes +  8, _mm_movelh_ps(hi, zero));
+    _mm_storeu_ps(attributes + 12, _mm_movehl_ps(zero, hi));
+  }
+
+  PackVerticesScalar(s, i, last);
+}
+
+#endif  // SPARKLE_CPU_USE_SSE
+
+void PackVertices(TVertexStreams const& s, unsigned int const first, unsigned int const last) {
+#if SPARKLE_CPU_USE_SSE
+  PackVerticesSSE(s, first, last);
+#else
+  PackVerticesScalar(s, first, last);
+#endif
+}
+
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+
+void CPUParticle::TParticlePool::resize(unsigned int const count) {
+  for (auto *attrib : { &position_x, &position_y, &position_z,
+                        &velocity_x, &velocity_y, &velocity_z,
+                        &start_age, &age, &rewind,
+                        &force_x, &force_y, &force_z }) {
+    attrib->resize(count, 0.0f);
+  }
+}
+
+/* -------------------------------------------------------------------------- */
+
+void CPUParticle::init(unsigned int const max_particle_count) {
+  max_particle_count_ = max_particle_count;
+  batch_emit_count_   = std::max(256u, (max_particle_count_ >> 4u));
+
+  /* Worker threads. */
+  threads_.initialize();
+  unsigned int const num_chunks = threads_.num_threads();
+  fprintf(stderr, "[ %u particles, %u per batch, %u threads ]\n",
+    max_particle_count_, batch_emit_count_, num_chunks);
+
+  chunk_alive_counts_.resize(num_chunks, 0u);
+  frame_index_ = 0u;
+
+  /* Host storage. */
+  pool_.resize(max_particle_count_);
+  compacted_pool_.resize(max_particle_count_);
+  staging_.resize(3u * max_particle_count_);
+
+  /* Rendering shaders, shared with GPUParticle. */
+  char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
+  pgm_.render_point_sprite = CreateRenderProgram(
+    SHADERS_DIR "/sparkle/vs_generic.glsl",
+    SHADERS_DIR "/sparkle/fs_point_sprite.glsl",
+    src_buffer
+  );
+  pgm_.render_stretched_sprite = CreateRenderProgram(
+    SHADERS_DIR "/sparkle/vs_generic.glsl",
+    SHADERS_DIR "/sparkle/gs_stretched_sprite.glsl",
+    SHADERS_DIR "/sparkle/fs_stretched_sprite.glsl",
+    src_buffer
+  );
+  delete [] src_buffer;
+
+  ulocation_.render_point_sprite.mvp             = GetUniformLocation(pgm_.render_point_sprite, "uMVP");
+  ulocation_.render_point_sprite.minParticleSize = GetUniformLocation(pgm_.render_point_sprite, "uMinParticleSize");
+  ulocation_.render_point_sprite.maxParticleSize = GetUniformLocation(pgm_.render_point_sprite, "uMaxParticleSize");
+  ulocation_.render_point_sprite.colorMode       = GetUniformLocation(pgm_.render_point_sprite, "uColorMode");
+  ulocation_.render_point_sprite.birthGradient   = GetUniformLocation(pgm_.render_point_sprite, "uBirthGradient");
+  ulocation_.render_point_sprite.deathGradient   = GetUniformLocation(pgm_.render_point_sprite, "uDeathGradient");
+  ulocation_.render_point_sprite.fadeCoefficient = GetUniformLocation(pgm_.render_point_sprite, "uFadeCoefficient");
+  ulocation_.render_point_sprite.rewindTime      = GetUniformLocation(pgm_.render_point_sprite, "uRewindTime");
+
+  ulocation_.render_stretched_sprite.view            = GetUniformLocation(pgm_.render_stretched_sprite, "uView");
+  ulocation_.render_stretched_sprite.mvp             = GetUniformLocation(pgm_.render_stretched_sprite, "uMVP");
+  ulocation_.render_stretched_sprite.colorMode       = GetUniformLocation(pgm_.render_stretched_sprite, "uColorMode");
+  ulocation_.render_stretched_sprite.birthGradient   = GetUniformLocation(pgm_.render_stretched_sprite, "uBirthGradient");
+  ulocation_.render_stretched_sprite.deathGradient   = GetUniformLocation(pgm_.render_stretched_sprite, "uDeathGradient");
+  ulocation_.render_stretched_sprite.spriteStretchFactor = GetUniformLocation(pgm_.render_stretched_sprite, "uSpriteStretchFactor");
+  ulocation_.render_stretched_sprite.fadeCoefficient = GetUniformLocation(pgm_.render_stretched_sprite, "uFadeCoefficient");
+  ulocation_.render_stretched_sprite.rewindTime      = GetUniformLocation(pgm_.render_stretched_sprite, "uRewindTime");
+
+  _setup_render();
+
+  CHECKGLERROR();
+}
+
+void CPUParticle::deinit() {
+  threads_.deinitialize();
+
+  glDeleteProgram(pgm_.render_point_sprite);
+  glDeleteProgram(pgm_.render_stretched_sprite);
+  glDeleteBuffers(1u, &gl_particle_buffer_id_);
+  glDeleteVertexArrays(1u, &vao_);
+}
+
+void CPUParticle::update(float const dt, glm::mat4x4 const& view) {
+  /* Max number of particles able to be spawned. */
+  unsigned int const num_dead_particles = max_particle_count_ - num_alive_particles_;
+  /* Number of particles to be emitted. */
+  unsigned int const emit_count = std::min(batch_emit_count_, num_dead_particles);
+  /* Simulation deltatime depends on application framerate and the user input */
+  float const time_step = dt * simulation_params_.time_step_factor;
+
+  _emission(emit_count);
+  _simulation(time_step);
+  _upload();
+
+  ++frame_index_;
+}
+
+void CPUParticle::render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj) {
+  if (num_alive_particles_ == 0u) {
+    return;
+  }
+
+  switch(rendering_params_.rendermode) {
+    case GPUParticle::RENDERMODE_STRETCHED:
+      glUseProgram(pgm_.render_stretched_sprite);
+      glUniformMatrix4fv(ulocation_.render_stretched_sprite.view, 1, GL_FALSE, glm::value_ptr(view));
+      glUniformMatrix4fv(ulocation_.render_stretched_sprite.mvp,  1, GL_FALSE, glm::value_ptr(viewProj));
+      glUniform1f(ulocation_.render_stretched_sprite.colorMode, rendering_params_.colormode);
+      glUniform3fv(ulocation_.render_stretched_sprite.birthGradient, 1, rendering_params_.birth_gradient);
+      glUniform3fv(ulocation_.render_stretched_sprite.deathGradient, 1, rendering_params_.death_gradient);
+      glUniform1f(ulocation_.render_stretched_sprite.spriteStretchFactor, rendering_params_.stretched_factor);
+      glUniform1f(ulocation_.render_stretched_sprite.fadeCoefficient, rendering_params_.fading_factor);
+      glUniform1f(ulocation_.render_stretched_sprite.rewindTime, render_rewind_time_);
+    break;
+
+    case GPUParticle::RENDERMODE_POINTSPRITE:
+    default:
+      glUseProgram(pgm_.render_point_sprite);
+      glUniformMatrix4fv(ulocation_.render_point_sprite.mvp,  1, GL_FALSE, glm::value_ptr(viewProj));
+      glUniform1f(ulocation_.render_point_sprite.minParticleSize, rendering_params_.min_size);
+      glUniform1f(ulocation_.render_point_sprite.maxParticleSize, rendering_params_.max_size);
+      glUniform1f(ulocation_.render_point_sprite.colorMode, rendering_params_.colormode);
+      glUniform3fv(ulocation_.render_point_sprite.birthGradient, 1, rendering_params_.birth_gradient);
+      glUniform3fv(ulocation_.render_point_sprite.deathGradient, 1, rendering_params_.death_gradient);
+      glUniform1f(ulocation_.render_point_sprite.fadeCoefficient, rendering_params_.fading_factor);
+      glUniform1f(ulocation_.render_point_sprite.rewindTime, render_rewind_time_);
+    break;
+  }
+
+  glBindVertexArray(vao_);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(num_alive_particles_));
+  glBindVertexArray(0u);
+
+  glUseProgram(0u);
+
+  CHECKGLERROR();
+}
+
+// ----------------------------------------------------------------------------
+
+void CPUParticle::_setup_render() {
+  /* One vec4 stream per attribute, as the GPUParticle SoA layout. */
+  GLsizeiptr const stream_size = max_particle_count_ * sizeof(glm::vec4);
+
+  glGenBuffers(1u, &gl_particle_buffer_id_);
+  glBindBuffer(GL_ARRAY_BUFFER, gl_particle_buffer_id_);
+  glBufferStorage(GL_ARRAY_BUFFER, 3 * stream_size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  glBindBuffer(GL_ARRAY_BUFFER, 0u);
+
+  glGenVertexArrays(1u, &vao_);
+  glBindVertexArray(vao_);
+
+  // position and rewind weight, velocity, age attributes.
+  GLint const num_components[3u] = { 4, 3, 2 };
+  for (GLuint attrib_index = 0u; attrib_index < 3u; ++attrib_index) {
+    GLintptr const offset = attrib_index * stream_size;
+    glBindVertexBuffer(attrib_index, gl_particle_buffer_id_, offset, sizeof(glm::vec4));
+    glVertexAttribFormat(attrib_index, num_components[attrib_index], GL_FLOAT, GL_FALSE, 0);
+    glVertexAttribBinding(attrib_index, attrib_index);
+    glEnableVertexAttribArray(attrib_index);
+  }
+
+  glBindVertexArray(0u);
+
+  CHECKGLERROR();
+}
+
+void CPUParticle::_emission(unsigned int const count) {
+  if (!count) {
+    return;
+  }
+
+  SimulationParameters_t const& params = simulation_params_;
+  glm::vec3 const emitter_position(params.emitter_position[0u],
+                                   params.emitter_position[1u],
+                                   params.emitter_position[2u]);
+  glm::vec3 const emitter_direction(params.emitter_direction[0u],
+                                    params.emitter_direction[1u],
+                                    params.emitter_direction[2u]);
+  unsigned int const base_index = num_alive_particles_;
+  unsigned int const seed = static_cast<unsigned int>(params.random_seed);
+
+  threads_.parallel_for(count, [&](unsigned int first, unsigned int last, unsigned int) {
+    for (unsigned int gid = first; gid < last; ++gid) {
+      glm::vec4 const rn = Random4(gid, frame_index_, kRandomStreamEmission, seed);
+
+      glm::vec3 pos = emitter_position;
+      switch (params.emitter_type) {
+        case GPUParticle::EMITTER_DISK:
+          pos += DiskEvenDistribution(params.emitter_radius, gid, count);
+        break;
+
+        case GPUParticle::EMITTER_SPHERE:
+          pos += SphereDistribution(params.emitter_radius, rn.x, rn.y);
+        break;
+
+        case GPUParticle::EMITTER_BALL:
+          pos += BallDistribution(params.emitter_radius, glm::vec3(rn));
+        break;
+
+        case GPUParticle::EMITTER_POINT:
+        default:
+        break;
+      }
+
+      float const age = glm::mix(params.min_age, params.max_age, rn.w);
+
+      unsigned int const id = base_index + gid;
+      pool_.position_x[id] = pos.x;
+      pool_.position_y[id] = pos.y;
+      pool_.position_z[id] = pos.z;
+      pool_.velocity_x[id] = emitter_direction.x;
+      pool_.velocity_y[id] = emitter_direction.y;
+      pool_.velocity_z[id] = emitter_direction.z;
+      pool_.start_age[id]  = age;
+      pool_.age[id]        = age;
+      pool_.rewind[id]     = 1.0f;
+    }
+  });
+
+  num_alive_particles_ += count;
+}
+
+void CPUParticle::_simulation(float const time_step) {
+  if (num_alive_particles_ == 0u) {
+    return;
+  }
+
+  SimulationParameters_t const& params = simulation_params_;
+
+  TIntegrationParams kernel_params;
+  kernel_params.time_step               = time_step;
+  kernel_params.velocity_factor         = params.velocity_factor;
+  kernel_params.half_volume_size        = 0.5f * params.bounding_volume_size;
+  kernel_params.bounding_volume         = params.bounding_volume;
+  kernel_params.enable_velocity_control = params.enable_velocity_control;
+
+  TStreams streams;
+  streams.px = pool_.position_x.data();
+  streams.py = pool_.position_y.data();
+  streams.pz = pool_.position_z.data();
+  streams.vx = pool_.velocity_x.data();
+  streams.vy = pool_.velocity_y.data();
+  streams.vz = pool_.velocity_z.data();
+  streams.rewind = pool_.rewind.data();
+  streams.fx = pool_.force_x.data();
+  streams.fy = pool_.force_y.data();
+  streams.fz = pool_.force_z.data();
+
+  TForcesParams forces_params;
+  forces_params.enable_scattering   = params.enable_scattering;
+  forces_params.scattering_factor   = params.scattering_factor;
+  forces_params.enable_curlnoise    = params.enable_curlnoise;
+  forces_params.curlnoise_factor    = params.curlnoise_factor;
+  forces_params.inv_curlnoise_scale = 1.0f / params.curlnoise_scale;
+  forces_params.perlin_permutation  = static_cast<float>(PerlinPermutationSeed(params.random_seed));
+  forces_params.frame               = frame_index_;
+  forces_params.seed                = static_cast<unsigned int>(params.random_seed);
+
+  threads_.parallel_for(num_alive_particles_, [&](unsigned int first, unsigned int last, unsigned int chunk_id) {
+
+    /* 1) Update ages and calculate external forces. */
+    for (unsigned int i = first; i < last; ++i) {
+      pool_.age[i] = glm::clamp(pool_.age[i] - time_step, 0.0f, pool_.start_age[i]);
+    }
+    ComputeForces(forces_params, streams, first, last);
+
+    /* 2) Integrate velocities, positions and handle collisions. */
+    Integrate(kernel_params, streams, first, last);
+
+    /* 3) Count the surviving particles of the chunk. */
+    chunk_alive_counts_[chunk_id] = CountAlive(pool_.age.data(), first, last);
+  });
+
+  _compaction();
+}
+
+void CPUParticle::_compaction() {
+  /* Offsets of each chunk survivors in the compacted pool. */
+  unsigned int num_alive = 0u;
+  for (auto &count : chunk_alive_counts_) {
+    unsigned int const chunk_count = count;
+    count = num_alive;
+    num_alive += chunk_count;
+  }
+
+  /* Chunks gather their survivors in parallel, into the other pool. */
+  TCompactionStreams streams;
+  float const* src[kNumKeptAttribs] = {
+    pool_.position_x.data(), pool_.position_y.data(), pool_.position_z.data(),
+    pool_.velocity_x.data(), pool_.velocity_y.data(), pool_.velocity_z.data(),
+    pool_.start_age.data(), pool_.age.data(), pool_.rewind.data()
+  };
+  float* dst[kNumKeptAttribs] = {
+    compacted_pool_.position_x.data(), compacted_pool_.position_y.data(), compacted_pool_.position_z.data(),
+    compacted_pool_.velocity_x.data(), compacted_pool_.velocity_y.data(), compacted_pool_.velocity_z.data(),
+    compacted_pool_.start_age.data(), compacted_pool_.age.data(), compacted_pool_.rewind.data()
+  };
+  std::copy(src, src + kNumKeptAttribs, streams.src);
+  std::copy(dst, dst + kNumKeptAttribs, streams.dst);
+  streams.age = pool_.age.data();
+
+  threads_.parallel_for(num_alive_particles_, [&](unsigned int first, unsigned int last, unsigned int chunk_id) {
+    Compact(streams, first, last, chunk_alive_counts_[chunk_id]);
+  });
+
+  std::swap(pool_, compacted_pool_);
+  num_alive_particles_ = num_alive;
+}
+
+void CPUParticle::_upload() {
+  if (num_alive_particles_ == 0u) {
+    return;
+  }
+
+  glm::vec4 *positions  = staging_.data();
+  glm::vec4 *velocities = positions  + max_particle_count_;
+  glm::vec4 *attributes = velocities + max_particle_count_;
+
+  TVertexStreams streams;
+  streams.px         = pool_.position_x.data();
+  streams.py         = pool_.position_y.data();
+  streams.pz         = pool_.position_z.data();
+  streams.rewind     = pool_.rewind.data();
+  streams.vx         = pool_.velocity_x.data();
+  streams.vy         = pool_.velocity_y.data();
+  streams.vz         = pool_.velocity_z.data();
+  streams.start_age  = pool_.start_age.data();
+  streams.age        = pool_.age.data();
+  streams.positions  = positions;
+  streams.velocities = velocities;
+  streams.attributes = attributes;
+
+  threads_.parallel_for(num_alive_particles_, [&](unsigned int first, unsigned int last, unsigned int) {
+    PackVertices(streams, first, last);
+  });
+
+  GLsizeiptr const stream_size = max_particle_count_ * sizeof(glm::vec4);
+  GLsizeiptr const upload_size = num_alive_particles_ * sizeof(glm::vec4);
+  glNamedBufferSubData(gl_particle_buffer_id_, 0 * stream_size, upload_size, positions);
+  glNamedBufferSubData(gl_particle_buffer_id_, 1 * stream_size, upload_size, velocities);
+  glNamedBufferSubData(gl_particle_buffer_id_, 2 * stream_size, upload_size, attributes);
+
+  CHECKGLERROR();
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,134 @@
+#ifndef API_CPU_PARTICLE_H
+#define API_CPU_PARTICLE_H
+
+/* -------------------------------------------------------------------------- */
+
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include "opengl.h"
+#include "api/gpu_particle.h"
+#include "api/thread_pool.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief The CPUParticle class
+ *
+ * Host fallback of GPUParticle, sharing its parameters and its rendering
+ * shaders. Particles are stored as a Structure of Arrays simulated by a
+ * thread pool, each worker running SIMD kernels on its own chunk.
+ *
+ * @note The vector field force and back-to-front sorting are not supported,
+ * curl noise always uses finite differences whatever its curlnoise_method.
+ */
+class CPUParticle
+{
+public:
+  using SimulationParameters_t = GPUParticle::SimulationParameters_t;
+  using RenderingParameters_t  = GPUParticle::RenderingParameters_t;
+
+  static unsigned int const kDefaultMaxParticleCount = (1u << 18u);
+
+  CPUParticle() :
+    max_particle_count_(0u),
+    batch_emit_count_(0u),
+    num_alive_particles_(0u),
+    frame_index_(0u),
+    render_rewind_time_(0.0f),
+    gl_particle_buffer_id_(0u),
+    vao_(0u)
+  {}
+
+  void init(unsigned int const max_particle_count = kDefaultMaxParticleCount);
+  void deinit();
+
+  void update(float const dt, glm::mat4x4 const& view);
+  void render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj);
+
+  inline SimulationParameters_t& simulation_parameters() {
+   return simulation_params_;
+  }
+
+  inline RenderingParameters_t& rendering_parameters() {
+   return rendering_params_;
+  }
+
+  inline unsigned int num_alive_particles() const {
+    return num_alive_particles_;
+  }
+
+  /// Simulation time rendered particles are moved back by.
+  /// @see GPUParticle::end_frame
+  inline void set_render_rewind_time(float const time) { render_rewind_time_ = time; }
+
+private:
+  /* Structure of Arrays particle storage. */
+  struct TParticlePool {
+    void resize(unsigned int const count);
+
+    std::vector<float> position_x, position_y, position_z;
+    std::vector<float> velocity_x, velocity_y, velocity_z;
+    std::vector<float> start_age, age;
+    std::vector<float> rewind;      //< 1 when the last step can be rendered backward, 0 after a bounce.
+
+    /* Per particle forces, written before the integration kernel. */
+    std::vector<float> force_x, force_y, force_z;
+  };
+
+  void _setup_render();
+
+  void _emission(unsigned int const count);
+  void _simulation(float const time_step);
+  void _compaction();
+  void _upload();
+
+  SimulationParameters_t simulation_params_;
+  RenderingParameters_t rendering_params_;
+
+  unsigned int max_particle_count_;               //< pool capacity.
+  unsigned int batch_emit_count_;                 //< max number of particles emitted per frame.
+  unsigned int num_alive_particles_;              //< particles stored at the front of the pool.
+  unsigned int frame_index_;                      //< updates counter, keys the random numbers.
+  float render_rewind_time_;                      //< time back from the last state when rendering.
+
+  TParticlePool pool_;                            //< Particles attributes.
+  TParticlePool compacted_pool_;                  //< Survivors of the last step, swapped with pool_.
+  ThreadPool threads_;                            //< Workers running the kernels.
+  std::vector<unsigned int> chunk_alive_counts_;  //< Survivors per chunk, then their offset in the compacted pool.
+  std::vector<glm::vec4> staging_;                //< Vertex data, packed as GPUParticle SoA layout.
+
+  struct {
+    GLuint render_point_sprite;
+    GLuint render_stretched_sprite;
+  } pgm_;                                         //< Rendering shaders.
+
+  struct {
+    struct {
+      GLint mvp;
+      GLint minParticleSize;
+      GLint maxParticleSize;
+      GLint colorMode;
+      GLint birthGradient;
+      GLint deathGradient;
+      GLint fadeCoefficient;
+      GLint rewindTime;
+    } render_point_sprite;
+    struct {
+      GLint view;
+      GLint mvp;
+      GLint colorMode;
+      GLint birthGradient;
+      GLint deathGradient;
+      GLint spriteStretchFactor;
+      GLint fadeCoefficient;
+      GLint rewindTime;
+    } render_stretched_sprite;
+  } ulocation_;                                   //< Programs uniform location.
+
+  GLuint gl_particle_buffer_id_;                  //< Vertex buffer updated each frame.
+  GLuint vao_;                                    //< VAO for rendering.
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif // API_CPU_PARTICLE_H
@@ -0,0 +1,142 @@
+#include "api/cpu_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+/* -------------------------------------------------------------------------- */
+
+namespace {
+
+struct TraceEvent_t {
+  char const* name;
+  uint64_t start_ns;
+  uint64_t end_ns;
+};
+
+/* Written by its thread only, the count publishes the events to the dump. */
+struct ThreadBuffer_t {
+  TraceEvent_t events[CPU_TRACE_MAX_EVENTS];
+  std::atomic<unsigned int> count;
+};
+
+std::chrono::steady_clock::time_point const s_epoch = std::chrono::steady_clock::now();
+
+std::atomic<bool> s_enabled(false);
+std::atomic<unsigned int> s_num_threads(0u);
+std::atomic<unsigned int> s_num_dropped(0u);
+
+/// Buffers are kept until exit, so that finished threads can still be dumped.
+std::atomic<ThreadBuffer_t*> s_buffers[CPU_TRACE_MAX_THREADS];
+
+thread_local ThreadBuffer_t *t_buffer = nullptr;
+thread_local bool t_registered = false;
+
+ThreadBuffer_t* GetThreadBuffer() {
+  if (t_registered) {
+    return t_buffer;
+  }
+  t_registered = true;
+
+  unsigned int const index = s_num_threads.fetch_add(1u);
+  if (index >= CPU_TRACE_MAX_THREADS) {
+    fprintf(stderr, "CPUTrace : more than %u threads, zones are ignored.\n", CPU_TRACE_MAX_THREADS);
+    return nullptr;
+  }
+
+  t_buffer = new ThreadBuffer_t();
+  t_buffer->count.store(0u, std::memory_order_relaxed);
+  s_buffers[index].store(t_buffer, std::memory_order_release);
+
+  return t_buffer;
+}
+
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+
+void EnableCPUTrace(bool status) {
+  s_enabled.store(status, std::memory_order_relaxed);
+}
+
+bool IsCPUTraceEnabled() {
+  return s_enabled.load(std::memory_order_relaxed);
+}
+
+bool DumpCPUTrace(char const* filename) {
+  FILE *fd = fopen(filename, "w");
+  if (!fd) {
+    fprintf(stderr, "CPUTrace : can't write \"%s\".\n", filename);
+    return false;
+  }
+
+  fprintf(fd, "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [\n");
+  char const* separator = "";
+
+  unsigned int const num_threads = std::min(s_num_threads.load(), CPU_TRACE_MAX_THREADS);
+  for (unsigned int tid = 0u; tid < num_threads; ++tid) {
+    ThreadBuffer_t const* buffer = s_buffers[tid].load(std::memory_order_acquire);
+    if (!buffer) {
+      continue;
+    }
+
+    unsigned int const count = buffer->count.load(std::memory_order_acquire);
+    for (unsigned int i = 0u; i < count; ++i) {
+      TraceEvent_t const& e = buffer->events[i];
+      fprintf(fd, "%s    { \"name\": \"%s\", \"cat\": \"cpu\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f }",
+        separator, e.name, tid, 1.0e-3 * e.start_ns, 1.0e-3 * (e.end_ns - e.start_ns)
+      );
+      separator = ",\n";
+    }
+  }
+  fprintf(fd, "\n  ]\n}\n");
+  fclose(fd);
+
+  return true;
+}
+
+void ClearCPUTrace() {
+  unsigned int const num_threads = std::min(s_num_threads.load(), CPU_TRACE_MAX_THREADS);
+  for (unsigned int tid = 0u; tid < num_threads; ++tid) {
+    ThreadBuffer_t *buffer = s_buffers[tid].load(std::memory_order_acquire);
+    if (buffer) {
+      buffer->count.store(0u, std::memory_order_relaxed);
+    }
+  }
+  s_num_dropped.store(0u, std::memory_order_relaxed);
+}
+
+unsigned int GetCPUTraceDroppedCount() {
+  return s_num_dropped.load(std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+
+uint64_t const CPUTraceZone::kDisabled;
+
+uint64_t CPUTraceZone::Now() {
+  auto const elapsed = std::chrono::steady_clock::now() - s_epoch;
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void CPUTraceZone::Record(char const* name, uint64_t const start_ns, uint64_t const end_ns) {
+  ThreadBuffer_t *buffer = GetThreadBuffer();
+  if (!buffer) {
+    return;
+  }
+
+  unsigned int const index = buffer->count.load(std::memory_order_relaxed);
+  if (index >= CPU_TRACE_MAX_EVENTS) {
+    s_num_dropped.fetch_add(1u, std::memory_order_relaxed);
+    return;
+  }
+
+  TraceEvent_t &e = buffer->events[index];
+  e.name = name;
+  e.start_ns = start_ns;
+  e.end_ns = end_ns;
+  buffer->count.store(index + 1u, std::memory_order_release);
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,77 @@
+#ifndef API_CPU_TRACE_H_
+#define API_CPU_TRACE_H_
+
+#include <cstdint>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * CPU side frame profiling, as Chrome trace events (chrome://tracing, Perfetto).
+ *
+ * Zones are declared with CPU_TRACE_SCOPE("name") and recorded, when tracing
+ * is enabled at runtime, into a fixed buffer owned by the calling thread :
+ * recording takes no lock, and zone names must be string literals.
+ *
+ * Zones are compiled out completely when USE_CPU_TRACE is not defined.
+ */
+
+/* Maximum number of threads recording zones. */
+#define CPU_TRACE_MAX_THREADS         64u
+/* Zones kept per thread, further ones are dropped. */
+#define CPU_TRACE_MAX_EVENTS          (1u << 16u)
+
+// ----------------------------------------------------------------------------
+
+void EnableCPUTrace(bool status);
+bool IsCPUTraceEnabled();
+
+/// Write the recorded zones as Chrome trace JSON, return false on failure.
+/// @note Dump and Clear are meant to be called between frames, by the main thread.
+bool DumpCPUTrace(char const* filename);
+void ClearCPUTrace();
+
+/// Zones dropped because their thread buffer was full.
+unsigned int GetCPUTraceDroppedCount();
+
+// ----------------------------------------------------------------------------
+
+class CPUTraceZone {
+ public:
+  explicit CPUTraceZone(char const* name)
+    : name_(name),
+      start_ns_(IsCPUTraceEnabled() ? Now() : kDisabled)
+  {}
+
+  ~CPUTraceZone() {
+    if (start_ns_ != kDisabled) {
+      Record(name_, start_ns_, Now());
+    }
+  }
+
+  CPUTraceZone(CPUTraceZone const&) = delete;
+  CPUTraceZone& operator=(CPUTraceZone const&) = delete;
+
+ private:
+  static uint64_t const kDisabled = ~uint64_t(0u);
+
+  static uint64_t Now();
+  static void Record(char const* name, uint64_t const start_ns, uint64_t const end_ns);
+
+  char const* name_;
+  uint64_t const start_ns_;
+};
+
+// ----------------------------------------------------------------------------
+
+#define CPU_TRACE_CONCAT_(a, b)       a##b
+#define CPU_TRACE_CONCAT(a, b)        CPU_TRACE_CONCAT_(a, b)
+
+#if USE_CPU_TRACE
+# define CPU_TRACE_SCOPE(name)        CPUTraceZone const CPU_TRACE_CONCAT(cpu_trace_zone_, __LINE__)(name)
+#else
+# define CPU_TRACE_SCOPE(name)
+#endif
+
+/* -------------------------------------------------------------------------- */
+
+#endif  // API_CPU_TRACE_H_
@@ -0,0 +1,115 @@
+#include "api/curl_noise_field.h"
+
+#include <algorithm>
+#include "shaders/sparkle/interop.h"
+
+/* -------------------------------------------------------------------------- */
+
+unsigned int const CurlNoiseField::kMinResolution;
+unsigned int const CurlNoiseField::kMaxResolution;
+
+/* -------------------------------------------------------------------------- */
+
+void CurlNoiseField::initialize() {
+  char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
+  pgm_ = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_bake_curlnoise.glsl", src_buffer);
+  delete [] src_buffer;
+
+  ulocation_.extent         = GetUniformLocation(pgm_, "uExtent");
+  ulocation_.curlNoiseScale = GetUniformLocation(pgm_, "uCurlNoiseScale");
+  ulocation_.perlinNoisePermutationSeed = GetUniformLocation(pgm_, "uPerlinNoisePermutationSeed");
+
+  CHECKGLERROR();
+}
+
+void CurlNoiseField::deinitialize() {
+  glDeleteProgram(pgm_);
+  glDeleteTextures(1u, &gl_texture_id_);
+
+  gl_texture_id_ = 0u;
+  resolution_ = 0u;
+  outdated_ = true;
+}
+
+void CurlNoiseField::set_permutation_seed(int const permutation_seed) {
+  glProgramUniform1i(pgm_, ulocation_.perlinNoisePermutationSeed, permutation_seed);
+  outdated_ = true;
+}
+
+bool CurlNoiseField::outdated(unsigned int const resolution, float const extent, float const scale) const {
+  return outdated_
+      || (_round_resolution(resolution) != resolution_)
+      || (extent != extent_)
+      || (scale != scale_);
+}
+
+bool CurlNoiseField::update(unsigned int const resolution, float const extent, float const scale) {
+  if (!outdated(resolution, extent, scale)) {
+    return false;
+  }
+
+  unsigned int const res = _round_resolution(resolution);
+
+  if (res != resolution_) {
+    _allocate_texture(res);
+  }
+  extent_ = extent;
+  scale_ = scale;
+  outdated_ = false;
+
+  _bake();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned int CurlNoiseField::_round_resolution(unsigned int const resolution) {
+  /* Keep the resolution a multiple of the kernel width. */
+  unsigned int const kGroupWidth = CURLNOISE_BAKE_GROUP_WIDTH;
+  unsigned int const res = std::max(kMinResolution, std::min(resolution, kMaxResolution));
+  return kGroupWidth * ((res + kGroupWidth - 1u) / kGroupWidth);
+}
+
+void CurlNoiseField::_allocate_texture(unsigned int const resolution) {
+  /* Texture storage is immutable, so it is recreated on resize. */
+  if (gl_texture_id_) {
+    glDeleteTextures(1u, &gl_texture_id_);
+  }
+  resolution_ = resolution;
+
+  GLsizei const res = static_cast<GLsizei>(resolution_);
+
+  glGenTextures(1u, &gl_texture_id_);
+  glBindTexture(GL_TEXTURE_3D, gl_texture_id_);
+    glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, res, res, res);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_3D, 0u);
+
+  CHECKGLERROR();
+}
+
+void CurlNoiseField::_bake() {
+  unsigned int const ngroups = resolution_ / CURLNOISE_BAKE_GROUP_WIDTH;
+
+  glBindImageTexture(IMAGE_BINDING_CURLNOISE, gl_texture_id_, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+  glUseProgram(pgm_);
+  {
+    glUniform1f(ulocation_.extent, extent_);
+    glUniform1f(ulocation_.curlNoiseScale, scale_);
+    glDispatchCompute(ngroups, ngroups, ngroups);
+  }
+  glUseProgram(0u);
+  glBindImageTexture(IMAGE_BINDING_CURLNOISE, 0u, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+  /* Make the texels visible to the simulation kernel fetches. */
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  CHECKGLERROR();
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,74 @@
+#ifndef API_CURL_NOISE_FIELD_H_
+#define API_CURL_NOISE_FIELD_H_
+
+#include "opengl.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Curl noise baked on device into a 3D texture centered at the origin.
+ *
+ * The field is only recomputed when its parameters change, so it suits scenes
+ * where the noise is static. Particles outside the baked volume sample the
+ * closest border values.
+ */
+class CurlNoiseField {
+ public:
+  static unsigned int const kMinResolution = 16u;
+  static unsigned int const kMaxResolution = 256u;
+
+  CurlNoiseField()
+    : pgm_(0u),
+      gl_texture_id_(0u),
+      resolution_(0u),
+      extent_(0.0f),
+      scale_(0.0f),
+      outdated_(true)
+  {}
+
+  void initialize();
+  void deinitialize();
+
+  /// Set the perlin noise permutation, which must match the simulation one,
+  /// the field being rebaked by the next update.
+  void set_permutation_seed(int const permutation_seed);
+
+  /// Return true if update would rebake the field for these parameters.
+  bool outdated(unsigned int const resolution, float const extent, float const scale) const;
+
+  /// Bake the curl noise over [-extent, extent]^3 when the parameters differ
+  /// from the last bake, scale being applied to positions before sampling.
+  /// Return true if the texture was updated.
+  bool update(unsigned int const resolution, float const extent, float const scale);
+
+  inline GLuint texture_id() const {
+    return gl_texture_id_;
+  }
+
+  inline unsigned int resolution() const {
+    return resolution_;
+  }
+
+ private:
+  static unsigned int _round_resolution(unsigned int const resolution);
+  void _allocate_texture(unsigned int const resolution);
+  void _bake();
+
+  GLuint pgm_;                          //< Bake kernel.
+  struct {
+    GLint extent;
+    GLint curlNoiseScale;
+    GLint perlinNoisePermutationSeed;
+  } ulocation_;
+
+  GLuint gl_texture_id_;
+
+  unsigned int resolution_;             //< texels per dimension.
+  float extent_;                        //< half size of the baked volume.
+  float scale_;
+  bool outdated_;                       //< true when the noise changed since the last bake.
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif // API_CURL_NOISE_FIELD_H_
@@ -1,34 +1,28 @@
 #include "api/gpu_particle.h"
 
 #include <cstdio>
+#include <limits>
+#include <string>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include "api/append_consume_buffer.h"
+#include "api/cpu_trace.h"
+#include "api/random.h"
 #include "shaders/sparkle/interop.h"
 
 /* ========================================================================== */
 
 unsigned int const GPUParticle::kThreadsGroupWidth = PARTICLES_KERNEL_GROUP_WIDTH;
-unsigned int const GPUParticle::kBatchEmitCount;
+unsigned int const GPUParticle::kSortLocalBlockWidth = SORT_LOCAL_BLOCK_WIDTH;
+unsigned int const GPUParticle::kDefaultMaxParticleCount;
+unsigned int const GPUParticle::kMaxEmitterCount = MAX_EMITTER_COUNT;
+unsigned int const GPUParticle::kMaxSystemCount = MAX_SYSTEM_COUNT;
+unsigned int const GPUParticle::kEmitHistorySize;
+unsigned int const GPUParticle::kSortBenchmarkSamples;
+unsigned int const GPUParticle::kSortBenchmarkRows;
 
 /* -------------------------------------------------------------------------- */
 
-#define _BENCHMARK(block) \
-{ \
-  unsigned int const kNumIter = 10000u; \
-  static unsigned int iter = 0u; \
-  static unsigned int result = 0u; \
-  glFinish(); \
-  glBeginQuery(GL_TIME_ELAPSED, query_time_); \
-  { block; } \
-  glEndQuery(GL_TIME_ELAPSED); \
-  unsigned int dt; glGetQueryObjectuiv(query_time_, GL_QUERY_RESULT, &dt); \
-  result += dt / 100; \
-  if (++iter == kNumIter) {fprintf(stderr, "%8u | %32s [%u iter, %u p]\n", result / kNumIter, #block, kNumIter, kMaxParticleCount);} \
-}
-
-#define BENCHMARK(x) x
-
 #define DBGMARK       fprintf(stderr, "%3u\t\t%s\n", __LINE__, __FUNCTION__);
 
 #define _SHOWBUFFER()  { \
@@ -56,13 +50,75 @@ struct TIndirectValues {
   unsigned int draw_count;
   unsigned int draw_primCount;
   unsigned int draw_first;
-  unsigned int draw_reserved;
+  unsigned int draw_reserved;       //< base vertex when drawing the alive indices.
+  unsigned int draw_base_instance;  //< drawing the alive indices only.
 };
 
 /* -------------------------------------------------------------------------- */
 
 namespace {
 
+char const* const kParticleLayoutNames[GPUParticle::kNumParticleLayout] = {
+  "aos",
+  "soa",
+  "aosoa32",
+  "aosoa64",
+  "packed"
+};
+
+// Definitions prepended to the shaders for each layout (see interop).
+char const* const kParticleLayoutDefines[GPUParticle::kNumParticleLayout] = {
+  "",
+  "#define SPARKLE_USE_SOA_LAYOUT 1\n",
+  "#define SPARKLE_USE_AOSOA_LAYOUT 1\n#define SPARKLE_AOSOA_BLOCK_WIDTH 32u\n",
+  "#define SPARKLE_USE_AOSOA_LAYOUT 1\n#define SPARKLE_AOSOA_BLOCK_WIDTH 64u\n",
+  "#define SPARKLE_USE_PACKED_LAYOUT 1\n"
+};
+
+char const* const kParticlePoolNames[GPUParticle::kNumParticlePool] = {
+  "appendconsume",
+  "freelist",
+  "ring"
+};
+
+// Definitions prepended to the shaders for each pool, after the layout ones.
+char const* const kParticlePoolDefines[GPUParticle::kNumParticlePool] = {
+  "",
+  "#define SPARKLE_USE_FREE_LIST 1\n",
+  "#define SPARKLE_USE_RING 1\n"
+};
+
+// Bytes used by a particle in the Append / Consume buffer.
+unsigned int GetStoredParticleSize(GPUParticle::ParticleLayout const layout) {
+  switch (layout) {
+    case GPUParticle::LAYOUT_PACKED:
+      return sizeof(TPackedParticle);
+
+    case GPUParticle::LAYOUT_SOA:
+    case GPUParticle::LAYOUT_AOSOA_32:
+    case GPUParticle::LAYOUT_AOSOA_64:
+      return 3u * sizeof(glm::vec4);
+
+    case GPUParticle::LAYOUT_AOS:
+    default:
+      return sizeof(TParticle);
+  }
+}
+
+/* Particles per block of the AoSoA layouts, 1 for the others. */
+unsigned int GetParticleBlockWidth(GPUParticle::ParticleLayout const layout) {
+  switch (layout) {
+    case GPUParticle::LAYOUT_AOSOA_32:
+      return 32u;
+
+    case GPUParticle::LAYOUT_AOSOA_64:
+      return 64u;
+
+    default:
+      return 1u;
+  }
+}
+
 unsigned int GetClosestPowerOfTwo(unsigned int const n) {
   unsigned int r = 1u;
   for (unsigned int i = 0u; r < n; r <<= 1u) ++i;
@@ -75,23 +131,71 @@ unsigned int GetNumTrailingBits(unsigned int const n) {
   return r;
 }
 
+char const* const kProfileSectionNames[GPUParticle::kNumProfileSection] = {
+  "emitter_counts",
+  "emission",
+  "update_args",
+  "grid_build",
+  "fluid_density",
+  "curlnoise_bake",
+  "simulation",
+  "calculate_dp",
+  "sort_indices",
+  "sort_bitonic_local",
+  "sort_bitonic_steps",
+  "sort_radix_passes",
+  "sort_coherent_rebuild",
+  "sort_coherent_merge",
+  "sort_coherent_refine",
+  "sort_final",
+  "postprocess",
+  "render"
+};
+
+char const* const kSortEngineNames[GPUParticle::kNumSortEngine] = {
+  "bitonic",
+  "radix",
+  "coherent"
+};
+
 }  // namespace
 
 /* -------------------------------------------------------------------------- */
 
-void GPUParticle::init() {
-  /* Assert than the number of particles will be a factor of threadGroupWidth */
-  unsigned int const num_particles = FloorParticleCount(kMaxParticleCount); //
-  fprintf(stderr, "[ %u particles, %u per batch ]\n", num_particles , kBatchEmitCount);
+char const* GPUParticle::LayoutName(ParticleLayout const layout) {
+  return kParticleLayoutNames[layout];
+}
 
-  /* Append/Consume Buffer */
-  unsigned int const num_attrib_buffer = (sizeof(TParticle) + sizeof(glm::vec4) - 1u) / sizeof(glm::vec4); //
-  pbuffer_ = new AppendConsumeBuffer(num_particles, num_attrib_buffer);
-  pbuffer_->initialize();
+char const* GPUParticle::PoolName(ParticlePool const pool) {
+  return kParticlePoolNames[pool];
+}
+
+/* -------------------------------------------------------------------------- */
+
+void GPUParticle::init(ParticleLayout const layout,
+                       unsigned int const max_particle_count,
+                       ParticlePool const pool) {
+  layout_ = layout;
+  pool_ = pool;
+
+  /* Packed positions only cover the PACKED_POSITION_EXTENT cube, the volume
+   * is kept inside so particles bounce on it rather than on the cube. */
+  float const max_size = max_bounding_volume_size();
+  if (simulation_params_.bounding_volume_size > max_size) {
+    fprintf(stderr, "GPUParticle : packed particles limit the simulation volume size to %.1f.\n", max_size);
+    simulation_params_.bounding_volume_size = max_size;
+  }
 
-  /* Random value buffer */
-  unsigned int const num_randvalues = 3u * num_particles ;
-  randbuffer_.initialize(num_randvalues);
+  /* Random values are keyed by the step index, restart the sequence. */
+  frame_index_ = 0u;
+  readback_next_frame_ = 0u;
+  readback_base_count_ = 0u;
+  sorted_last_frame_ = false;
+  stepped_since_sort_ = false;
+  std::fill(emit_history_, emit_history_ + kEmitHistorySize, 0u);
+  for (auto &row : sort_benchmark_) {
+    row = {};
+  }
 
   /* VectorField generator */
   if (enable_vectorfield_) {
@@ -99,55 +203,129 @@ void GPUParticle::init() {
     vectorfield_.generate_values("velocities.dat");
   }
 
-  /* Compute Shaders */
+  /* Compute Shaders, built for the particles layout and pool */
+  std::string const pipeline_defines = std::string(kParticleLayoutDefines[layout_]) + kParticlePoolDefines[pool_];
+  char const* defines = pipeline_defines.c_str();
   char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
-  pgm_.emission     = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_emission.glsl", src_buffer);
+  pgm_.emitter_counts = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_emitter_counts.glsl", src_buffer);
+  pgm_.emission_args  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_emission_args.glsl", src_buffer);
+  pgm_.pool_compact   = (pool_ != POOL_APPEND_CONSUME) ? CreateComputeProgram(SHADERS_DIR "/sparkle/cs_pool_compact.glsl", src_buffer, defines)
+                                                       : 0u;
+  pgm_.ring_advance   = (pool_ == POOL_RING) ? CreateComputeProgram(SHADERS_DIR "/sparkle/cs_ring_advance.glsl", src_buffer, defines)
+                                             : 0u;
+  pgm_.fluid_density  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_fluid_density.glsl", src_buffer, defines);
+  pgm_.emission     = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_emission.glsl", src_buffer, defines);
   pgm_.update_args  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_update_args.glsl", src_buffer);
-  pgm_.simulation   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_simulation.glsl", src_buffer);
-  pgm_.fill_indices = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_fill_indices.glsl", src_buffer);
-  pgm_.calculate_dp = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_calculate_dp.glsl", src_buffer);
+  pgm_.simulation   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_simulation.glsl", src_buffer, defines);
+  pgm_.calculate_dp = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_calculate_dp.glsl", src_buffer, defines);
+  pgm_.sort_local   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_local.glsl", src_buffer);
+  pgm_.sort_merge   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_merge.glsl", src_buffer);
   pgm_.sort_step    = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_step.glsl", src_buffer);
-  pgm_.sort_final   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_final.glsl", src_buffer);
+  pgm_.sort_final   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_final.glsl", src_buffer, defines);
+  pgm_.radix_count  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_radix_count.glsl", src_buffer);
+  pgm_.radix_scatter = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_radix_scatter.glsl", src_buffer);
+  pgm_.sort_coherent_scatter = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_coherent_scatter.glsl", src_buffer);
+  pgm_.sort_coherent_compact = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_coherent_compact.glsl", src_buffer);
+  pgm_.sort_coherent_insert  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_coherent_insert.glsl", src_buffer);
+  pgm_.sort_coherent_merge   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_coherent_merge.glsl", src_buffer);
+  pgm_.sort_coherent_pass    = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_coherent_pass.glsl", src_buffer);
+  pgm_.sort_error   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_sort_error.glsl", src_buffer);
   pgm_.render_point_sprite = CreateRenderProgram(
     SHADERS_DIR "/sparkle/vs_generic.glsl",
     SHADERS_DIR "/sparkle/fs_point_sprite.glsl",
-    src_buffer
+    src_buffer,
+    defines
   );
   pgm_.render_stretched_sprite = CreateRenderProgram(
     SHADERS_DIR "/sparkle/vs_generic.glsl",
     SHADERS_DIR "/sparkle/gs_stretched_sprite.glsl",
     SHADERS_DIR "/sparkle/fs_stretched_sprite.glsl",
-    src_buffer
+    src_buffer,
+    defines
   );
   delete [] src_buffer;
 
   /* Get uniform locations */
+  ulocation_.emitter_counts.numEmitters = GetUniformLocation(pgm_.emitter_counts, "uNumEmitters");
+  ulocation_.emitter_counts.timeStep    = GetUniformLocation(pgm_.emitter_counts, "uTimeStep");
+  ulocation_.emitter_counts.batchCount  = GetUniformLocation(pgm_.emitter_counts, "uBatchCount");
+
+  ulocation_.emission_args.numEmitters      = GetUniformLocation(pgm_.emission_args, "uNumEmitters");
+  ulocation_.emission_args.emitCount        = GetUniformLocation(pgm_.emission_args, "uEmitCount");
+  ulocation_.emission_args.maxParticleCount = GetUniformLocation(pgm_.emission_args, "uMaxParticleCount");
+
+  if (pool_ != POOL_APPEND_CONSUME) {
+    ulocation_.pool_compact.numParticles = GetUniformLocation(pgm_.pool_compact, "uNumParticles");
+  }
+  if (pool_ == POOL_RING) {
+    ulocation_.pool_compact.ringTail     = GetUniformLocation(pgm_.pool_compact, "uRingTail");
+    ulocation_.pool_compact.ringCapacity = GetUniformLocation(pgm_.pool_compact, "uRingCapacity");
+  }
+
   ulocation_.emission.emitCount        = GetUniformLocation(pgm_.emission, "uEmitCount");
-  ulocation_.emission.emitterType      = GetUniformLocation(pgm_.emission, "uEmitterType");
-  ulocation_.emission.emitterPosition  = GetUniformLocation(pgm_.emission, "uEmitterPosition");
-  ulocation_.emission.emitterDirection = GetUniformLocation(pgm_.emission, "uEmitterDirection");
-  ulocation_.emission.emitterRadius    = GetUniformLocation(pgm_.emission, "uEmitterRadius");
-  ulocation_.emission.particleMinAge   = GetUniformLocation(pgm_.emission, "uParticleMinAge");
-  ulocation_.emission.particleMaxAge   = GetUniformLocation(pgm_.emission, "uParticleMaxAge");
+  ulocation_.emission.numEmitters      = GetUniformLocation(pgm_.emission, "uNumEmitters");
+  ulocation_.emission.maxParticleCount = GetUniformLocation(pgm_.emission, "uMaxParticleCount");
+  ulocation_.emission.randomSeed       = GetUniformLocation(pgm_.emission, "uRandomSeed");
+  ulocation_.emission.frameIndex       = GetUniformLocation(pgm_.emission, "uFrameIndex");
 
   ulocation_.simulation.timeStep           = GetUniformLocation(pgm_.simulation, "uTimeStep");
   ulocation_.simulation.vectorFieldSampler = GetUniformLocation(pgm_.simulation, "uVectorFieldSampler");
-  ulocation_.simulation.bboxSize           = GetUniformLocation(pgm_.simulation, "uBBoxSize");
-  ulocation_.simulation.boundingVolume     = GetUniformLocation(pgm_.simulation, "uBoundingVolume");
-  ulocation_.simulation.scatteringFactor   = GetUniformLocation(pgm_.simulation, "uScatteringFactor");
-  ulocation_.simulation.vectorFieldFactor  = GetUniformLocation(pgm_.simulation, "uVectorFieldFactor");
-  ulocation_.simulation.curlNoiseFactor    = GetUniformLocation(pgm_.simulation, "uCurlNoiseFactor");
   ulocation_.simulation.curlNoiseScale     = GetUniformLocation(pgm_.simulation, "uCurlNoiseScale");
-  ulocation_.simulation.velocityFactor     = GetUniformLocation(pgm_.simulation, "uVelocityFactor");
-  ulocation_.simulation.enableScattering   = GetUniformLocation(pgm_.simulation, "uEnableScattering");
-  ulocation_.simulation.enableVectorField  = GetUniformLocation(pgm_.simulation, "uEnableVectorField");
-  ulocation_.simulation.enableCurlNoise    = GetUniformLocation(pgm_.simulation, "uEnableCurlNoise");
-  ulocation_.simulation.enableVelocityControl = GetUniformLocation(pgm_.simulation, "uEnableVelocityControl");
+  ulocation_.simulation.curlNoiseMethod    = GetUniformLocation(pgm_.simulation, "uCurlNoiseMethod");
+  ulocation_.simulation.curlNoiseSampler   = GetUniformLocation(pgm_.simulation, "uCurlNoiseSampler");
+  ulocation_.simulation.curlNoiseExtent    = GetUniformLocation(pgm_.simulation, "uCurlNoiseExtent");
+  ulocation_.simulation.perlinNoisePermutationSeed = GetUniformLocation(pgm_.simulation, "uPerlinNoisePermutationSeed");
+  ulocation_.simulation.randomSeed         = GetUniformLocation(pgm_.simulation, "uRandomSeed");
+  ulocation_.simulation.frameIndex         = GetUniformLocation(pgm_.simulation, "uFrameIndex");
+
+  /* The ring pool simulation writes neither the previous ranks, given by
+   * calculate_dp, nor the depth keys of the fused pipeline. */
+  if (pool_ == POOL_RING) {
+    ulocation_.simulation.writePreviousRanks = -1;
+    ulocation_.simulation.writeDepthKeys     = -1;
+    ulocation_.simulation.view               = -1;
+  } else {
+    ulocation_.simulation.writePreviousRanks = GetUniformLocation(pgm_.simulation, "uWritePreviousRanks");
+    ulocation_.simulation.writeDepthKeys     = GetUniformLocation(pgm_.simulation, "uWriteDepthKeys");
+    ulocation_.simulation.view               = GetUniformLocation(pgm_.simulation, "uViewMatrix");
+  }
+  ulocation_.simulation.gridExtent      = GetUniformLocation(pgm_.simulation, "uGridExtent");
+  ulocation_.simulation.gridResolution  = GetUniformLocation(pgm_.simulation, "uGridResolution");
+  ulocation_.simulation.repulsionRadius = GetUniformLocation(pgm_.simulation, "uRepulsionRadius");
+  ulocation_.simulation.fluidRadius      = GetUniformLocation(pgm_.simulation, "uFluidRadius");
+  ulocation_.simulation.fluidRestDensity = GetUniformLocation(pgm_.simulation, "uFluidRestDensity");
+  ulocation_.simulation.fluidStiffness   = GetUniformLocation(pgm_.simulation, "uFluidStiffness");
+  ulocation_.simulation.fluidViscosity   = GetUniformLocation(pgm_.simulation, "uFluidViscosity");
+  ulocation_.simulation.fluidGravity     = GetUniformLocation(pgm_.simulation, "uFluidGravity");
+
+  ulocation_.fused_emission.emitCount        = GetUniformLocation(pgm_.simulation, "uEmitCount");
+  ulocation_.fused_emission.numEmitters      = GetUniformLocation(pgm_.simulation, "uNumEmitters");
+  ulocation_.fused_emission.maxParticleCount = GetUniformLocation(pgm_.simulation, "uMaxParticleCount");
+  ulocation_.fused_emission.randomSeed       = GetUniformLocation(pgm_.simulation, "uRandomSeed");
+  ulocation_.fused_emission.frameIndex       = GetUniformLocation(pgm_.simulation, "uFrameIndex");
+
+  ulocation_.update_args.emitCount = GetUniformLocation(pgm_.update_args, "uEmitCount");
+
+  ulocation_.fluid_density.gridExtent     = GetUniformLocation(pgm_.fluid_density, "uGridExtent");
+  ulocation_.fluid_density.gridResolution = GetUniformLocation(pgm_.fluid_density, "uGridResolution");
+  ulocation_.fluid_density.fluidRadius    = GetUniformLocation(pgm_.fluid_density, "uFluidRadius");
 
   ulocation_.calculate_dp.view  = GetUniformLocation(pgm_.calculate_dp, "uViewMatrix");
 
   ulocation_.sort_step.blockWidth     = GetUniformLocation(pgm_.sort_step, "uBlockWidth");
   ulocation_.sort_step.maxBlockWidth  = GetUniformLocation(pgm_.sort_step, "uMaxBlockWidth");
+  ulocation_.sort_merge.maxBlockWidth = GetUniformLocation(pgm_.sort_merge, "uMaxBlockWidth");
+
+  ulocation_.radix_count.numElements   = GetUniformLocation(pgm_.radix_count, "uNumElements");
+  ulocation_.radix_count.digitShift    = GetUniformLocation(pgm_.radix_count, "uDigitShift");
+  ulocation_.radix_count.floatKeys     = GetUniformLocation(pgm_.radix_count, "uFloatKeys");
+  ulocation_.radix_scatter.numElements = GetUniformLocation(pgm_.radix_scatter, "uNumElements");
+  ulocation_.radix_scatter.digitShift  = GetUniformLocation(pgm_.radix_scatter, "uDigitShift");
+  ulocation_.radix_scatter.floatKeys   = GetUniformLocation(pgm_.radix_scatter, "uFloatKeys");
+
+  ulocation_.sort_coherent_compact.numElements = GetUniformLocation(pgm_.sort_coherent_compact, "uNumElements");
+  ulocation_.sort_coherent_merge.numElements   = GetUniformLocation(pgm_.sort_coherent_merge, "uNumElements");
+  ulocation_.sort_coherent_pass.blockOffset    = GetUniformLocation(pgm_.sort_coherent_pass, "uBlockOffset");
 
   ulocation_.render_point_sprite.mvp             = GetUniformLocation(pgm_.render_point_sprite, "uMVP");
   ulocation_.render_point_sprite.minParticleSize = GetUniformLocation(pgm_.render_point_sprite, "uMinParticleSize");
@@ -156,6 +334,7 @@ void GPUParticle::init() {
   ulocation_.render_point_sprite.birthGradient   = GetUniformLocation(pgm_.render_point_sprite, "uBirthGradient");
   ulocation_.render_point_sprite.deathGradient   = GetUniformLocation(pgm_.render_point_sprite, "uDeathGradient");
   ulocation_.render_point_sprite.fadeCoefficient = GetUniformLocation(pgm_.render_point_sprite, "uFadeCoefficient");
+  ulocation_.render_point_sprite.rewindTime      = GetUniformLocation(pgm_.render_point_sprite, "uRewindTime");
 
   ulocation_.render_stretched_sprite.view            = GetUniformLocation(pgm_.render_stretched_sprite, "uView");
   ulocation_.render_stretched_sprite.mvp             = GetUniformLocation(pgm_.render_stretched_sprite, "uMVP");
@@ -164,11 +343,27 @@ void GPUParticle::init() {
   ulocation_.render_stretched_sprite.deathGradient   = GetUniformLocation(pgm_.render_stretched_sprite, "uDeathGradient");
   ulocation_.render_stretched_sprite.spriteStretchFactor = GetUniformLocation(pgm_.render_stretched_sprite, "uSpriteStretchFactor");
   ulocation_.render_stretched_sprite.fadeCoefficient = GetUniformLocation(pgm_.render_stretched_sprite, "uFadeCoefficient");
+  ulocation_.render_stretched_sprite.rewindTime      = GetUniformLocation(pgm_.render_stretched_sprite, "uRewindTime");
+
+  /* Packed particles have no rewind weight, they are kept in the volume of
+   * the main system when rendered between steps. */
+  if (layout_ == LAYOUT_PACKED) {
+    ulocation_.render_point_sprite.boundingVolume         = GetUniformLocation(pgm_.render_point_sprite, "uBoundingVolume");
+    ulocation_.render_point_sprite.boundingVolumeSize     = GetUniformLocation(pgm_.render_point_sprite, "uBoundingVolumeSize");
+    ulocation_.render_stretched_sprite.boundingVolume     = GetUniformLocation(pgm_.render_stretched_sprite, "uBoundingVolume");
+    ulocation_.render_stretched_sprite.boundingVolumeSize = GetUniformLocation(pgm_.render_stretched_sprite, "uBoundingVolumeSize");
+  } else {
+    ulocation_.render_point_sprite.boundingVolume         = -1;
+    ulocation_.render_point_sprite.boundingVolumeSize     = -1;
+    ulocation_.render_stretched_sprite.boundingVolume     = -1;
+    ulocation_.render_stretched_sprite.boundingVolumeSize = -1;
+  }
 
-  /* One time uniform setting */
-  glProgramUniform1i(pgm_.simulation,
-                     GetUniformLocation(pgm_.simulation, "uPerlinNoisePermutationSeed"),
-                     rand());
+  /* Curl noise texture, baked on first use. */
+  curlnoise_field_.initialize();
+
+  /* Noise permutation of the run, updated when its seed changes. */
+  _set_noise_seed(simulation_params_.random_seed);
 
   /* Dispatch and Draw Indirect buffer */
   glGenBuffers(1u, &gl_indirect_buffer_id_);
@@ -177,106 +372,401 @@ void GPUParticle::init() {
     // Dispatch values
     1u, 1u, 1u,
     // Draw values
-    0, 1u, 0u, 0u
+    0, 1u, 0u, 0u, 0u
   }};
   glBufferStorage(GL_DISPATCH_INDIRECT_BUFFER, sizeof default_indirect, default_indirect, 0);
   glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0u);
 
-  /* Storage buffers */
+  /* Storage buffers, independent of the pool capacity */
 
-  // The parallel nature of the sorting algorithm needs power of two sized buffer.
-  unsigned int const sort_buffer_max_count = GetClosestPowerOfTwo(kMaxParticleCount); //
+  // Coherent sort state, restarted after a pool resize (see sorted_last_frame_).
+  TSortState const default_sort_state{};
+  glGenBuffers(1u, &gl_sort_state_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_state_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof default_sort_state, &default_sort_state, 0);
 
-  // DotProducts buffer.
-  glGenBuffers(1u, &gl_dp_buffer_id_);
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_dp_buffer_id_);
-  GLuint const dp_buffer_size = sort_buffer_max_count * sizeof(GLfloat);
-  glBufferStorage(GL_SHADER_STORAGE_BUFFER, dp_buffer_size, nullptr, 0);
+  // Emitters table, their offsets get one more slot for the total.
+  glGenBuffers(1u, &gl_emitters_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_emitters_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, kMaxEmitterCount * sizeof(TEmitter), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-  // Double-sized buffer for indices sorting.
-  /// @note might use short instead.
-  glGenBuffers(1u, &gl_sort_indices_buffer_id_);
-  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_indices_buffer_id_);
-  GLuint const sort_indices_buffer_size = 2u * sort_buffer_max_count * sizeof(GLuint);
-  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sort_indices_buffer_size, nullptr, 0);
+  glGenBuffers(1u, &gl_emitter_offsets_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_emitter_offsets_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, (kMaxEmitterCount + 1u) * sizeof(GLuint), nullptr, 0);
+
+  glGenBuffers(1u, &gl_emitter_accumulators_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_emitter_accumulators_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, kMaxEmitterCount * sizeof(GLfloat), nullptr, 0);
+
+  std::vector<GLuint> const no_bursts(kMaxEmitterCount, 0u);
+  glGenBuffers(1u, &gl_emitter_bursts_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_emitter_bursts_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, kMaxEmitterCount * sizeof(GLuint), no_bursts.data(), GL_DYNAMIC_STORAGE_BIT);
+
+  // Emission dispatch arguments, written on device from the free slots.
+  GLuint const default_emission_args[3u] = { 0u, 1u, 1u };
+  glGenBuffers(1u, &gl_emission_args_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_emission_args_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof default_emission_args, default_emission_args, 0);
+
+  // Particles systems table.
+  glGenBuffers(1u, &gl_systems_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_systems_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, kMaxSystemCount * sizeof(TSystem), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
   glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
 
-  /* Setup rendering buffers */
-  _setup_render();
+  // The main emitter and system, set from the simulation parameters each frame.
+  emitters_.assign(1u, Emitter_t());
+  num_uploaded_emitters_ = 0u;
+  pending_bursts_.assign(1u, 0u);
+  systems_.assign(1u, System_t());
+  num_uploaded_systems_ = 0u;
+
+  // Scans of the emitters counts, grown with the pool for the sorting engines.
+  prefix_sum_.initialize(kMaxEmitterCount + 1u);
+
+  // Neighbours grid, built with the pipeline kernels, its storage is allocated on first use.
+  spatial_grid_.initialize(0u, defines);
+
+  /* Particles pool, with its sorting and rendering buffers */
+  _create_pool(max_particle_count);
 
   /* Query used for benchmarking */
   glCreateQueries(GL_TIME_ELAPSED, 1, &query_time_);
 
+  /* Per stage timings */
+  profiler_.initialize(kNumProfileSection, kProfileSectionNames);
+
   CHECKGLERROR();
 }
 
 void GPUParticle::deinit() {
-  pbuffer_->deinitialize();
-  delete pbuffer_;
+  _destroy_pool();
 
-  randbuffer_.deinitialize();
+  curlnoise_field_.deinitialize();
 
   if (enable_vectorfield_) {
     vectorfield_.deinitialize();
   }
 
+  glDeleteProgram(pgm_.emitter_counts);
+  glDeleteProgram(pgm_.emission_args);
+  glDeleteProgram(pgm_.pool_compact);
+  glDeleteProgram(pgm_.ring_advance);
+  glDeleteProgram(pgm_.fluid_density);
   glDeleteProgram(pgm_.emission);
   glDeleteProgram(pgm_.update_args);
   glDeleteProgram(pgm_.simulation);
-  glDeleteProgram(pgm_.fill_indices);
   glDeleteProgram(pgm_.calculate_dp);
+  glDeleteProgram(pgm_.sort_local);
+  glDeleteProgram(pgm_.sort_merge);
   glDeleteProgram(pgm_.sort_step);
   glDeleteProgram(pgm_.sort_final);
+  glDeleteProgram(pgm_.radix_count);
+  glDeleteProgram(pgm_.radix_scatter);
+  glDeleteProgram(pgm_.sort_coherent_scatter);
+  glDeleteProgram(pgm_.sort_coherent_compact);
+  glDeleteProgram(pgm_.sort_coherent_insert);
+  glDeleteProgram(pgm_.sort_coherent_merge);
+  glDeleteProgram(pgm_.sort_coherent_pass);
+  glDeleteProgram(pgm_.sort_error);
   glDeleteProgram(pgm_.render_point_sprite);
 
   glDeleteBuffers(1u, &gl_indirect_buffer_id_);
-  glDeleteBuffers(1u, &gl_dp_buffer_id_);
-  glDeleteBuffers(1u, &gl_sort_indices_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_state_buffer_id_);
+  glDeleteBuffers(1u, &gl_emitters_buffer_id_);
+  glDeleteBuffers(1u, &gl_emitter_offsets_buffer_id_);
+  glDeleteBuffers(1u, &gl_emitter_accumulators_buffer_id_);
+  glDeleteBuffers(1u, &gl_emitter_bursts_buffer_id_);
+  glDeleteBuffers(1u, &gl_emission_args_buffer_id_);
+  glDeleteBuffers(1u, &gl_systems_buffer_id_);
+
+  prefix_sum_.deinitialize();
+  spatial_grid_.deinitialize();
 
-  glDeleteVertexArrays(1u, &vao_);
   glDeleteQueries(1, &query_time_);
+  profiler_.deinitialize();
+}
+
+unsigned int GPUParticle::max_particle_count() const {
+  return pbuffer_->element_count();
+}
+
+void GPUParticle::resize(unsigned int const max_particle_count) {
+  CPU_TRACE_SCOPE("GPUParticle::resize");
+
+  unsigned int const num_particles = FloorParticleCount(std::max(max_particle_count, kThreadsGroupWidth));
+  if (num_particles == pbuffer_->element_count()) {
+    return;
+  }
+
+  /* Between frames the alive particles are at the front of the first storage
+   * buffer, listed by the first alive indices or following the ring tail, and
+   * counted by the first counter. */
+  GLuint num_alive = 0u;
+  glGetNamedBufferSubData(pbuffer_->first_atomic_buffer_id(), 0, sizeof num_alive, &num_alive);
+  unsigned int const count = std::min(num_alive, num_particles);
+
+  GLuint ring_tail = 0u;
+  if (pool_ == POOL_RING) {
+    glGetNamedBufferSubData(gl_ring_state_buffer_id_, offsetof(TRingState, tail), sizeof ring_tail, &ring_tail);
+  }
+
+  AppendConsumeBuffer *const previous_pbuffer = pbuffer_;
+  GLuint const previous_alive_indices = gl_alive_indices_buffer_ids_[0u];
+  pbuffer_ = nullptr;
+  gl_alive_indices_buffer_ids_[0u] = 0u;
+  _destroy_pool();
+  _create_pool(num_particles);
+
+  /* Move the particles kept, the last ones being dropped when shrinking. */
+  unsigned int const stored_size = GetStoredParticleSize(layout_);
+  if (pool_ != POOL_APPEND_CONSUME) {
+    _compact_pool(previous_pbuffer, previous_alive_indices, ring_tail, count);
+    glDeleteBuffers(1u, &previous_alive_indices);
+  } else if (layout_ == LAYOUT_SOA) {
+    unsigned int const num_streams = stored_size / sizeof(glm::vec4);
+    for (unsigned int i = 0u; i < num_streams; ++i) {
+      glCopyNamedBufferSubData(
+        previous_pbuffer->first_storage_buffer_id(), pbuffer_->first_storage_buffer_id(),
+        i * previous_pbuffer->single_attrib_buffer_size(), i * pbuffer_->single_attrib_buffer_size(),
+        count * sizeof(glm::vec4)
+      );
+    }
+  } else {
+    // AoSoA particles are stored by whole blocks, capacities being multiples of them.
+    unsigned int const block_width = GetParticleBlockWidth(layout_);
+    unsigned int const copy_count = block_width * ((count + block_width - 1u) / block_width);
+    glCopyNamedBufferSubData(
+      previous_pbuffer->first_storage_buffer_id(), pbuffer_->first_storage_buffer_id(),
+      0, 0, copy_count * stored_size
+    );
+  }
+  glClearNamedBufferSubData(
+    pbuffer_->first_atomic_buffer_id(), GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &count
+  );
+  glCopyNamedBufferSubData(
+    pbuffer_->first_atomic_buffer_id(), gl_indirect_buffer_id_, 0u, offsetof(TIndirectValues, draw_count), sizeof(GLuint)
+  );
+
+  previous_pbuffer->deinitialize();
+  delete previous_pbuffer;
+
+  /* The count is exact until the new pool first readback, and the previous
+   * sorted order is gone. */
+  num_alive_particles_ = count;
+  readback_base_count_ = count;
+  readback_next_frame_ = frame_index_;
+  sorted_last_frame_ = false;
+  stepped_since_sort_ = false;
+
+  CHECKGLERROR();
+}
+
+void GPUParticle::_compact_pool(AppendConsumeBuffer *previous_pbuffer,
+                                GLuint const previous_alive_indices,
+                                unsigned int const previous_ring_tail,
+                                unsigned int const count) {
+  /* Particles are scattered in the previous pool, they are gathered to the
+   * first slots of the new one, whose free slots stack starts past them, or
+   * whose ring starts with them. */
+  pbuffer_->bind_storage(0u, STORAGE_BINDING_PARTICLES_FIRST);
+  previous_pbuffer->bind_storage(0u, STORAGE_BINDING_PARTICLES_SECOND);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, gl_alive_indices_buffer_ids_[0u]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_SECOND, previous_alive_indices);
+
+  glUseProgram(pgm_.pool_compact);
+  {
+    glUniform1ui(ulocation_.pool_compact.numParticles, count);
+    if (pool_ == POOL_RING) {
+      glUniform1ui(ulocation_.pool_compact.ringTail, previous_ring_tail);
+      glUniform1ui(ulocation_.pool_compact.ringCapacity, previous_pbuffer->element_count());
+    }
+    glDispatchCompute(GetThreadsGroupCount(count), 1u, 1u);
+  }
+  glUseProgram(0u);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_SECOND, 0u);
+  pbuffer_->unbind_attributes();
+
+  /* The new ring is drawn from its first slot. */
+  if (pool_ == POOL_RING) {
+    glClearNamedBufferSubData(
+      gl_ring_state_buffer_id_, GL_R32UI, offsetof(TRingState, draws), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &count
+    );
+  }
+
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+  CHECKGLERROR();
+}
+
+bool GPUParticle::add_emitter(Emitter_t const& emitter) {
+  if ((emitters_.size() >= kMaxEmitterCount) || (emitter.system >= num_systems())) {
+    return false;
+  }
+  emitters_.push_back(emitter);
+  pending_bursts_.push_back(0u);
+  return true;
+}
+
+void GPUParticle::clear_emitters() {
+  emitters_.resize(1u);
+  pending_bursts_.resize(1u);
+  num_uploaded_emitters_ = std::min(num_uploaded_emitters_, 1u);
+}
+
+bool GPUParticle::burst(unsigned int const emitter, unsigned int const count) {
+  if (emitter >= num_emitters()) {
+    return false;
+  }
+  /* More than the pool would be dropped anyway, this keeps the device scan in range. */
+  unsigned int const capacity = pbuffer_->element_count();
+  unsigned int &pending = pending_bursts_[emitter];
+  pending = std::min(pending + std::min(count, capacity), capacity);
+  return true;
+}
+
+float GPUParticle::max_bounding_volume_size() const {
+  return (layout_ == LAYOUT_PACKED) ? 2.0f * PACKED_POSITION_EXTENT : std::numeric_limits<float>::max();
+}
+
+int GPUParticle::add_system(System_t const& system) {
+  if ((systems_.size() >= kMaxSystemCount) || (layout_ == LAYOUT_PACKED)) {
+    return -1;
+  }
+  systems_.push_back(system);
+  return static_cast<int>(systems_.size()) - 1;
+}
+
+void GPUParticle::clear_systems() {
+  clear_emitters();
+  systems_.resize(1u);
+  num_uploaded_systems_ = std::min(num_uploaded_systems_, 1u);
+}
+
+void GPUParticle::begin_frame() {
+  /* Collect the timings of an earlier frame, without waiting. */
+  profiler_.begin_frame();
 }
 
 void GPUParticle::update(const float dt, glm::mat4x4 const& view) {
+  CPU_TRACE_SCOPE("GPUParticle::update");
+
+  /* Retrieve the number of alive particles from a previous frame. */
+  _update_num_alive_particles();
+
+  /* Particles the device may emit : the emitters rates are capped by the batch
+   * size and the bursts come on top. The device clamps them to the free slots
+   * of the pool, so emission does not wait for the alive count readback, and
+   * keeps the rate particles it could not emit for the next frames. */
+  unsigned int const burst_count = _take_pending_bursts();
+  unsigned int const emit_budget = batch_emit_count_ + burst_count;
+
   /* Max number of particles able to be spawned. */
   unsigned int const num_dead_particles = pbuffer_->element_count() - num_alive_particles_;
-  /* Number of particles to be emitted. */
-  unsigned int const emit_count = std::min(kBatchEmitCount, num_dead_particles); //
+  /* Upper bound of the particles emitted, for the alive count. */
+  unsigned int const emit_count = std::min(emit_budget, num_dead_particles); //
+  emit_history_[frame_index_ % kEmitHistorySize] = emit_count;
+
+  _estimate_pipeline_traffic(emit_count);
   /* Simulation deltatime depends on application framerate and the user input */
   float const time_step = dt * simulation_params_.time_step_factor;
 
-  /* Update random buffer with new values */
-  randbuffer_.generate_values();
-
-  pbuffer_->bind_attributes();
+  _bind_pool();
   {
     pbuffer_->bind_atomics();
-    randbuffer_.bind();
     {
+      /* Emitters table and offsets of this frame, used by either emission. */
+      _update_emitters(time_step, emit_budget, burst_count > 0u);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTERS, gl_emitters_buffer_id_);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_OFFSETS, gl_emitter_offsets_buffer_id_);
+
       /* Emission stage : write in buffer A */
-      _emission(emit_count);
+      if (!_use_fused_pipeline()) {
+        _emission(emit_budget, emit_count);
+      }
 
-      /* Simulation stage : read buffer A, write buffer B */
-      _simulation(time_step);
-    }
-    randbuffer_.unbind();
-    pbuffer_->unbind_atomics();
+      /* Simulation stage : read buffer A, write buffer B.
+       * The fused pipeline also emits and writes the depth keys there. */
+      _simulation(time_step, emit_budget, emit_count, view);
 
-    /* Sort particles for alpha-blending. */
-    if (enable_sorting_ && simulated_) {
-      _sorting(view);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTERS, 0u);
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_OFFSETS, 0u);
     }
+    pbuffer_->unbind_atomics();
   }
-  pbuffer_->unbind_attributes();
+  _unbind_pool();
 
   /* PostProcess stage */
+  profiler_.begin(PROFILE_POSTPROCESS);
   _postprocess();
+  profiler_.end(PROFILE_POSTPROCESS);
+
+  /* The step left its particles unsorted, the coherent sort can only follow
+   * a single step from a sorted order. */
+  if (simulated_) {
+    coherent_order_ = sorted_last_frame_;
+    depth_keys_written_ = _use_fused_pipeline() && enable_sorting_;
+    sorted_last_frame_ = false;
+    stepped_since_sort_ = true;
+  }
+
+  ++frame_index_;
+
+  CHECKGLERROR();
+}
+
+void GPUParticle::end_frame(glm::mat4x4 const& view, float const rewind_time) {
+  CPU_TRACE_SCOPE("GPUParticle::end_frame");
+
+  render_rewind_time_ = rewind_time;
+
+  if (!enable_sorting_ || !simulated_) {
+    return;
+  }
+
+  /* Without a step, the last sorted particles are sorted again when the view
+   * changed. Their simulated order is still held by the second buffer. */
+  if (!stepped_since_sort_ && (!sorted_last_frame_ || (view == sorted_view_))) {
+    return;
+  }
+
+  /* Put back the last step output in the second buffer and its count in the
+   * second counter, as the sort expects them. */
+  if (stepped_since_sort_) {
+    pbuffer_->swap_storage();
+    if (pool_ == POOL_FREE_LIST) {
+      _swap_alive_indices();
+    }
+  }
+  pbuffer_->swap_atomics();
+
+  /* Sort particles for alpha-blending, the fused simulation wrote the depth
+   * keys of its step. */
+  bool const compute_keys = !(stepped_since_sort_ && depth_keys_written_);
+  bool const coherent = stepped_since_sort_ && coherent_order_;
+  _bind_pool();
+  pbuffer_->bind_atomics();
+  _sorting(view, compute_keys, coherent);
+  pbuffer_->unbind_atomics();
+  _unbind_pool();
+
+  pbuffer_->swap_atomics();
+
+  /* The next coherent sort starts from this frame order. */
+  sorted_last_frame_ = true;
+  stepped_since_sort_ = false;
+  sorted_view_ = view;
 
   CHECKGLERROR();
 }
 
 void GPUParticle::render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj) {
+  CPU_TRACE_SCOPE("GPUParticle::render");
+
   switch(rendering_params_.rendermode) {
     case RENDERMODE_STRETCHED:
       glUseProgram(pgm_.render_stretched_sprite);
@@ -287,6 +777,9 @@ void GPUParticle::render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj) {
       glUniform3fv(ulocation_.render_stretched_sprite.deathGradient, 1, rendering_params_.death_gradient);
       glUniform1f(ulocation_.render_stretched_sprite.spriteStretchFactor, rendering_params_.stretched_factor);
       glUniform1f(ulocation_.render_stretched_sprite.fadeCoefficient, rendering_params_.fading_factor);
+      glUniform1f(ulocation_.render_stretched_sprite.rewindTime, render_rewind_time_);
+      glUniform1i(ulocation_.render_stretched_sprite.boundingVolume, simulation_params_.bounding_volume);
+      glUniform1f(ulocation_.render_stretched_sprite.boundingVolumeSize, simulation_params_.bounding_volume_size);
     break;
 
     case RENDERMODE_POINTSPRITE:
@@ -299,15 +792,40 @@ void GPUParticle::render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj) {
       glUniform3fv(ulocation_.render_point_sprite.birthGradient, 1, rendering_params_.birth_gradient);
       glUniform3fv(ulocation_.render_point_sprite.deathGradient, 1, rendering_params_.death_gradient);
       glUniform1f(ulocation_.render_point_sprite.fadeCoefficient, rendering_params_.fading_factor);
+      glUniform1f(ulocation_.render_point_sprite.rewindTime, render_rewind_time_);
+      glUniform1i(ulocation_.render_point_sprite.boundingVolume, simulation_params_.bounding_volume);
+      glUniform1f(ulocation_.render_point_sprite.boundingVolumeSize, simulation_params_.bounding_volume_size);
     break;
   }
 
-  glBindVertexArray(vao_);
+  /* Source the storage buffer holding the last simulated particles, blocked
+   * layouts are read by the vertex shader as a storage buffer. */
+  bool const pull_vertices = (layout_ == LAYOUT_AOSOA_32) || (layout_ == LAYOUT_AOSOA_64);
+  if (pull_vertices) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_FIRST, pbuffer_->first_storage_buffer_id());
+  }
+  profiler_.begin(PROFILE_RENDER);
+  glBindVertexArray(vaos_[pbuffer_->front_storage_index()]);
     void const *offset = reinterpret_cast<void const*>(offsetof(TIndirectValues, draw_count));
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gl_indirect_buffer_id_);
-    glDrawArraysIndirect(GL_POINTS, offset);
+    if ((pool_ == POOL_FREE_LIST) || ((pool_ == POOL_RING) && sorted_last_frame_)) {
+      // Particles are scattered in the pool, the alive ones are drawn by index,
+      // as the sorted ones of the ring.
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl_alive_indices_buffer_ids_[0u]);
+      glDrawElementsIndirect(GL_POINTS, GL_UNSIGNED_INT, offset);
+    } else if (pool_ == POOL_RING) {
+      // The ring is drawn from its tail, in two parts when it wraps.
+      glBindBuffer(GL_DRAW_INDIRECT_BUFFER, gl_ring_state_buffer_id_);
+      glMultiDrawArraysIndirect(GL_POINTS, reinterpret_cast<void const*>(offsetof(TRingState, draws)), 2, 0);
+    } else {
+      glDrawArraysIndirect(GL_POINTS, offset);
+    }
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0u);
   glBindVertexArray(0u);
+  profiler_.end(PROFILE_RENDER);
+  if (pull_vertices) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLES_FIRST, 0u);
+  }
 
   glUseProgram(0u);
 
@@ -316,114 +834,613 @@ void GPUParticle::render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj) {
 
 // ----------------------------------------------------------------------------
 
+void GPUParticle::_create_pool(unsigned int const max_particle_count) {
+  /* Assert than the number of particles will be a factor of threadGroupWidth */
+  unsigned int const num_particles = FloorParticleCount(std::max(max_particle_count, kThreadsGroupWidth)); //
+  batch_emit_count_ = std::max(256u, (num_particles >> 4u));
+  fprintf(stderr, "[ %u particles, %u per batch, %s layout, %s pool ]\n",
+    num_particles, batch_emit_count_, LayoutName(layout_), PoolName(pool_)
+  );
+
+  /* Append/Consume Buffer, only the SoA layout splits the attributes in
+   * separate bindings. The free list and ring pools update particles in place. */
+  unsigned int const stored_size = GetStoredParticleSize(layout_);
+  unsigned int const num_attrib_buffer = (stored_size + sizeof(glm::vec4) - 1u) / sizeof(glm::vec4); //
+  bool const use_free_list = (pool_ == POOL_FREE_LIST);
+  bool const use_ring = (pool_ == POOL_RING);
+  pbuffer_ = new AppendConsumeBuffer(num_particles, num_attrib_buffer, layout_ == LAYOUT_SOA, use_free_list || use_ring);
+  pbuffer_->initialize();
+
+  // Slots of the ring are masked until written, by a null age.
+  if (use_ring) {
+    GLuint const zero = 0u;
+    glClearNamedBufferSubData(
+      pbuffer_->first_storage_buffer_id(), GL_R32UI, 0, pbuffer_->storage_buffer_size(), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+    );
+  }
+
+  /* Storage buffers */
+
+  // Free list pool indices, the free slots stack starts with every slot and
+  // pops them in order.
+  if (use_free_list) {
+    glGenBuffers(2u, gl_alive_indices_buffer_ids_);
+    for (unsigned int i = 0u; i < 2u; ++i) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_alive_indices_buffer_ids_[i]);
+      glBufferStorage(GL_SHADER_STORAGE_BUFFER, num_particles * sizeof(GLuint), nullptr, 0);
+    }
+
+    std::vector<GLuint> free_list(num_particles + 1u);
+    free_list[0u] = 0u;
+    for (unsigned int i = 0u; i < num_particles; ++i) {
+      free_list[i + 1u] = num_particles - 1u - i;
+    }
+    glGenBuffers(1u, &gl_free_list_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_free_list_buffer_id_);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, free_list.size() * sizeof(GLuint), free_list.data(), 0);
+  }
+
+  // Ring pool sorted slots and slots ranks, the ring starts empty.
+  if (use_ring) {
+    glGenBuffers(2u, gl_alive_indices_buffer_ids_);
+    for (unsigned int i = 0u; i < 2u; ++i) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_alive_indices_buffer_ids_[i]);
+      glBufferStorage(GL_SHADER_STORAGE_BUFFER, num_particles * sizeof(GLuint), nullptr, 0);
+    }
+
+    TRingState ring_state{};
+    ring_state.capacity = num_particles;
+    ring_state.first_alive = ~0u;
+    ring_state.draws[0u] = glm::uvec4(0u, 1u, 0u, 0u);
+    ring_state.draws[1u] = glm::uvec4(0u, 1u, 0u, 0u);
+    glGenBuffers(1u, &gl_ring_state_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_ring_state_buffer_id_);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof ring_state, &ring_state, 0);
+  }
+
+  // The parallel nature of the sorting algorithm needs power of two sized buffer,
+  // of at least one bitonic block.
+  unsigned int const sort_buffer_max_count = std::max(GetClosestPowerOfTwo(num_particles), kSortLocalBlockWidth); //
+
+  // DotProducts buffer.
+  glGenBuffers(1u, &gl_dp_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_dp_buffer_id_);
+  GLuint const dp_buffer_size = sort_buffer_max_count * sizeof(GLfloat);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, dp_buffer_size, nullptr, 0);
+
+  // Double-sized buffer for indices sorting.
+  /// @note might use short instead.
+  glGenBuffers(1u, &gl_sort_indices_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_indices_buffer_id_);
+  GLuint const sort_indices_buffer_size = 2u * sort_buffer_max_count * sizeof(GLuint);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sort_indices_buffer_size, nullptr, 0);
+
+  // Radix sort keys, the DotProducts buffer is used as their first half.
+  glGenBuffers(1u, &gl_sort_keys_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_keys_buffer_id_);
+  GLuint const sort_keys_buffer_size = sort_buffer_max_count * sizeof(GLuint);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sort_keys_buffer_size, nullptr, 0);
+
+  // Radix sort digit histograms, for each block of keys.
+  glGenBuffers(1u, &gl_radix_histograms_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_radix_histograms_buffer_id_);
+  GLuint const histograms_buffer_size = RADIX_SORT_NUM_BUCKETS * GetThreadsGroupCount(sort_buffer_max_count) * sizeof(GLuint);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, histograms_buffer_size, nullptr, 0);
+
+  // Coherent sort buffers, previous ranks are written by the simulation.
+  unsigned int const max_rank_count = pbuffer_->element_count() + 1u;
+  glGenBuffers(1u, &gl_sort_previous_ranks_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_previous_ranks_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, pbuffer_->element_count() * sizeof(GLuint), nullptr, 0);
+
+  glGenBuffers(1u, &gl_sort_rank_slots_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_rank_slots_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, pbuffer_->element_count() * sizeof(GLuint), nullptr, 0);
+
+  glGenBuffers(1u, &gl_sort_offsets_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_offsets_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, max_rank_count * sizeof(GLuint), nullptr, 0);
+
+  glGenBuffers(1u, &gl_sort_insertions_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_sort_insertions_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, pbuffer_->element_count() * sizeof(glm::uvec2), nullptr, 0);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+
+  // Scans of the radix histograms, of the coherent sort ranks and of the emitters counts.
+  prefix_sum_.resize(std::max({
+    RADIX_SORT_NUM_BUCKETS * GetThreadsGroupCount(sort_buffer_max_count), max_rank_count, kMaxEmitterCount + 1u
+  }));
+
+  /* Setup rendering buffers */
+  _setup_render();
+
+  CHECKGLERROR();
+}
+
+void GPUParticle::_destroy_pool() {
+  if (pbuffer_) {
+    pbuffer_->deinitialize();
+    delete pbuffer_;
+    pbuffer_ = nullptr;
+  }
+
+  glDeleteBuffers(1u, &gl_dp_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_indices_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_keys_buffer_id_);
+  glDeleteBuffers(1u, &gl_radix_histograms_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_previous_ranks_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_rank_slots_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_offsets_buffer_id_);
+  glDeleteBuffers(1u, &gl_sort_insertions_buffer_id_);
+  glDeleteBuffers(2u, gl_alive_indices_buffer_ids_);
+  glDeleteBuffers(1u, &gl_free_list_buffer_id_);
+  glDeleteBuffers(1u, &gl_ring_state_buffer_id_);
+  glDeleteBuffers(1u, &gl_fluid_states_buffer_id_);
+  gl_alive_indices_buffer_ids_[0u] = 0u;
+  gl_alive_indices_buffer_ids_[1u] = 0u;
+  gl_free_list_buffer_id_ = 0u;
+  gl_ring_state_buffer_id_ = 0u;
+  gl_fluid_states_buffer_id_ = 0u;
+
+  glDeleteVertexArrays(2u, vaos_);
+}
+
 void GPUParticle::_setup_render() {
-  glGenVertexArrays(1u, &vao_);
-  glBindVertexArray(vao_);
+  glGenVertexArrays(2u, vaos_);
+
+  /* The storage buffers are swapped after simulation, so each one gets its
+   * own vertex array. */
+  GLuint const vbos[2u] = {
+    pbuffer_->first_storage_buffer_id(),
+    pbuffer_->second_storage_buffer_id()
+  };
+
+  for (unsigned int i = 0u; i < 2u; ++i) {
+    glBindVertexArray(vaos_[i]);
+
+    GLuint const vbo = vbos[i];
+
+    if (layout_ == LAYOUT_SOA) {
+      unsigned int const attrib_size = 4u * sizeof(float); // vec4
+      unsigned int const attrib_buffer_size = pbuffer_->single_attrib_buffer_size();
+
+      GLuint binding_point = 0u;
+      GLuint attrib_index = 0u;
+
+      // POSITION
+      binding_point = STORAGE_BINDING_PARTICLE_POSITIONS_A;
+      glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
+      {
+        unsigned int const num_component = 4u;  // and the rewind weight.
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(attrib_index, binding_point);
+        glEnableVertexAttribArray(attrib_index);
+        ++attrib_index;
+      }
+
+      // VELOCITY
+      binding_point = STORAGE_BINDING_PARTICLE_VELOCITIES_A;
+      glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
+      {
+        unsigned int const num_component = 3u;
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(attrib_index, binding_point);
+        glEnableVertexAttribArray(attrib_index);
+        ++attrib_index;
+      }
+
+      // AGE ATTRIBUTES
+      binding_point = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A;
+      glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
+      {
+        unsigned int const num_component = 2u;
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
+        glVertexAttribBinding(attrib_index, binding_point);
+        glEnableVertexAttribArray(attrib_index);
+        ++attrib_index;
+      }
+    } else if (layout_ == LAYOUT_PACKED) {
+      /// @note Offsets follow the layout described in inc_packing.
+      unsigned int const binding_index = 0u;
+      glBindVertexBuffer(binding_index, vbo, 0u, sizeof(TPackedParticle));
+      // Position, 16bit unorm.
+      {
+        unsigned int const attrib_index = 0u;
+        glVertexAttribFormat(attrib_index, 3u, GL_UNSIGNED_SHORT, GL_TRUE, 0u);
+        glVertexAttribBinding(attrib_index, binding_index);
+        glEnableVertexAttribArray(attrib_index);
+      }
+      // Velocity, half floats.
+      {
+        unsigned int const attrib_index = 1u;
+        glVertexAttribFormat(attrib_index, 3u, GL_HALF_FLOAT, GL_FALSE, 3u * sizeof(GLushort));
+        glVertexAttribBinding(attrib_index, binding_index);
+        glEnableVertexAttribArray(attrib_index);
+      }
+      // Age to start age ratio, 16bit unorm.
+      {
+        unsigned int const attrib_index = 2u;
+        glVertexAttribFormat(attrib_index, 1u, GL_UNSIGNED_SHORT, GL_TRUE, 7u * sizeof(GLushort));
+        glVertexAttribBinding(attrib_index, binding_index);
+        glEnableVertexAttribArray(attrib_index);
+      }
+    } else if ((layout_ == LAYOUT_AOSOA_32) || (layout_ == LAYOUT_AOSOA_64)) {
+      // Particles are pulled by the vertex shader, the array holds no attributes.
+    } else {
+      unsigned int const binding_index = 0u;
+      glBindVertexBuffer(binding_index, vbo, 0u, sizeof(TParticle));
+      // Particle's position
+      {
+        unsigned int const attrib_index = 0u;
+        unsigned int const num_component = static_cast<unsigned int>((sizeof TParticle::position) / sizeof(TParticle::position[0u]));
+        // Set the attribute format in Vertex Array
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, position));
+        // Bind attribute to a vertex buffer
+        glVertexAttribBinding(attrib_index, binding_index);
+        // Activate the attribute
+        glEnableVertexAttribArray(attrib_index);
+      }
+      // velocities
+      {
+        unsigned int const attrib_index = 1u;
+        unsigned int const num_component = static_cast<unsigned int>((sizeof TParticle::velocity) / sizeof(TParticle::velocity[0u]));
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, velocity));
+        glVertexAttribBinding(attrib_index, binding_index);
+        glEnableVertexAttribArray(attrib_index);
+      }
+      // Particle's age info
+      {
+        unsigned int const attrib_index = 2u;
+        unsigned int const num_component = 2u;
+        glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, start_age)); //
+        glVertexAttribBinding(attrib_index, binding_index);
+        glEnableVertexAttribArray(attrib_index);
+      }
+    }
+  }
 
-  GLuint const vbo = pbuffer_->first_storage_buffer_id();
+  glBindVertexArray(0u);
 
-#if SPARKLE_USE_SOA_LAYOUT
+  CHECKGLERROR();
+}
 
-  unsigned int const attrib_size = 4u * sizeof(float); // vec4
-  unsigned int const attrib_buffer_size = pbuffer_->single_attrib_buffer_size();
+void GPUParticle::_update_num_alive_particles() {
+  CPU_TRACE_SCOPE("GPUParticle::_update_num_alive_particles");
 
-  GLuint binding_point = 0u;
-  GLuint attrib_index = 0u;
+  static_assert(kEmitHistorySize > AppendConsumeBuffer::kReadbackRingSize + 1u,
+                "Emission history must cover the alive count readback latency.");
 
-  // POSITION
-  binding_point = STORAGE_BINDING_PARTICLE_POSITIONS_A;
-  glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
-  {
-    unsigned int const num_component = 3u;
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
-    glVertexAttribBinding(attrib_index, binding_point);
-    glEnableVertexAttribArray(attrib_index);
-    ++attrib_index;
+  if (enable_sync_readback_) {
+    return;
   }
 
-  // VELOCITY
-  binding_point = STORAGE_BINDING_PARTICLE_VELOCITIES_A;
-  glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
-  {
-    unsigned int const num_component = 3u;
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
-    glVertexAttribBinding(attrib_index, binding_point);
-    glEnableVertexAttribArray(attrib_index);
-    ++attrib_index;
+  unsigned int count, frame;
+  if (pbuffer_->latest_num_alive_particles(count, frame)) {
+    readback_next_frame_ = frame + 1u;
+  } else {
+    count = readback_base_count_;
   }
 
-  // AGE ATTRIBUTES
-  binding_point = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A;
-  glBindVertexBuffer(binding_point, vbo, attrib_index*attrib_buffer_size, attrib_size);
-  {
-    unsigned int const num_component = 2u;
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, 0);
-    glVertexAttribBinding(attrib_index, binding_point);
-    glEnableVertexAttribArray(attrib_index);
-    ++attrib_index;
+  /* Particles only die on device, so adding the emissions that happened since
+   * the readback frame gives an upper bound of the current count. */
+  unsigned int const latency = frame_index_ - readback_next_frame_;
+  if (latency < kEmitHistorySize) {
+    for (unsigned int i = readback_next_frame_; i < frame_index_; ++i) {
+      count += emit_history_[i % kEmitHistorySize];
+    }
+  } else {
+    // Unknown, the device might be full.
+    count = pbuffer_->element_count();
   }
 
-#else
+  num_alive_particles_ = std::min(count, pbuffer_->element_count());
+}
+
+void GPUParticle::_set_noise_seed(int const random_seed) {
+  /* The simulation and the baked field must share the permutation to sample
+   * the same noise. */
+  int const permutation_seed = PerlinPermutationSeed(random_seed);
+  glProgramUniform1i(pgm_.simulation, ulocation_.simulation.perlinNoisePermutationSeed, permutation_seed);
+  curlnoise_field_.set_permutation_seed(permutation_seed);
+  noise_seed_ = random_seed;
+}
 
-  unsigned int const binding_index = 0u;
-  glBindVertexBuffer(binding_index, vbo, 0u, sizeof(TParticle));
-  // Particle's position
-  {
-    unsigned int const attrib_index = 0u;
-    unsigned int const num_component = static_cast<unsigned int>((sizeof TParticle::position) / sizeof(TParticle::position[0u]));
-    // Set the attribute format in Vertex Array
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, position));
-    // Bind attribute to a vertex buffer
-    glVertexAttribBinding(attrib_index, binding_index);
-    // Activate the attribute
-    glEnableVertexAttribArray(attrib_index);
-  }
-  // velocities
-  {
-    unsigned int const attrib_index = 1u;
-    unsigned int const num_component = static_cast<unsigned int>((sizeof TParticle::velocity) / sizeof(TParticle::velocity[0u]));
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, velocity));
-    glVertexAttribBinding(attrib_index, binding_index);
-    glEnableVertexAttribArray(attrib_index);
+template<typename TEmissionLocations>
+void GPUParticle::_set_emission_uniforms(TEmissionLocations const& location, unsigned int const count) {
+  glUniform1ui(location.emitCount, count);
+  glUniform1ui(location.numEmitters, num_emitters());
+  glUniform1ui(location.maxParticleCount, pbuffer_->element_count());
+  glUniform1ui(location.randomSeed, static_cast<GLuint>(simulation_params_.random_seed));
+  glUniform1ui(location.frameIndex, frame_index_);
+}
+
+void GPUParticle::_upload_emitters() {
+  static_assert(sizeof(TEmitter) == 16u * sizeof(float), "TEmitter must match its std430 layout.");
+
+  /* The main emitter follows the simulation parameters. */
+  Emitter_t &main_emitter = emitters_[0u];
+  main_emitter.type   = simulation_params_.emitter_type;
+  std::copy(simulation_params_.emitter_position, simulation_params_.emitter_position + 3, main_emitter.position);
+  std::copy(simulation_params_.emitter_direction, simulation_params_.emitter_direction + 3, main_emitter.direction);
+  main_emitter.radius  = simulation_params_.emitter_radius;
+  main_emitter.rate    = simulation_params_.emission_rate;
+  main_emitter.min_age = simulation_params_.min_age;
+  main_emitter.max_age = simulation_params_.max_age;
+
+  /* It is sent every frame, the others only when added. */
+  unsigned int const upload_count = (num_uploaded_emitters_ < num_emitters()) ? num_emitters() : 1u;
+
+  std::vector<TEmitter> data(upload_count);
+  for (unsigned int i = 0u; i < upload_count; ++i) {
+    Emitter_t const& e = emitters_[i];
+    data[i].position  = glm::vec4(e.position[0], e.position[1], e.position[2], e.radius);
+    data[i].direction = glm::vec4(e.direction[0], e.direction[1], e.direction[2], 0.0f);
+    data[i].rate      = e.rate;
+    data[i].min_age   = e.min_age;
+    data[i].max_age   = e.max_age;
+    data[i].type      = static_cast<GLuint>(e.type);
+    data[i].system    = e.system;
+  }
+  glNamedBufferSubData(gl_emitters_buffer_id_, 0, upload_count * sizeof(TEmitter), data.data());
+
+  /* Added emitters start without pending particles. */
+  unsigned int const first_added = std::min(num_uploaded_emitters_, num_emitters());
+  if (first_added < num_emitters()) {
+    float const zero = 0.0f;
+    glClearNamedBufferSubData(
+      gl_emitter_accumulators_buffer_id_, GL_R32F,
+      first_added * sizeof(GLfloat), (num_emitters() - first_added) * sizeof(GLfloat), GL_RED, GL_FLOAT, &zero
+    );
+  }
+  num_uploaded_emitters_ = num_emitters();
+}
+
+void GPUParticle::_upload_systems() {
+  static_assert(sizeof(TSystem) == 8u * sizeof(float), "TSystem must match its std430 layout.");
+
+  /* The main system follows the simulation parameters. */
+  System_t &main_system = systems_[0u];
+  main_system.bounding_volume         = simulation_params_.bounding_volume;
+  main_system.bounding_volume_size    = simulation_params_.bounding_volume_size;
+  main_system.scattering_factor       = simulation_params_.scattering_factor;
+  main_system.vectorfield_factor      = simulation_params_.vectorfield_factor;
+  main_system.curlnoise_factor        = simulation_params_.curlnoise_factor;
+  main_system.velocity_factor         = simulation_params_.velocity_factor;
+  main_system.repulsion_factor        = simulation_params_.repulsion_factor;
+  main_system.enable_scattering       = simulation_params_.enable_scattering;
+  main_system.enable_vectorfield      = simulation_params_.enable_vectorfield;
+  main_system.enable_curlnoise        = simulation_params_.enable_curlnoise;
+  main_system.enable_velocity_control = simulation_params_.enable_velocity_control;
+  main_system.enable_repulsion        = simulation_params_.enable_repulsion;
+  main_system.enable_fluid            = simulation_params_.enable_fluid;
+
+  /* It is sent every frame, the others only when added. */
+  unsigned int const upload_count = (num_uploaded_systems_ < num_systems()) ? num_systems() : 1u;
+
+  std::vector<TSystem> data(upload_count);
+  for (unsigned int i = 0u; i < upload_count; ++i) {
+    System_t const& s = systems_[i];
+    data[i].scattering_factor  = s.scattering_factor;
+    data[i].vectorfield_factor = s.vectorfield_factor;
+    data[i].curlnoise_factor   = s.curlnoise_factor;
+    data[i].velocity_factor    = s.velocity_factor;
+    data[i].bbox_size          = s.bounding_volume_size;
+    data[i].bounding_volume    = static_cast<GLint>(s.bounding_volume);
+    data[i].repulsion_factor   = s.repulsion_factor;
+    data[i].flags              = (s.enable_scattering ? SYSTEM_FLAG_SCATTERING : 0u)
+                               | (s.enable_vectorfield ? SYSTEM_FLAG_VECTORFIELD : 0u)
+                               | (s.enable_curlnoise ? SYSTEM_FLAG_CURLNOISE : 0u)
+                               | (s.enable_velocity_control ? SYSTEM_FLAG_VELOCITY_CONTROL : 0u)
+                               | (s.enable_repulsion ? SYSTEM_FLAG_REPULSION : 0u)
+                               | (s.enable_fluid ? SYSTEM_FLAG_FLUID : 0u);
+  }
+  glNamedBufferSubData(gl_systems_buffer_id_, 0, upload_count * sizeof(TSystem), data.data());
+
+  num_uploaded_systems_ = num_systems();
+}
+
+unsigned int GPUParticle::_take_pending_bursts() {
+  /* The main emitter bursts are requested through the simulation parameters. */
+  if (simulation_params_.burst_count > 0) {
+    burst(0u, static_cast<unsigned int>(simulation_params_.burst_count));
+    simulation_params_.burst_count = 0;
+  }
+
+  unsigned int count = 0u;
+  for (auto const n : pending_bursts_) {
+    count = std::min(count + n, pbuffer_->element_count());
+  }
+  return count;
+}
+
+void GPUParticle::_update_emitters(float const time_step,
+                                   unsigned int const emit_budget,
+                                   bool const has_bursts) {
+  _upload_emitters();
+
+  /* Bursts are consumed by the emission args kernel. */
+  if (has_bursts) {
+    glNamedBufferSubData(gl_emitter_bursts_buffer_id_, 0, num_emitters() * sizeof(GLuint), pending_bursts_.data());
+    std::fill(pending_bursts_.begin(), pending_bursts_.end(), 0u);
   }
-  // Particle's age info
+
+  /* Each emitter count, from its rate and burst, then their offsets in the emitted
+   * particles. The emission kernels find the emitter of each particle from these
+   * offsets, so their cost does not depend on the number of emitters. */
+  profiler_.begin(PROFILE_EMITTER_COUNTS);
+  glUseProgram(pgm_.emitter_counts);
   {
-    unsigned int const attrib_index = 2u;
-    unsigned int const num_component = 2u;
-    glVertexAttribFormat(attrib_index, num_component, GL_FLOAT, GL_FALSE, offsetof(TParticle, start_age)); //
-    glVertexAttribBinding(attrib_index, binding_index);
-    glEnableVertexAttribArray(attrib_index);
+    glUniform1ui(ulocation_.emitter_counts.numEmitters, num_emitters());
+    glUniform1f(ulocation_.emitter_counts.timeStep, time_step);
+    glUniform1ui(ulocation_.emitter_counts.batchCount, batch_emit_count_);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTERS, gl_emitters_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_OFFSETS, gl_emitter_offsets_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_ACCUMULATORS, gl_emitter_accumulators_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_BURSTS, gl_emitter_bursts_buffer_id_);
+    glDispatchCompute(GetThreadsGroupCount(num_emitters()), 1u, 1u);
   }
+  glUseProgram(0u);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-#endif
+  prefix_sum_.run(gl_emitter_offsets_buffer_id_, num_emitters() + 1u);
 
-  glBindVertexArray(0u);
+  /* Clamp the total to the free slots, with the device alive count, and size
+   * the emission dispatch with it. The rate particles cut are kept in the
+   * accumulators, and the bursts are consumed. */
+  glUseProgram(pgm_.emission_args);
+  {
+    glUniform1ui(ulocation_.emission_args.numEmitters, num_emitters());
+    glUniform1ui(ulocation_.emission_args.emitCount, emit_budget);
+    glUniform1ui(ulocation_.emission_args.maxParticleCount, pbuffer_->element_count());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMISSION_ARGS, gl_emission_args_buffer_id_);
+    glDispatchCompute(1u, 1u, 1u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMISSION_ARGS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_BURSTS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_EMITTER_ACCUMULATORS, 0u);
+  }
+  glUseProgram(0u);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+  profiler_.end(PROFILE_EMITTER_COUNTS);
 
   CHECKGLERROR();
 }
 
-void GPUParticle::_emission(const unsigned int count) {
-  /* Emit only if a minimum count is reached. */
-  if (!count) {
-    return;
+void GPUParticle::_estimate_pipeline_traffic(unsigned int const emit_count) {
+  /* Bytes moved by each pipeline this frame, assuming every particle survives. */
+  double const particle_bytes = GetStoredParticleSize(layout_);
+  double const index_bytes = sizeof(GLuint);
+  double const read_count = num_alive_particles_;
+  double const simulated_count = read_count + emit_count;
+
+  // The emission writes the newborns, which the simulation reads back.
+  double split = emit_count * particle_bytes + 2.0 * simulated_count * particle_bytes;
+  double fused = read_count * particle_bytes + simulated_count * particle_bytes;
+
+  // Free list pool : the emission also pops a slot and lists it, the
+  // simulation reads the slots list and writes the next one.
+  if (pool_ == POOL_FREE_LIST) {
+    split += 2.0 * emit_count * index_bytes + 2.0 * simulated_count * index_bytes;
   }
-  if (count < kBatchEmitCount) {
-    //return;
+
+  // Ring pool : the emission also sets the slots ranks, and calculate_dp
+  // reads them to write the previous ranks, with the whole particles.
+  if (pool_ == POOL_RING) {
+    split += emit_count * index_bytes;
+    if (enable_sorting_) {
+      split += simulated_count * (particle_bytes - sizeof(glm::vec4));
+    }
   }
-  //fprintf(stderr, "> %7u particles to emit.\n", count);
 
-  glUseProgram(pgm_.emission);
+  if (enable_sorting_) {
+    // Previous ranks and depth keys, calculate_dp reads the positions back.
+    split += simulated_count * (2.0 * index_bytes + sizeof(glm::vec4));
+    fused += simulated_count * (2.0 * index_bytes);
+
+    // sort_final gathers the particles, or only their slots with the free list
+    // and ring pools (the ring writing back the slots ranks instead of reading).
+    double const gathered_bytes = (pool_ != POOL_APPEND_CONSUME) ? index_bytes : particle_bytes;
+    split += 2.0 * simulated_count * gathered_bytes;
+    fused += 2.0 * simulated_count * gathered_bytes;
+  }
+
+  // The free list and ring pools have no fused pipeline.
+  pipeline_traffic_.split_bytes = split;
+  pipeline_traffic_.fused_bytes = (pool_ != POOL_APPEND_CONSUME) ? split : fused;
+
+  // Particles storages, and the free list or ring pool indices.
+  double const capacity = pbuffer_->element_count();
+  double const num_index_lists = (pool_ == POOL_FREE_LIST) ? 3.0
+                               : (pool_ == POOL_RING)      ? 2.0
+                                                           : 0.0;
+  pipeline_traffic_.pool_bytes = pbuffer_->num_storage_buffers() * pbuffer_->storage_buffer_size()
+                               + num_index_lists * capacity * index_bytes;
+}
+
+bool GPUParticle::_use_repulsion() const {
+  return std::any_of(systems_.cbegin(), systems_.cend(), [](System_t const& s) {
+    return s.enable_repulsion;
+  });
+}
+
+bool GPUParticle::_use_fluid() const {
+  return std::any_of(systems_.cbegin(), systems_.cend(), [](System_t const& s) {
+    return s.enable_fluid;
+  });
+}
+
+bool GPUParticle::_use_spatial_grid() const {
+  return _use_repulsion() || _use_fluid();
+}
+
+void GPUParticle::_build_spatial_grid() {
+  CPU_TRACE_SCOPE("GPUParticle::_build_spatial_grid");
+
+  /* The grid storage follows the pool capacity, its cells the largest
+   * neighbours distance used, shared by every system. */
+  unsigned int const capacity = pbuffer_->element_count();
+  float const cell_size = std::max(_use_repulsion() ? simulation_params_.repulsion_radius : 0.0f,
+                                   _use_fluid() ? simulation_params_.fluid_radius : 0.0f);
+  spatial_grid_.resize(capacity);
+  spatial_grid_.set_domain(0.5f * simulation_params_.bounding_volume_size, cell_size);
+
+  /* The particles read by the simulation, emitted ones included unless the
+   * fused pipeline creates them there. */
+  profiler_.begin(PROFILE_GRID_BUILD);
+  spatial_grid_.build(std::min(num_alive_particles_, capacity));
+  profiler_.end(PROFILE_GRID_BUILD);
+}
+
+void GPUParticle::_fluid_density() {
+  CPU_TRACE_SCOPE("GPUParticle::_fluid_density");
+
+  /* One state per grid particle, at most the pool capacity. */
+  if (gl_fluid_states_buffer_id_ == 0u) {
+    glGenBuffers(1u, &gl_fluid_states_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_fluid_states_buffer_id_);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, pbuffer_->element_count() * sizeof(glm::vec4), nullptr, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+  }
+
+  spatial_grid_.bind();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, gl_fluid_states_buffer_id_);
+  glUseProgram(pgm_.fluid_density);
   {
-    glUniform1ui(ulocation_.emission.emitCount, count);
-    glUniform1ui(ulocation_.emission.emitterType, simulation_params_.emitter_type);
-    glUniform3fv(ulocation_.emission.emitterPosition, 1, simulation_params_.emitter_position);
-    glUniform3fv(ulocation_.emission.emitterDirection, 1, simulation_params_.emitter_direction);
-    glUniform1f(ulocation_.emission.emitterRadius, simulation_params_.emitter_radius);
-    glUniform1f(ulocation_.emission.particleMinAge, simulation_params_.min_age);
-    glUniform1f(ulocation_.emission.particleMaxAge, simulation_params_.max_age);
+    unsigned int const num_groups = GetThreadsGroupCount(std::min(num_alive_particles_, pbuffer_->element_count()));
+    glUniform1f(ulocation_.fluid_density.gridExtent, spatial_grid_.extent());
+    glUniform1ui(ulocation_.fluid_density.gridResolution, spatial_grid_.resolution());
+    glUniform1f(ulocation_.fluid_density.fluidRadius, simulation_params_.fluid_radius);
+    profiler_.begin(PROFILE_FLUID_DENSITY);
+    glDispatchCompute(num_groups, 1u, 1u);
+    profiler_.end(PROFILE_FLUID_DENSITY);
+  }
+  glUseProgram(0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, 0u);
+  spatial_grid_.unbind();
+
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-    unsigned int const nGroups = GetThreadsGroupCount(count);
-    glDispatchCompute(nGroups, 1u, 1u);
+  CHECKGLERROR();
+}
+
+void GPUParticle::_emission(unsigned int const budget, unsigned int const count) {
+  CPU_TRACE_SCOPE("GPUParticle::_emission");
+
+  glUseProgram(pgm_.emission);
+  {
+    _set_emission_uniforms(ulocation_.emission, budget);
+
+    /* Groups reserve their particles at once on the counter, seen as a storage buffer.
+     * The groups count was set on device by the emission_args kernel. */
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_APPEND_COUNTER, pbuffer_->first_atomic_buffer_id());
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, gl_emission_args_buffer_id_);
+    profiler_.begin(PROFILE_EMISSION);
+    glDispatchComputeIndirect(0);
+    profiler_.end(PROFILE_EMISSION);
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_APPEND_COUNTER, 0u);
   }
   glUseProgram(0u);
 
@@ -435,7 +1452,19 @@ void GPUParticle::_emission(const unsigned int count) {
   CHECKGLERROR();
 }
 
-void GPUParticle::_simulation(float const time_step) {
+void GPUParticle::_simulation(float const time_step,
+                              unsigned int const emit_budget,
+                              unsigned int const emit_count,
+                              glm::mat4x4 const& view) {
+  CPU_TRACE_SCOPE("GPUParticle::_simulation");
+
+  /* The fused pipeline emits past the simulated particles, its dispatch covers
+   * the whole budget as the device count is not known here. */
+  unsigned int const fused_emit_budget = _use_fused_pipeline() ? emit_budget : 0u;
+  unsigned int const fused_emit_count = _use_fused_pipeline() ? emit_count : 0u;
+  bool const write_depth_keys = _use_fused_pipeline() && enable_sorting_;
+  num_alive_particles_ += fused_emit_count;
+
   if (num_alive_particles_ == 0u) {
     simulated_ = false;
     return;
@@ -445,7 +1474,10 @@ void GPUParticle::_simulation(float const time_step) {
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDIRECT_ARGS, gl_indirect_buffer_id_);
   glUseProgram(pgm_.update_args);
   {
+    glUniform1ui(ulocation_.update_args.emitCount, fused_emit_budget);
+    profiler_.begin(PROFILE_UPDATE_ARGS);
     glDispatchCompute(1u, 1u, 1u);
+    profiler_.end(PROFILE_UPDATE_ARGS);
   }
   glUseProgram(0u);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDIRECT_ARGS, 0u);
@@ -453,36 +1485,141 @@ void GPUParticle::_simulation(float const time_step) {
   /* Synchronize the indirect argument buffer */
   glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
 
+  /* Forces of each system, read per particle. */
+  _upload_systems();
+
+  /* Neighbours of the particles to simulate, for the repulsion and the
+   * fluid, whose densities are needed before its forces. */
+  bool const use_spatial_grid = _use_spatial_grid();
+  bool const use_fluid = _use_fluid();
+  if (use_spatial_grid) {
+    _build_spatial_grid();
+  }
+  if (use_fluid) {
+    _fluid_density();
+  }
+
+  /* Dead particles slots are pushed from the top of the free list. */
+  if (pool_ == POOL_FREE_LIST) {
+    GLuint const zero = 0u;
+    glClearNamedBufferSubData(
+      gl_free_list_buffer_id_, GL_R32UI, 0u, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+    );
+  }
+
   /* Simulation Kernel */
   if (enable_vectorfield_) {
     glBindTexture(GL_TEXTURE_3D, vectorfield_.texture_id());
   }
 
+  if (simulation_params_.random_seed != noise_seed_) {
+    _set_noise_seed(simulation_params_.random_seed);
+  }
+
+  /* Rebake the curl noise texture when its parameters changed. */
+  const float inv_curlnoise_scale = 1.0f / simulation_params_.curlnoise_scale;
+  const float curlnoise_extent = 0.5f * simulation_params_.bounding_volume_size;
+  bool const use_baked_curlnoise = (simulation_params_.curlnoise_method == CURLNOISE_BAKED)
+                                && std::any_of(systems_.cbegin(), systems_.cend(), [](System_t const& s) {
+                                  return s.enable_curlnoise;
+                                });
+  if (use_baked_curlnoise) {
+    unsigned int const resolution = static_cast<unsigned int>(std::max(0, simulation_params_.curlnoise_resolution));
+    if (curlnoise_field_.outdated(resolution, curlnoise_extent, inv_curlnoise_scale)) {
+      profiler_.begin(PROFILE_CURLNOISE_BAKE);
+      curlnoise_field_.update(resolution, curlnoise_extent, inv_curlnoise_scale);
+      profiler_.end(PROFILE_CURLNOISE_BAKE);
+    }
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, curlnoise_field_.texture_id());
+    glActiveTexture(GL_TEXTURE0);
+  }
+
   glUseProgram(pgm_.simulation);
   {
     glUniform1f(ulocation_.simulation.timeStep, time_step);
     glUniform1i(ulocation_.simulation.vectorFieldSampler, 0);
-    glUniform1i(ulocation_.simulation.boundingVolume, simulation_params_.bounding_volume);
-    glUniform1f(ulocation_.simulation.bboxSize, simulation_params_.bounding_volume_size);
-
-    glUniform1f(ulocation_.simulation.scatteringFactor, simulation_params_.scattering_factor);
-    glUniform1f(ulocation_.simulation.vectorFieldFactor, simulation_params_.vectorfield_factor);
-    glUniform1f(ulocation_.simulation.curlNoiseFactor, simulation_params_.curlnoise_factor);
-    const float inv_curlnoise_scale = 1.0f / simulation_params_.curlnoise_scale;
     glUniform1f(ulocation_.simulation.curlNoiseScale, inv_curlnoise_scale);
-    glUniform1f(ulocation_.simulation.velocityFactor, simulation_params_.velocity_factor);
+    glUniform1i(ulocation_.simulation.curlNoiseMethod, simulation_params_.curlnoise_method);
+    glUniform1i(ulocation_.simulation.curlNoiseSampler, 1);
+    glUniform1f(ulocation_.simulation.curlNoiseExtent, curlnoise_extent);
+    glUniform1i(ulocation_.simulation.writePreviousRanks, enable_sorting_);
+    glUniform1ui(ulocation_.simulation.randomSeed, static_cast<GLuint>(simulation_params_.random_seed));
+    glUniform1ui(ulocation_.simulation.frameIndex, frame_index_);
+    glUniform1i(ulocation_.simulation.writeDepthKeys, write_depth_keys);
+    glUniformMatrix4fv(ulocation_.simulation.view, 1, GL_FALSE, glm::value_ptr(view));
+    glUniform1f(ulocation_.simulation.gridExtent, spatial_grid_.extent());
+    glUniform1ui(ulocation_.simulation.gridResolution, spatial_grid_.resolution());
+    glUniform1f(ulocation_.simulation.repulsionRadius, simulation_params_.repulsion_radius);
+    glUniform1f(ulocation_.simulation.fluidRadius, simulation_params_.fluid_radius);
+    glUniform1f(ulocation_.simulation.fluidRestDensity, simulation_params_.fluid_rest_density);
+    glUniform1f(ulocation_.simulation.fluidStiffness, simulation_params_.fluid_stiffness);
+    glUniform1f(ulocation_.simulation.fluidViscosity, simulation_params_.fluid_viscosity);
+    glUniform1f(ulocation_.simulation.fluidGravity, simulation_params_.fluid_gravity);
+    _set_emission_uniforms(ulocation_.fused_emission, fused_emit_budget);
+
+    if (use_spatial_grid) {
+      spatial_grid_.bind();
+    }
+    if (use_fluid) {
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, gl_fluid_states_buffer_id_);
+    }
 
-    glUniform1i(ulocation_.simulation.enableScattering, simulation_params_.enable_scattering);
-    glUniform1i(ulocation_.simulation.enableVectorField, simulation_params_.enable_vectorfield);
-    glUniform1i(ulocation_.simulation.enableCurlNoise, simulation_params_.enable_curlnoise);
-    glUniform1i(ulocation_.simulation.enableVelocityControl, simulation_params_.enable_velocity_control);
+    /* Depth keys past the simulated particles keep their clear value and are
+     * sorted last (see _sorting). */
+    if (write_depth_keys) {
+      unsigned int const clear_count = std::max(GetClosestPowerOfTwo(num_alive_particles_), kSortLocalBlockWidth);
+      float const clear_value = -FLT_MAX;
+      glClearNamedBufferSubData(
+        gl_dp_buffer_id_, GL_R32F, 0u, clear_count * sizeof(GLfloat), GL_RED, GL_FLOAT, &clear_value
+      );
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
+    }
 
+    /* Curl noise dominates this kernel, profile it to compare methods. */
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SYSTEMS, gl_systems_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, gl_sort_previous_ranks_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_APPEND_COUNTER, pbuffer_->second_atomic_buffer_id());
     glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, gl_indirect_buffer_id_);
+      profiler_.begin(PROFILE_SIMULATION);
       glDispatchComputeIndirect(0);
+
+      /* The ring tail moves past the particles dead before the first alive
+       * one, giving the ring count in the second counter. */
+      if (pool_ == POOL_RING) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        glUseProgram(pgm_.ring_advance);
+        glDispatchCompute(1u, 1u, 1u);
+        glUseProgram(pgm_.simulation);
+      }
+      profiler_.end(PROFILE_SIMULATION);
     glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_APPEND_COUNTER, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SYSTEMS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, 0u);
+    if (use_spatial_grid) {
+      spatial_grid_.unbind();
+    }
+    if (use_fluid) {
+      glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, 0u);
+    }
   }
   glUseProgram(0u);
 
+  /* Every particle was consumed, reset the read counter once instead of
+   * decrementing it per particle. */
+  GLuint const zero = 0u;
+  glClearNamedBufferSubData(
+    pbuffer_->first_atomic_buffer_id(), GL_R32UI, 0u, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+  );
+
+  if (use_baked_curlnoise) {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_3D, 0u);
+    glActiveTexture(GL_TEXTURE0);
+  }
   glBindTexture(GL_TEXTURE_3D, 0u);
 
   /* Synchronize operations on buffers. */
@@ -490,7 +1627,11 @@ void GPUParticle::_simulation(float const time_step) {
 
   /* Retrieve the number of alive particle to be used in the next frame. */
   /// @note Needed if we want to emit new particles.
-  num_alive_particles_ = pbuffer_->get_num_alive_particles_from_device();
+  if (enable_sync_readback_) {
+    num_alive_particles_ = pbuffer_->get_num_alive_particles_from_device();
+  } else {
+    pbuffer_->readback_num_alive_particles(frame_index_);
+  }
 
   simulated_ = true;
 
@@ -498,103 +1639,419 @@ void GPUParticle::_simulation(float const time_step) {
 }
 
 
-void GPUParticle::_sorting(glm::mat4x4 const& view) {
+void GPUParticle::_bind_pool() {
+  pbuffer_->bind_attributes();
+  if (pool_ == POOL_FREE_LIST) {
+    GLuint const free_list_buffers[3u] = {
+      gl_alive_indices_buffer_ids_[0u], gl_alive_indices_buffer_ids_[1u], gl_free_list_buffer_id_
+    };
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, 3u, free_list_buffers);
+  } else if (pool_ == POOL_RING) {
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, 2u, gl_alive_indices_buffer_ids_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RING_STATE, gl_ring_state_buffer_id_);
+  }
+}
+
+void GPUParticle::_unbind_pool() {
+  if (pool_ == POOL_FREE_LIST) {
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, 3u, nullptr);
+  } else if (pool_ == POOL_RING) {
+    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_ALIVE_INDICES_FIRST, 2u, nullptr);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RING_STATE, 0u);
+  }
+  pbuffer_->unbind_attributes();
+}
+
+void GPUParticle::_sorting(glm::mat4x4 const& view,
+                           bool const compute_keys,
+                           bool const coherent) {
+  CPU_TRACE_SCOPE("GPUParticle::_sorting");
+
   /** @note there is probably some remaining issues on kernels boundaries.*/
 
-  /* The algorithm works on buffer sized in power of two. */
-  unsigned int const max_elem_count = GetClosestPowerOfTwo(num_alive_particles_);
+  /* The benchmark cycles through engines, running each for a few frames so
+   * that the coherent sort reaches its steady state. */
+  SortEngine engine = enable_sort_benchmark_ ? static_cast<SortEngine>((frame_index_ / kSortBenchmarkSamples) % kNumSortEngine)
+                                             : rendering_params_.sort_engine;
+
+  /* Without a previous order the coherent sort starts with a full sort. */
+  if ((engine == SORT_COHERENT) && !coherent) {
+    engine = SORT_RADIX;
+  }
 
-  /* 1) Intialize indices and dotproducts buffers. */
+  /* The bitonic sort works on buffer sized in power of two, of at least one
+   * shared memory block. */
+  unsigned int const sort_count = (engine == SORT_BITONIC) ? std::max(GetClosestPowerOfTwo(num_alive_particles_), kSortLocalBlockWidth)
+                                                           : num_alive_particles_;
+
+  /* 1) Intialize the dotproducts buffer, unless the fused simulation wrote it. */
+  if (compute_keys) {
+    // Clear the dot product buffer.
+    float const clear_value = -FLT_MAX;
+    glClearNamedBufferSubData(
+      gl_dp_buffer_id_, GL_R32F, 0u, sort_count * sizeof(GLfloat), GL_RED, GL_FLOAT, &clear_value
+    );
+
+    // Compute dot products of particles toward the camera, and the ring pool previous ranks.
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, gl_sort_previous_ranks_buffer_id_);
+    glUseProgram(pgm_.calculate_dp);
+    {
+      /// @note No kernel boundaries check performed.
+      unsigned int const num_groups = GetThreadsGroupCount(num_alive_particles_); //
+      glUniformMatrix4fv(ulocation_.calculate_dp.view, 1, GL_FALSE, glm::value_ptr(view));
+      profiler_.begin(PROFILE_CALCULATE_DP);
+      glDispatchCompute(num_groups, 1u, 1u);
+      profiler_.end(PROFILE_CALCULATE_DP);
+    }
+    glUseProgram(0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, 0u);
 
-  // Fill first part of the indices buffer with continuous indices.
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, gl_sort_indices_buffer_id_);
-  glUseProgram(pgm_.fill_indices);
+    /* Synchronize the dotproducts buffer. */
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+
+  /* 2) Sort particle indices through their dot products. */
+  if (enable_sort_benchmark_) {
+    glBeginQuery(GL_TIME_ELAPSED, query_time_);
+  }
+
+  profiler_.begin(PROFILE_SORT_INDICES);
+  GLintptr sorted_offset = 0;
+  switch (engine) {
+    case SORT_BITONIC:
+      sorted_offset = _sort_indices_bitonic(sort_count);
+    break;
+
+    case SORT_COHERENT:
+      sorted_offset = _sort_indices_coherent(sort_count);
+    break;
+
+    case SORT_RADIX:
+    default:
+      sorted_offset = _sort_indices_radix(sort_count);
+    break;
+  }
+  profiler_.end(PROFILE_SORT_INDICES);
+
+  // bind the sorted indices to the first binding slot.
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, gl_sort_indices_buffer_id_, sorted_offset, sort_count * sizeof(GLuint));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, 0u);
+
+  if (enable_sort_benchmark_) {
+    glEndQuery(GL_TIME_ELAPSED);
+
+    // Count the pairs left out of order.
+    GLuint const zero = 0u;
+    glClearNamedBufferSubData(
+      gl_sort_state_buffer_id_, GL_R32UI, offsetof(TSortState, out_of_order), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+    );
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_STATE, gl_sort_state_buffer_id_);
+    glUseProgram(pgm_.sort_error);
+    {
+      glDispatchCompute(GetThreadsGroupCount(num_alive_particles_), 1u, 1u);
+    }
+    glUseProgram(0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, 0u);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_STATE, 0u);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    _record_sort_benchmark(engine, num_alive_particles_);
+  }
+
+  /* 3) Sort particles datas with their sorted indices. */
+
+  glUseProgram(pgm_.sort_final);
   {
-    unsigned int const num_groups = GetThreadsGroupCount(max_elem_count); //
+    /// @note could use the DispatchIndirect buffer.
+    unsigned int const num_groups = GetThreadsGroupCount(num_alive_particles_);
+    profiler_.begin(PROFILE_SORT_FINAL);
     glDispatchCompute(num_groups, 1u, 1u);
+    profiler_.end(PROFILE_SORT_FINAL);
   }
   glUseProgram(0u);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, 0u);
 
-  // Clear the dot product buffer.
-  float const clear_value = -FLT_MAX;
-  glClearNamedBufferSubData(
-    gl_dp_buffer_id_, GL_R32F, 0u, max_elem_count * sizeof(GLfloat), GL_RED, GL_FLOAT, &clear_value
+  /* Keep the sorted count for the next coherent sort. */
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  glCopyNamedBufferSubData(
+    pbuffer_->second_atomic_buffer_id(), gl_sort_state_buffer_id_, 0u, offsetof(TSortState, sorted_count), sizeof(GLuint)
   );
 
-  // Compute dot products of particles toward the camera.
+  CHECKGLERROR();
+}
+
+GLintptr GPUParticle::_sort_indices_bitonic(unsigned int const count) {
+  /* Steps are run in shared memory while their pairs fit in one block, only
+   * the stages with larger pairs distance use the global step kernel. */
+  unsigned int const num_threads = count / 2u;
+  unsigned int const num_groups = GetThreadsGroupCount(num_threads);
+
+  unsigned int const nsteps = GetNumTrailingBits(count);
+  unsigned int const nlocal_steps = GetNumTrailingBits(kSortLocalBlockWidth);
+  unsigned int const indices_half_size = count * sizeof(GLuint);
+
+  unsigned int binding = 0u;
+  auto bind_indices = [&]() {
+    // bind read / write indices buffers.
+    unsigned int const offset_read  = indices_half_size * binding;
+    unsigned int const offset_write = indices_half_size * (binding ^ 1u);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST,  gl_sort_indices_buffer_id_,  offset_read, indices_half_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, gl_sort_indices_buffer_id_, offset_write, indices_half_size);
+    binding ^= 1u;
+  };
+
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
-  glUseProgram(pgm_.calculate_dp);
+
+  // Sort each block, generating the indices.
+  bind_indices();
+  glUseProgram(pgm_.sort_local);
   {
-    /// @note No kernel boundaries check performed.
-    unsigned int const num_groups = GetThreadsGroupCount(num_alive_particles_); //
-    glUniformMatrix4fv(ulocation_.calculate_dp.view, 1, GL_FALSE, glm::value_ptr(view));
+    profiler_.begin(PROFILE_SORT_BITONIC_LOCAL);
     glDispatchCompute(num_groups, 1u, 1u);
+    profiler_.end(PROFILE_SORT_BITONIC_LOCAL);
   }
-  glUseProgram(0u);
-
-  /* Synchronize the indices and dotproducts buffers. */
   glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-  /* 2) Sort particle indices through their dot products. */
-  // [might be able to optimise early steps with one kernel, when max_block_width <= kernel_size]
-  unsigned int const num_threads = max_elem_count / 2u;
-  unsigned int const num_groups = GetThreadsGroupCount(num_threads);
+  profiler_.begin(PROFILE_SORT_BITONIC_STEPS);
+  for (unsigned int step = nlocal_steps; step < nsteps; ++step) {
+    GLuint const max_block_width = 2u << step;
 
-  unsigned int const nsteps = GetNumTrailingBits(max_elem_count);
-  unsigned int const indices_half_size = max_elem_count * sizeof(GLuint);
+    // Global stages.
+    glUseProgram(pgm_.sort_step);
+    glUniform1ui(ulocation_.sort_step.maxBlockWidth, max_block_width);
+    for (unsigned int stage = 0u; stage < step + 1u - nlocal_steps; ++stage) {
+      bind_indices();
 
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
-  glUseProgram(pgm_.sort_step);
-  unsigned int binding = 0u;
-  for (unsigned int step = 0u; step < nsteps; ++step) {
-    for (unsigned int stage = 0u; stage < step + 1u; ++stage) {
-      // bind read / write indices buffers.
-      unsigned int const offset_read  = indices_half_size * binding;
-      unsigned int const offset_write = indices_half_size * (binding ^ 1u);
-      glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST,  gl_sort_indices_buffer_id_,  offset_read, indices_half_size);
-      glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, gl_sort_indices_buffer_id_, offset_write, indices_half_size);
-      binding ^= 1u;
-
-      // compute kernel parameters.
       GLuint const block_width = 2u << (step - stage);
-      GLuint const max_block_width = 2u << step;
       glUniform1ui(ulocation_.sort_step.blockWidth, block_width);
-      glUniform1ui(ulocation_.sort_step.maxBlockWidth, max_block_width);
 
       glDispatchCompute(num_groups, 1u, 1u);
       glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
     }
+
+    // Remaining stages, in shared memory.
+    bind_indices();
+    glUseProgram(pgm_.sort_merge);
+    {
+      glUniform1ui(ulocation_.sort_merge.maxBlockWidth, max_block_width);
+      glDispatchCompute(num_groups, 1u, 1u);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
   }
+  profiler_.end(PROFILE_SORT_BITONIC_STEPS);
   glUseProgram(0u);
   glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, 0u);
 
-  /* 3) Sort particles datas with their sorted indices. */
-  // bind the sorted indices to the first binding slot.
-  GLuint const sorted_offset_read = indices_half_size * binding;
-  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, gl_sort_indices_buffer_id_, sorted_offset_read, indices_half_size);
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, 0u);
+  return indices_half_size * binding;
+}
 
-  glUseProgram(pgm_.sort_final);
+GLintptr GPUParticle::_sort_indices_radix(unsigned int const count) {
+  unsigned int const num_passes = (8u * sizeof(GLuint)) / RADIX_SORT_DIGIT_BITS;
+  unsigned int const num_blocks = GetThreadsGroupCount(count);
+  unsigned int const num_entries = RADIX_SORT_NUM_BUCKETS * num_blocks;
+
+  // Halves are rounded to the kernel width to keep ranges offset aligned.
+  GLsizeiptr const keys_size = count * sizeof(GLuint);
+  GLsizeiptr const indices_half_size = num_blocks * kThreadsGroupWidth * sizeof(GLuint);
+
+  // Keys are first read as depths from the DotProducts buffer, then ping-ponged.
+  GLuint const keys_buffers[2u] = { gl_dp_buffer_id_, gl_sort_keys_buffer_id_ };
+
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RADIX_HISTOGRAMS, gl_radix_histograms_buffer_id_, 0, num_entries * sizeof(GLuint));
+
+  profiler_.begin(PROFILE_SORT_RADIX_PASSES);
+  unsigned int binding = 0u;
+  for (unsigned int pass = 0u; pass < num_passes; ++pass) {
+    GLuint const digit_shift = pass * RADIX_SORT_DIGIT_BITS;
+    GLint const float_keys = (pass == 0u) ? GL_TRUE : GL_FALSE;
+
+    // bind read / write keys and indices buffers.
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_KEYS_FIRST,  keys_buffers[binding], 0, keys_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_KEYS_SECOND, keys_buffers[binding ^ 1u], 0, keys_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST,  gl_sort_indices_buffer_id_, indices_half_size * binding, indices_half_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, gl_sort_indices_buffer_id_, indices_half_size * (binding ^ 1u), indices_half_size);
+    binding ^= 1u;
+
+    // Count digits per block.
+    glUseProgram(pgm_.radix_count);
+    {
+      glUniform1ui(ulocation_.radix_count.numElements, count);
+      glUniform1ui(ulocation_.radix_count.digitShift, digit_shift);
+      glUniform1i(ulocation_.radix_count.floatKeys, float_keys);
+      glDispatchCompute(num_blocks, 1u, 1u);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // Scan the histograms into scatter offsets.
+    prefix_sum_.run(gl_radix_histograms_buffer_id_, num_entries);
+
+    // Move keys and indices to their sorted position for this digit.
+    glUseProgram(pgm_.radix_scatter);
+    {
+      glUniform1ui(ulocation_.radix_scatter.numElements, count);
+      glUniform1ui(ulocation_.radix_scatter.digitShift, digit_shift);
+      glUniform1i(ulocation_.radix_scatter.floatKeys, float_keys);
+      glDispatchCompute(num_blocks, 1u, 1u);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+  profiler_.end(PROFILE_SORT_RADIX_PASSES);
+  glUseProgram(0u);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_KEYS_FIRST, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_KEYS_SECOND, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RADIX_HISTOGRAMS, 0u);
+
+  return indices_half_size * binding;
+}
+
+GLintptr GPUParticle::_sort_indices_coherent(unsigned int const count) {
+  /* The storage read by the simulation was sorted by the previous frame, so
+   * the rank each particle was read from gives the previous order. */
+  unsigned int const num_groups = GetThreadsGroupCount(count);
+  unsigned int const num_ranks = count + 1u;
+  unsigned int const num_passes = static_cast<unsigned int>(std::max(0, rendering_params_.coherent_sort_passes));
+
+  // Halves are rounded to the kernel width to keep ranges offset aligned.
+  GLsizeiptr const indices_half_size = num_groups * kThreadsGroupWidth * sizeof(GLuint);
+
+  unsigned int binding = 0u;
+  auto bind_indices = [&]() {
+    // bind read / write indices buffers.
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST,  gl_sort_indices_buffer_id_, indices_half_size * binding, indices_half_size);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, gl_sort_indices_buffer_id_, indices_half_size * (binding ^ 1u), indices_half_size);
+    binding ^= 1u;
+  };
+
+  GLuint const zero = 0u;
+  auto clear_offsets = [&]() {
+    glClearNamedBufferSubData(
+      gl_sort_offsets_buffer_id_, GL_R32UI, 0u, num_ranks * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+    );
+  };
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, gl_dp_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, gl_sort_previous_ranks_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RANK_SLOTS, gl_sort_rank_slots_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_OFFSETS, gl_sort_offsets_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_INSERTIONS, gl_sort_insertions_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_STATE, gl_sort_state_buffer_id_);
+
+  /* 1) Previous order of the survivors, followed by the emitted particles. */
+  profiler_.begin(PROFILE_SORT_COHERENT_REBUILD);
+  clear_offsets();
+  glUseProgram(pgm_.sort_coherent_scatter);
   {
-    /// @note could use the DispatchIndirect buffer.
-    unsigned int const num_groups = GetThreadsGroupCount(num_alive_particles_);
     glDispatchCompute(num_groups, 1u, 1u);
   }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  prefix_sum_.run(gl_sort_offsets_buffer_id_, num_ranks);
+
+  bind_indices();
+  glUseProgram(pgm_.sort_coherent_compact);
+  {
+    glUniform1ui(ulocation_.sort_coherent_compact.numElements, count);
+    glDispatchCompute(GetThreadsGroupCount(num_ranks), 1u, 1u);
+  }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+  profiler_.end(PROFILE_SORT_COHERENT_REBUILD);
+
+  /* 2) Merge the emitted particles into the survivors. */
+  profiler_.begin(PROFILE_SORT_COHERENT_MERGE);
+  clear_offsets();
+  bind_indices();
+  glUseProgram(pgm_.sort_coherent_insert);
+  {
+    glDispatchCompute(num_groups, 1u, 1u);
+  }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  prefix_sum_.run(gl_sort_offsets_buffer_id_, num_ranks);
+
+  glUseProgram(pgm_.sort_coherent_merge);
+  {
+    glUniform1ui(ulocation_.sort_coherent_merge.numElements, count);
+    glDispatchCompute(num_groups, 1u, 1u);
+  }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  profiler_.end(PROFILE_SORT_COHERENT_MERGE);
+
+  /* 3) Bounded refinement, each pass sorts blocks in place, alternately
+   * offset by half a block. */
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, gl_sort_indices_buffer_id_, indices_half_size * binding, indices_half_size);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_SECOND, 0u);
+  glUseProgram(pgm_.sort_coherent_pass);
+  profiler_.begin(PROFILE_SORT_COHERENT_REFINE);
+  for (unsigned int pass = 0u; pass < num_passes; ++pass) {
+    GLuint const block_offset = (pass & 1u) * (kSortLocalBlockWidth / 2u);
+    glUniform1ui(ulocation_.sort_coherent_pass.blockOffset, block_offset);
+    glDispatchCompute(count / kSortLocalBlockWidth + 1u, 1u, 1u);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+  profiler_.end(PROFILE_SORT_COHERENT_REFINE);
   glUseProgram(0u);
-  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_INDICES_FIRST, 0u);
 
-  CHECKGLERROR();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_DOT_PRODUCTS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREVIOUS_RANKS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_RANK_SLOTS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_OFFSETS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_INSERTIONS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_SORT_STATE, 0u);
+
+  return indices_half_size * binding;
+}
+
+void GPUParticle::_record_sort_benchmark(SortEngine const engine, unsigned int const count) {
+  /// @note Waits for the results, benchmark mode stalls the pipeline.
+  GLuint64 elapsed = 0u;
+  glGetQueryObjectui64v(query_time_, GL_QUERY_RESULT, &elapsed);
+
+  TSortState state;
+  glGetNamedBufferSubData(gl_sort_state_buffer_id_, 0, sizeof(state), &state);
+  GLuint num_particles = 0u;
+  glGetNamedBufferSubData(pbuffer_->second_atomic_buffer_id(), 0, sizeof(num_particles), &num_particles);
+  double const error = (num_particles > 1u) ? state.out_of_order / static_cast<double>(num_particles - 1u) : 0.0;
+
+  unsigned int const row_id = std::min(GetNumTrailingBits(GetClosestPowerOfTwo(count)), kSortBenchmarkRows - 1u);
+  auto &row = sort_benchmark_[row_id];
+  row.total_time[engine] += elapsed;
+  row.total_error[engine] += error;
+  row.num_samples[engine] += 1u;
+
+  for (unsigned int i = 0u; i < kNumSortEngine; ++i) {
+    if (row.num_samples[i] < kSortBenchmarkSamples) {
+      return;
+    }
+  }
+
+  /* Every engine has enough samples for this particle count, print them. */
+  fprintf(stderr, "[ sort benchmark ] <= %7u particles", 1u << row_id);
+  for (unsigned int i = 0u; i < kNumSortEngine; ++i) {
+    double const time_ms = 1.0e-6 * row.total_time[i] / row.num_samples[i];
+    double const error_pct = 100.0 * row.total_error[i] / row.num_samples[i];
+    fprintf(stderr, " | %s %8.3f ms %6.2f%% unsorted", kSortEngineNames[i], time_ms, error_pct);
+  }
+  fprintf(stderr, "\n");
+  row = {};
 }
 
 void GPUParticle::_postprocess() {
+  CPU_TRACE_SCOPE("GPUParticle::_postprocess");
+
   if (simulated_) {
     /* Swap atomic counter to have number of alives particles in the first slot */
     pbuffer_->swap_atomics();
 
-    /* Copy non sorted alives particles back to the first buffer. */
-    if (!enable_sorting_) {
-      pbuffer_->swap_storage();
+    /* Ping-pong the alive particles to the first buffer, end_frame swaps
+     * them back to sort them there. The ring pool lists are not swapped, the
+     * ring itself being drawn unsorted. */
+    pbuffer_->swap_storage();
+    if (pool_ == POOL_FREE_LIST) {
+      _swap_alive_indices();
     }
   }
 
@@ -605,3 +2062,8 @@ void GPUParticle::_postprocess() {
   );
   CHECKGLERROR();
 }
+
+void GPUParticle::_swap_alive_indices() {
+  /* The free list pool storage is never swapped, its alive indices are. */
+  std::swap(gl_alive_indices_buffer_ids_[0u], gl_alive_indices_buffer_ids_[1u]);
+}
@@ -4,10 +4,14 @@
 /* -------------------------------------------------------------------------- */
 
 #include <algorithm>
+#include <vector>
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
 #include "opengl.h"
-#include "api/random_buffer.h"
+#include "api/curl_noise_field.h"
+#include "api/gpu_profiler.h"
+#include "api/prefix_sum.h"
+#include "api/spatial_grid.h"
 #include "api/vector_field.h"
 
 class AppendConsumeBuffer;
@@ -25,6 +29,9 @@ class GPUParticle
 {
 public:
   static float constexpr kDefaultSimulationVolumeSize = 256.0f;
+  static unsigned int const kDefaultMaxParticleCount = (1u << 18u);
+  static unsigned int const kMaxEmitterCount;
+  static unsigned int const kMaxSystemCount;
 
   enum EmitterType {
     EMITTER_POINT,
@@ -41,8 +48,20 @@ public:
     kNumSimulationVolume
   };
 
+  enum CurlNoiseMethod {
+    CURLNOISE_ANALYTIC,
+    CURLNOISE_FINITE_DIFFERENCES,
+    CURLNOISE_BAKED,
+    kNumCurlNoiseMethod
+  };
+
   struct SimulationParameters_t {
     float time_step_factor = 1.0f;
+    int simulation_rate = 60;       //< fixed steps per second, 0 to follow the frame rate.
+    int max_substeps = 4;           //< steps per frame at most, late time is dropped.
+    int random_seed = 0;
+    float emission_rate = 0.0f;     //< particles per second of the main emitter, 0 for the whole budget.
+    int burst_count = 0;            //< particles emitted once by the main emitter, reset by update.
     float min_age = 50.0f;
     float max_age = 100.0f;
     EmitterType emitter_type = EmitterType::EMITTER_SPHERE;
@@ -56,12 +75,52 @@ public:
     float vectorfield_factor = 1.0f;
     float curlnoise_factor = 16.0f;
     float curlnoise_scale = 128.0f;
+    CurlNoiseMethod curlnoise_method = CurlNoiseMethod::CURLNOISE_ANALYTIC;
+    int curlnoise_resolution = 64;
     float velocity_factor = 8.0f;
+    float repulsion_factor = 4.0f;
+    float repulsion_radius = 4.0f;  //< neighbours distance, the spatial grid cell size of every system.
+    float fluid_radius = 2.0f;        //< SPH smoothing radius, shared by every system.
+    float fluid_rest_density = 1.0f;  //< particles per unit volume at rest.
+    float fluid_stiffness = 20.0f;    //< pressure per density above the rest one.
+    float fluid_viscosity = 0.5f;
+    float fluid_gravity = 9.81f;
 
     bool enable_scattering = false;
     bool enable_vectorfield = false;
     bool enable_curlnoise = true;
     bool enable_velocity_control = true;
+    bool enable_repulsion = false;
+    bool enable_fluid = false;      //< smoothed particle hydrodynamics forces and gravity.
+  };
+
+  /* Entry of the emitters table, see add_emitter. */
+  struct Emitter_t {
+    EmitterType type = EMITTER_SPHERE;
+    float position[3]  = { 0.0f, 0.0f, 0.0f };
+    float direction[3] = { 0.0f, 1.0f, 0.0f };
+    float radius = 32.0f;
+    float rate = 0.0f;              //< particles per second, 0 or less emits the whole budget.
+    float min_age = 50.0f;
+    float max_age = 100.0f;
+    unsigned int system = 0u;       //< index of the particles system, see add_system.
+  };
+
+  /* Entry of the systems table, the forces of its particles. */
+  struct System_t {
+    SimulationVolume bounding_volume = SimulationVolume::VOLUME_SPHERE;
+    float bounding_volume_size = kDefaultSimulationVolumeSize;
+    float scattering_factor = 1.0f;
+    float vectorfield_factor = 1.0f;
+    float curlnoise_factor = 16.0f;
+    float velocity_factor = 8.0f;
+    float repulsion_factor = 4.0f;
+    bool enable_scattering = false;
+    bool enable_vectorfield = false;
+    bool enable_curlnoise = true;
+    bool enable_velocity_control = true;
+    bool enable_repulsion = false;
+    bool enable_fluid = false;
   };
 
   enum RenderMode {
@@ -76,6 +135,37 @@ public:
     kNumColorMode
   };
 
+  enum SortEngine {
+    SORT_BITONIC,
+    SORT_RADIX,
+    SORT_COHERENT,
+    kNumSortEngine
+  };
+
+  /* Storage of the particles, chosen at initialization. */
+  enum ParticleLayout {
+    LAYOUT_AOS,
+    LAYOUT_SOA,
+    LAYOUT_AOSOA_32,
+    LAYOUT_AOSOA_64,
+    LAYOUT_PACKED,
+    kNumParticleLayout
+  };
+
+  /* Management of the particles pool, chosen at initialization.
+   * The append / consume pool simulates the particles from one storage buffer
+   * to the other, compacting the alive ones. The free list pool updates them
+   * in place in a single buffer and lists the alive ones by index, the slots
+   * of the dead ones being reused by the emission. The ring pool updates them
+   * in place in emission order, releasing the dead ones from its tail and
+   * masking those dying out of order. */
+  enum ParticlePool {
+    POOL_APPEND_CONSUME,
+    POOL_FREE_LIST,
+    POOL_RING,
+    kNumParticlePool
+  };
+
   struct RenderingParameters_t {
     RenderMode rendermode = RENDERMODE_STRETCHED;
     float stretched_factor = 10.0f;
@@ -85,25 +175,114 @@ public:
     float min_size = 0.75f;
     float max_size = 25.0f;
     float fading_factor = 0.35f;
+    bool enable_alpha_blending = false;
+    SortEngine sort_engine = SORT_RADIX;
+    int coherent_sort_passes = 2;
+  };
+
+  /* GPU timed sections, nested ones follow their parent. */
+  enum ProfileSection {
+    PROFILE_EMITTER_COUNTS,
+    PROFILE_EMISSION,
+    PROFILE_UPDATE_ARGS,
+    PROFILE_GRID_BUILD,
+    PROFILE_FLUID_DENSITY,
+    PROFILE_CURLNOISE_BAKE,
+    PROFILE_SIMULATION,
+    PROFILE_CALCULATE_DP,
+    PROFILE_SORT_INDICES,
+    PROFILE_SORT_BITONIC_LOCAL,
+    PROFILE_SORT_BITONIC_STEPS,
+    PROFILE_SORT_RADIX_PASSES,
+    PROFILE_SORT_COHERENT_REBUILD,
+    PROFILE_SORT_COHERENT_MERGE,
+    PROFILE_SORT_COHERENT_REFINE,
+    PROFILE_SORT_FINAL,
+    PROFILE_POSTPROCESS,
+    PROFILE_RENDER,
+    kNumProfileSection
+  };
+
+  /* Estimated memory traffic of the last frame, for both pipelines, and the
+   * device memory of the pool. */
+  struct PipelineTraffic_t {
+    double split_bytes = 0.0;
+    double fused_bytes = 0.0;
+    double pool_bytes = 0.0;
   };
 
   GPUParticle() :
     num_alive_particles_(0u),
+    frame_index_(0u),
+    noise_seed_(0),
+    layout_(LAYOUT_AOS),
+    pool_(POOL_APPEND_CONSUME),
+    batch_emit_count_(0u),
+    render_rewind_time_(0.0f),
+    sorted_view_(1.0f),
     pbuffer_(nullptr),
+    num_uploaded_emitters_(0u),
+    num_uploaded_systems_(0u),
     gl_indirect_buffer_id_(0u),
     gl_dp_buffer_id_(0u),
     gl_sort_indices_buffer_id_(0u),
-    vao_(0u),
+    gl_sort_keys_buffer_id_(0u),
+    gl_radix_histograms_buffer_id_(0u),
+    gl_sort_previous_ranks_buffer_id_(0u),
+    gl_sort_rank_slots_buffer_id_(0u),
+    gl_sort_offsets_buffer_id_(0u),
+    gl_sort_insertions_buffer_id_(0u),
+    gl_sort_state_buffer_id_(0u),
+    gl_emitters_buffer_id_(0u),
+    gl_emitter_offsets_buffer_id_(0u),
+    gl_emitter_accumulators_buffer_id_(0u),
+    gl_emitter_bursts_buffer_id_(0u),
+    gl_emission_args_buffer_id_(0u),
+    gl_systems_buffer_id_(0u),
+    gl_alive_indices_buffer_ids_{0u, 0u},
+    gl_free_list_buffer_id_(0u),
+    gl_ring_state_buffer_id_(0u),
+    gl_fluid_states_buffer_id_(0u),
+    vaos_{0u, 0u},
     query_time_(0u),
+    readback_next_frame_(0u),
+    readback_base_count_(0u),
     simulated_(false),
+    sorted_last_frame_(false),
+    stepped_since_sort_(false),
+    coherent_order_(false),
+    depth_keys_written_(false),
     enable_sorting_(false),
-    enable_vectorfield_(true)
+    enable_vectorfield_(true),
+    enable_sync_readback_(false),
+    enable_sort_benchmark_(false),
+    enable_fused_pipeline_(false)
   {}
 
-  void init();
+  /// @param max_particle_count pool capacity, floored to the kernels group width.
+  void init(ParticleLayout const layout = LAYOUT_AOS,
+            unsigned int const max_particle_count = kDefaultMaxParticleCount,
+            ParticlePool const pool = POOL_APPEND_CONSUME);
   void deinit();
 
+  /// Name of a layout, as given on the command line.
+  static char const* LayoutName(ParticleLayout const layout);
+
+  /// Name of a pool, as given on the command line.
+  static char const* PoolName(ParticlePool const pool);
+
+  /// Start a rendered frame, before its simulation steps.
+  void begin_frame();
+
+  /// Simulation step, a rendered frame takes any number of them.
   void update(float const dt, glm::mat4x4 const& view);
+
+  /// End a rendered frame after its simulation steps : particles are sorted
+  /// once for the view, also without a step when the view moved, and are
+  /// rendered moved back by rewind_time, to interpolate between the last two
+  /// fixed timesteps.
+  void end_frame(glm::mat4x4 const& view, float const rewind_time = 0.0f);
+
   void render(glm::mat4x4 const& view, glm::mat4x4 const& viewProj);
 
   inline SimulationParameters_t& simulation_parameters() {
@@ -120,14 +299,93 @@ public:
 
   inline void enable_sorting(bool status) { enable_sorting_ = status; }
   inline void enable_vectorfield(bool status) { enable_vectorfield_ = status; }
+  inline void enable_sync_readback(bool status) { enable_sync_readback_ = status; }
+  inline void enable_sort_benchmark(bool status) { enable_sort_benchmark_ = status; }
+  /// @note Ignored by the free list and ring pools, whose emission and
+  /// simulation can't share a dispatch (see inc_free_list and inc_ring).
+  inline void enable_fused_pipeline(bool status) { enable_fused_pipeline_ = status; }
+
+  inline const PipelineTraffic_t& pipeline_traffic() const {
+    return pipeline_traffic_;
+  }
+
+  inline ParticleLayout layout() const { return layout_; }
+
+  /// Largest bounding_volume_size the particles layout can hold, sizes above
+  /// it are reduced on init. Later sizes must stay below it, as the
+  /// Simulation view does.
+  float max_bounding_volume_size() const;
+  inline ParticlePool pool() const { return pool_; }
+
+  /// Add an emitter after the main one, which follows the simulation
+  /// parameters. Emitters share the per frame emission budget, they are
+  /// all emitted by a single dispatch.
+  /// @return false when the table is full or the emitter system is unknown.
+  bool add_emitter(Emitter_t const& emitter);
+
+  /// Remove every emitter but the main one.
+  void clear_emitters();
+
+  inline unsigned int num_emitters() const {
+    return static_cast<unsigned int>(emitters_.size());
+  }
+
+  /// Emit count particles once from an emitter, on top of its rate and of
+  /// the per frame budget, on the next update. Particles past the free
+  /// slots of the pool are dropped.
+  /// @return false when the emitter is unknown.
+  bool burst(unsigned int const emitter, unsigned int const count);
+
+  /// Add a particles system after the main one, which follows the simulation
+  /// parameters. Systems share the particles pool and are all simulated,
+  /// sorted and rendered together, their particles come from the emitters
+  /// referencing them.
+  /// @return the system index, or -1 when the table is full or the layout is
+  /// LAYOUT_PACKED, whose particles have no room for their system.
+  int add_system(System_t const& system);
+
+  /// Remove every system but the main one, with the emitters of the others.
+  void clear_systems();
+
+  inline unsigned int num_systems() const {
+    return static_cast<unsigned int>(systems_.size());
+  }
+
+  /// Reallocate the pool, and the buffers sized by it, for a new capacity
+  /// floored to the kernels group width. Alive particles are moved on device,
+  /// those past the new capacity are dropped.
+  /// To be called between frames, it waits for the device.
+  void resize(unsigned int const max_particle_count);
+
+  /// Upper bound of the alive particles, exact with sync readback.
+  /// The ring pool also counts the masked particles before its head.
+  inline unsigned int num_alive_particles() const { return num_alive_particles_; }
+  unsigned int max_particle_count() const;
+
+  inline GPUProfiler& profiler() {
+    return profiler_;
+  }
+
+  /// Grid of the particles neighbours, built before the simulation when a
+  /// system uses the repulsion or the fluid.
+  inline SpatialGrid& spatial_grid() {
+    return spatial_grid_;
+  }
 
 private:
   // [STATIC]
   static unsigned int const kThreadsGroupWidth;
+  static unsigned int const kSortLocalBlockWidth;
 
   // [USER DEFINED]
-  static unsigned int const kMaxParticleCount = (1u << 18u);
-  static unsigned int const kBatchEmitCount   = std::max(256u, (kMaxParticleCount >> 4u));
+  // Frames of emission kept to compensate the alive particles readback latency.
+  static unsigned int const kEmitHistorySize  = 8u;
+
+  // Samples per engine averaged by each line of the sorting benchmark, engines
+  // are also run for this many consecutive frames.
+  static unsigned int const kSortBenchmarkSamples = 64u;
+  // Benchmark rows, one per power of two particle count.
+  static unsigned int const kSortBenchmarkRows = 32u;
 
   static
   unsigned int GetThreadsGroupCount(unsigned int const nthreads) {
@@ -139,58 +397,151 @@ private:
     return kThreadsGroupWidth * (nparticles / kThreadsGroupWidth);
   }
 
+  /* The free list and ring pools keep the split pipeline. */
+  inline bool _use_fused_pipeline() const {
+    return enable_fused_pipeline_ && (pool_ == POOL_APPEND_CONSUME);
+  }
+
+  void _create_pool(unsigned int const max_particle_count);
+  void _destroy_pool();
+  void _compact_pool(AppendConsumeBuffer *previous_pbuffer,
+                     GLuint const previous_alive_indices,
+                     unsigned int const previous_ring_tail,
+                     unsigned int const count);
   void _setup_render();
 
-  void _emission(unsigned int const count);
-  void _simulation(float const time_step);
+  void _update_num_alive_particles();
+  void _set_noise_seed(int const random_seed);
+  template<typename TEmissionLocations>
+  void _set_emission_uniforms(TEmissionLocations const& location, unsigned int const count);
+  void _upload_emitters();
+  void _upload_systems();
+  unsigned int _take_pending_bursts();
+  void _update_emitters(float const time_step, unsigned int const emit_budget, bool const has_bursts);
+  void _estimate_pipeline_traffic(unsigned int const emit_count);
+  bool _use_repulsion() const;
+  bool _use_fluid() const;
+  bool _use_spatial_grid() const;
+  void _build_spatial_grid();
+  void _fluid_density();
+  void _emission(unsigned int const budget, unsigned int const count);
+  void _simulation(float const time_step,
+                   unsigned int const emit_budget,
+                   unsigned int const emit_count,
+                   glm::mat4x4 const& view);
   void _postprocess();
-  void _sorting(glm::mat4x4 const& view);
+  void _swap_alive_indices();
+  void _bind_pool();
+  void _unbind_pool();
+  void _sorting(glm::mat4x4 const& view,
+                bool const compute_keys,
+                bool const coherent);
+  GLintptr _sort_indices_bitonic(unsigned int const count);
+  GLintptr _sort_indices_radix(unsigned int const count);
+  GLintptr _sort_indices_coherent(unsigned int const count);
+  void _record_sort_benchmark(SortEngine const engine, unsigned int const count);
 
   SimulationParameters_t simulation_params_;
   RenderingParameters_t rendering_params_;
 
-  unsigned int num_alive_particles_;              //< number of particle written and rendered on last frame.
+  unsigned int num_alive_particles_;              //< upper bound of the particles alive on device.
+  unsigned int frame_index_;                      //< simulation steps since init, keys random values.
+  int noise_seed_;                                //< random seed the noise permutation is derived from.
+  ParticleLayout layout_;                         //< storage layout the kernels are built for.
+  ParticlePool pool_;                             //< pool management the kernels are built for.
+  unsigned int batch_emit_count_;                 //< particles emitted per frame at most.
+  float render_rewind_time_;                      //< time back from the last state when rendering.
+  glm::mat4x4 sorted_view_;                       //< view of the last sort.
   AppendConsumeBuffer *pbuffer_;                  //< Append / Consume buffer for particles.
-  RandomBuffer randbuffer_;                       //< StorageBuffer to hold random values.
   VectorField vectorfield_;                       //< Vector field handler.
+  CurlNoiseField curlnoise_field_;                //< Baked curl noise, used with CURLNOISE_BAKED.
+  PrefixSum prefix_sum_;                          //< Scan used by the sorting engines.
+  SpatialGrid spatial_grid_;                      //< Neighbours of the simulated particles, for the repulsion and the fluid.
+  GPUProfiler profiler_;                          //< Timings of the ProfileSection, read back a few frames late.
+  std::vector<Emitter_t> emitters_;               //< Emitters table, the main one first.
+  unsigned int num_uploaded_emitters_;            //< emitters of the table up to date on device.
+  std::vector<unsigned int> pending_bursts_;      //< particles to burst from each emitter on next update.
+  std::vector<System_t> systems_;                 //< Particles systems table, the main one first.
+  unsigned int num_uploaded_systems_;             //< systems of the table up to date on device.
 
   struct {
+    GLuint emitter_counts;
+    GLuint emission_args;
+    GLuint pool_compact;
+    GLuint ring_advance;
+    GLuint fluid_density;
     GLuint emission;
     GLuint update_args;
     GLuint simulation;
-    GLuint fill_indices;
     GLuint calculate_dp;
+    GLuint sort_local;
+    GLuint sort_merge;
     GLuint sort_step;
     GLuint sort_final;
+    GLuint radix_count;
+    GLuint radix_scatter;
+    GLuint sort_coherent_scatter;
+    GLuint sort_coherent_compact;
+    GLuint sort_coherent_insert;
+    GLuint sort_coherent_merge;
+    GLuint sort_coherent_pass;
+    GLuint sort_error;
     GLuint render_point_sprite;
     GLuint render_stretched_sprite;
   } pgm_;                                         //< Pipeline's shaders.
 
   struct {
+    struct {
+      GLint numEmitters;
+      GLint timeStep;
+      GLint batchCount;
+    } emitter_counts;
+    struct {
+      GLint numEmitters;
+      GLint emitCount;
+      GLint maxParticleCount;
+    } emission_args;
+    struct {
+      GLint numParticles;
+      GLint ringTail;
+      GLint ringCapacity;
+    } pool_compact;
+    struct {
+      GLint emitCount;
+      GLint numEmitters;
+      GLint maxParticleCount;
+      GLint randomSeed;
+      GLint frameIndex;
+    } emission, fused_emission;
     struct {
       GLint emitCount;
-      GLint emitterType;
-      GLint emitterPosition;
-      GLint emitterDirection;
-      GLint emitterRadius;
-      GLint particleMinAge;
-      GLint particleMaxAge;
-    } emission;
+    } update_args;
+    struct {
+      GLint gridExtent;
+      GLint gridResolution;
+      GLint fluidRadius;
+    } fluid_density;
     struct {
       GLint timeStep;
       GLint vectorFieldSampler;
-      GLint bboxSize;
-      GLint boundingVolume;
-
-      GLint scatteringFactor;
-      GLint vectorFieldFactor;
-      GLint curlNoiseFactor;
       GLint curlNoiseScale;
-      GLint velocityFactor;
-      GLint enableScattering;
-      GLint enableVectorField;
-      GLint enableCurlNoise;
-      GLint enableVelocityControl;
+      GLint curlNoiseMethod;
+      GLint curlNoiseSampler;
+      GLint curlNoiseExtent;
+      GLint perlinNoisePermutationSeed;
+      GLint writePreviousRanks;
+      GLint randomSeed;
+      GLint frameIndex;
+      GLint writeDepthKeys;
+      GLint view;
+      GLint gridExtent;
+      GLint gridResolution;
+      GLint repulsionRadius;
+      GLint fluidRadius;
+      GLint fluidRestDensity;
+      GLint fluidStiffness;
+      GLint fluidViscosity;
+      GLint fluidGravity;
     } simulation;
     struct {
       GLint view;
@@ -199,6 +550,20 @@ private:
       GLint blockWidth;
       GLint maxBlockWidth;
     } sort_step;
+    struct {
+      GLint maxBlockWidth;
+    } sort_merge;
+    struct {
+      GLint numElements;
+      GLint digitShift;
+      GLint floatKeys;
+    } radix_count, radix_scatter;
+    struct {
+      GLint numElements;
+    } sort_coherent_compact, sort_coherent_merge;
+    struct {
+      GLint blockOffset;
+    } sort_coherent_pass;
     struct {
       GLint mvp;
       GLint minParticleSize;
@@ -207,6 +572,9 @@ private:
       GLint birthGradient;
       GLint deathGradient;
       GLint fadeCoefficient;
+      GLint rewindTime;
+      GLint boundingVolume;
+      GLint boundingVolumeSize;
     } render_point_sprite;
     struct {
       GLint view;
@@ -216,6 +584,9 @@ private:
       GLint deathGradient;
       GLint spriteStretchFactor;
       GLint fadeCoefficient;
+      GLint rewindTime;
+      GLint boundingVolume;
+      GLint boundingVolumeSize;
     } render_stretched_sprite;
   } ulocation_;                                   //< Programs uniform location.
 
@@ -226,13 +597,49 @@ private:
   GLuint gl_indirect_buffer_id_;                  //< Indirect Dispatch / Draw buffer.
   GLuint gl_dp_buffer_id_;                        //< DotProduct buffer.
   GLuint gl_sort_indices_buffer_id_;              //< indices buffer (for sorting).
-
-  GLuint vao_;                                    //< VAO for rendering.
+  GLuint gl_sort_keys_buffer_id_;                 //< radix sort keys, ping-ponged with the DotProduct buffer.
+  GLuint gl_radix_histograms_buffer_id_;          //< radix sort digit count of each block.
+  GLuint gl_sort_previous_ranks_buffer_id_;       //< sorted position each particle was read from.
+  GLuint gl_sort_rank_slots_buffer_id_;           //< particle holding each previous rank.
+  GLuint gl_sort_offsets_buffer_id_;              //< scanned flags / insertion counts of the coherent sort.
+  GLuint gl_sort_insertions_buffer_id_;           //< insert position of the emitted particles.
+  GLuint gl_sort_state_buffer_id_;                //< TSortState, kept between frames.
+  GLuint gl_emitters_buffer_id_;                  //< TEmitter table.
+  GLuint gl_emitter_offsets_buffer_id_;           //< scanned emit counts of the emitters, then their total.
+  GLuint gl_emitter_accumulators_buffer_id_;      //< fractional particles of each emitter rate.
+  GLuint gl_emitter_bursts_buffer_id_;            //< particles to burst from each emitter, consumed on device.
+  GLuint gl_emission_args_buffer_id_;             //< emission dispatch groups, set on device.
+  GLuint gl_systems_buffer_id_;                   //< TSystem table.
+  GLuint gl_alive_indices_buffer_ids_[2u];        //< free list pool, slots of the alive particles (read, written),
+                                                  //< ring pool, sorted slots and rank of each slot.
+  GLuint gl_free_list_buffer_id_;                 //< free list pool, pushes counter then the free slots stack.
+  GLuint gl_ring_state_buffer_id_;                //< ring pool, TRingState.
+  GLuint gl_fluid_states_buffer_id_;              //< velocity and density of the grid particles, allocated on first use.
+
+  GLuint vaos_[2u];                               //< VAOs for rendering, one per storage buffer.
   GLuint query_time_;                             //< QueryObject for benchmarking.
 
+  unsigned int emit_history_[kEmitHistorySize];   //< particles emitted per frame.
+  unsigned int readback_next_frame_;              //< first frame not accounted by the last readback.
+  unsigned int readback_base_count_;              //< alive particles of the pool before its first readback.
+  PipelineTraffic_t pipeline_traffic_;            //< estimated bytes moved by the last frame.
+
+  struct {
+    GLuint64 total_time[kNumSortEngine];          //< accumulated sorting time, in nanoseconds.
+    double total_error[kNumSortEngine];           //< accumulated ratio of out of order pairs.
+    unsigned int num_samples[kNumSortEngine];
+  } sort_benchmark_[kSortBenchmarkRows];          //< sorting engines timings per particle count.
+
   bool simulated_;                                //< True if particles has been simulated.
+  bool sorted_last_frame_;                        //< True if the storage holds the previous frame sorted order.
+  bool stepped_since_sort_;                       //< True if steps left the storage unsorted since the last sort.
+  bool coherent_order_;                           //< True if the last step followed a sort, for the coherent sort.
+  bool depth_keys_written_;                       //< True if the last step wrote the depth keys.
   bool enable_sorting_;                           //< True if back-to-front sort is enabled.
   bool enable_vectorfield_;                       //< True if the vector field is used.
+  bool enable_sync_readback_;                     //< True to stall on the alive particles count.
+  bool enable_sort_benchmark_;                    //< True to cycle through and measure the sorting engines.
+  bool enable_fused_pipeline_;                    //< True to emit, simulate and write depth keys in one kernel.
 };
 
 /* -------------------------------------------------------------------------- */
@@ -0,0 +1,154 @@
+#include "api/gpu_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+/* -------------------------------------------------------------------------- */
+
+unsigned int const GPUProfiler::kMaxSections;
+unsigned int const GPUProfiler::kFrameLatency;
+unsigned int const GPUProfiler::kHistorySize;
+
+/* -------------------------------------------------------------------------- */
+
+void GPUProfiler::initialize(unsigned int const num_sections, char const* const* names) {
+  if (num_sections > kMaxSections) {
+    fprintf(stderr, "GPUProfiler : %u sections exceed the capacity (%u).\n", num_sections, kMaxSections);
+  }
+  num_sections_ = std::min(num_sections, kMaxSections);
+  names_ = names;
+
+  for (unsigned int slot = 0u; slot < kFrameLatency; ++slot) {
+    glCreateQueries(GL_TIMESTAMP, 2 * num_sections_, &queries_[slot][0u][0u]);
+    std::fill(recorded_[slot], recorded_[slot] + kMaxSections, false);
+  }
+  std::fill(history_count_, history_count_ + kMaxSections, 0u);
+  std::fill(stats_, stats_ + kMaxSections, Statistics_t());
+  frame_ = 0u;
+  num_dropped_ = 0u;
+
+  CHECKGLERROR();
+}
+
+void GPUProfiler::deinitialize() {
+  for (unsigned int slot = 0u; slot < kFrameLatency; ++slot) {
+    glDeleteQueries(2 * num_sections_, &queries_[slot][0u][0u]);
+  }
+  num_sections_ = 0u;
+}
+
+void GPUProfiler::begin_frame() {
+  unsigned int const slot = frame_ % kFrameLatency;
+  _collect(slot);
+  ++frame_;
+}
+
+void GPUProfiler::flush() {
+  glFinish();
+  for (unsigned int i = 0u; i < kFrameLatency; ++i) {
+    _collect((frame_ + i) % kFrameLatency);
+  }
+}
+
+void GPUProfiler::begin(unsigned int const section) {
+  unsigned int const slot = (frame_ + kFrameLatency - 1u) % kFrameLatency;
+  glQueryCounter(queries_[slot][section][0u], GL_TIMESTAMP);
+}
+
+void GPUProfiler::end(unsigned int const section) {
+  unsigned int const slot = (frame_ + kFrameLatency - 1u) % kFrameLatency;
+  glQueryCounter(queries_[slot][section][1u], GL_TIMESTAMP);
+  recorded_[slot][section] = true;
+}
+
+bool GPUProfiler::dump_csv(char const* filename) const {
+  FILE *fd = fopen(filename, "w");
+  if (!fd) {
+    fprintf(stderr, "GPUProfiler : can't write \"%s\".\n", filename);
+    return false;
+  }
+
+  fprintf(fd, "section,min_ms,avg_ms,p99_ms,samples\n");
+  for (unsigned int i = 0u; i < num_sections_; ++i) {
+    Statistics_t const& s = stats_[i];
+    fprintf(fd, "%s,%.6f,%.6f,%.6f,%u\n", names_[i], s.min_ms, s.avg_ms, s.p99_ms, s.num_samples);
+  }
+  fclose(fd);
+
+  return true;
+}
+
+bool GPUProfiler::dump_json(char const* filename) const {
+  FILE *fd = fopen(filename, "w");
+  if (!fd) {
+    fprintf(stderr, "GPUProfiler : can't write \"%s\".\n", filename);
+    return false;
+  }
+
+  fprintf(fd, "{\n  \"dropped_samples\": %u,\n  \"sections\": [\n", num_dropped_);
+  for (unsigned int i = 0u; i < num_sections_; ++i) {
+    Statistics_t const& s = stats_[i];
+    fprintf(fd, "    { \"name\": \"%s\", \"min_ms\": %.6f, \"avg_ms\": %.6f, \"p99_ms\": %.6f, \"samples\": %u }%s\n",
+      names_[i], s.min_ms, s.avg_ms, s.p99_ms, s.num_samples, (i + 1u < num_sections_) ? "," : ""
+    );
+  }
+  fprintf(fd, "  ]\n}\n");
+  fclose(fd);
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void GPUProfiler::_collect(unsigned int const slot) {
+  for (unsigned int i = 0u; i < num_sections_; ++i) {
+    if (!recorded_[slot][i]) {
+      continue;
+    }
+    recorded_[slot][i] = false;
+
+    // Timestamps complete in order, the end one is enough to check.
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(queries_[slot][i][1u], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+      ++num_dropped_;
+      continue;
+    }
+
+    GLuint64 start = 0u;
+    GLuint64 stop = 0u;
+    glGetQueryObjectui64v(queries_[slot][i][0u], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries_[slot][i][1u], GL_QUERY_RESULT, &stop);
+    _add_sample(i, 1.0e-6 * static_cast<double>((stop > start) ? stop - start : 0u));
+  }
+}
+
+void GPUProfiler::_add_sample(unsigned int const section, double const time_ms) {
+  float *history = history_[section];
+  history[history_count_[section] % kHistorySize] = static_cast<float>(time_ms);
+  ++history_count_[section];
+
+  /* Rolling statistics over the window. */
+  unsigned int const count = std::min(history_count_[section], kHistorySize);
+  float sorted[kHistorySize];
+  std::copy(history, history + count, sorted);
+
+  unsigned int const p99_index = (99u * (count - 1u)) / 100u;
+  std::nth_element(sorted, sorted + p99_index, sorted + count);
+
+  double sum = 0.0;
+  float min_value = sorted[0u];
+  for (unsigned int j = 0u; j < count; ++j) {
+    sum += sorted[j];
+    min_value = std::min(min_value, sorted[j]);
+  }
+
+  Statistics_t &s = stats_[section];
+  s.min_ms = min_value;
+  s.avg_ms = sum / count;
+  s.p99_ms = sorted[p99_index];
+  s.last_ms = time_ms;
+  s.num_samples = count;
+}
+
+/* -------------------------------------------------------------------------- */
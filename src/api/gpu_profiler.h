@@ -0,0 +1,94 @@
+#ifndef API_GPU_PROFILER_H_
+#define API_GPU_PROFILER_H_
+
+#include "opengl.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Per section GPU timings, measured without stalling the pipeline.
+ *
+ * Sections are delimited by GL_TIMESTAMP queries, which are kept in a ring of
+ * kFrameLatency frames and only read back once the ring comes back to them.
+ * Results not yet available at that point are dropped instead of waited for.
+ *
+ * Sections may be nested, or skipped on some frames.
+ */
+class GPUProfiler {
+ public:
+  static unsigned int const kMaxSections = 24u;
+  /* Frames of queries in flight. */
+  static unsigned int const kFrameLatency = 4u;
+  /* Samples used for the rolling statistics. */
+  static unsigned int const kHistorySize = 256u;
+
+  struct Statistics_t {
+    double min_ms = 0.0;
+    double avg_ms = 0.0;
+    double p99_ms = 0.0;
+    double last_ms = 0.0;
+    unsigned int num_samples = 0u;    //< samples in the rolling window.
+  };
+
+  GPUProfiler()
+    : num_sections_(0u),
+      names_(nullptr),
+      frame_(0u),
+      num_dropped_(0u)
+  {}
+
+  /// @param names section names, kept by reference.
+  void initialize(unsigned int const num_sections, char const* const* names);
+  void deinitialize();
+
+  /// Collect the results of the frame issued kFrameLatency frames ago, then
+  /// start recording a new frame in its slot.
+  void begin_frame();
+
+  /// Wait for, and collect, every frame still in flight.
+  void flush();
+
+  void begin(unsigned int const section);
+  void end(unsigned int const section);
+
+  /// Write the statistics of every section, return false on failure.
+  bool dump_csv(char const* filename) const;
+  bool dump_json(char const* filename) const;
+
+  inline unsigned int num_sections() const {
+    return num_sections_;
+  }
+
+  inline char const* name(unsigned int const section) const {
+    return names_[section];
+  }
+
+  inline Statistics_t const& statistics(unsigned int const section) const {
+    return stats_[section];
+  }
+
+  /// Samples whose results were not ready when collected.
+  inline unsigned int num_dropped() const {
+    return num_dropped_;
+  }
+
+ private:
+  void _collect(unsigned int const slot);
+  void _add_sample(unsigned int const section, double const time_ms);
+
+  unsigned int num_sections_;
+  char const* const* names_;
+
+  GLuint queries_[kFrameLatency][kMaxSections][2u];   //< begin and end timestamps.
+  bool recorded_[kFrameLatency][kMaxSections];        //< sections issued per slot.
+  unsigned int frame_;                                //< frames begun, selects the slot.
+
+  float history_[kMaxSections][kHistorySize];         //< last samples, in ms.
+  unsigned int history_count_[kMaxSections];          //< samples received per section.
+  Statistics_t stats_[kMaxSections];
+  unsigned int num_dropped_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif  // API_GPU_PROFILER_H_
@@ -0,0 +1,106 @@
+#include "api/prefix_sum.h"
+
+#include <algorithm>
+#include <cstdio>
+#include "shaders/sparkle/interop.h"
+
+/* -------------------------------------------------------------------------- */
+
+namespace {
+
+unsigned int GetBlockCount(unsigned int const count) {
+  return (count + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+}
+
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+
+void PrefixSum::initialize(unsigned int const max_count) {
+  char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
+  pgm_.blocks = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_prefix_sum_blocks.glsl", src_buffer);
+  pgm_.totals = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_prefix_sum_totals.glsl", src_buffer);
+  pgm_.add    = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_prefix_sum_add.glsl", src_buffer);
+  delete [] src_buffer;
+
+  ulocation_.blocks.numElements = GetUniformLocation(pgm_.blocks, "uNumElements");
+  ulocation_.totals.numBlocks   = GetUniformLocation(pgm_.totals, "uNumBlocks");
+  ulocation_.add.numElements    = GetUniformLocation(pgm_.add, "uNumElements");
+
+  max_count_ = 0u;
+  gl_block_sums_buffer_id_ = 0u;
+  resize(max_count);
+}
+
+void PrefixSum::deinitialize() {
+  glDeleteProgram(pgm_.blocks);
+  glDeleteProgram(pgm_.totals);
+  glDeleteProgram(pgm_.add);
+  glDeleteBuffers(1u, &gl_block_sums_buffer_id_);
+
+  max_count_ = 0u;
+  gl_block_sums_buffer_id_ = 0u;
+}
+
+void PrefixSum::resize(unsigned int const max_count) {
+  unsigned int const num_blocks = GetBlockCount(max_count);
+  if ((gl_block_sums_buffer_id_ == 0u) || (num_blocks != GetBlockCount(max_count_))) {
+    glDeleteBuffers(1u, &gl_block_sums_buffer_id_);
+
+    glGenBuffers(1u, &gl_block_sums_buffer_id_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_block_sums_buffer_id_);
+    GLuint const block_sums_buffer_size = std::max(num_blocks, 1u) * sizeof(GLuint);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, block_sums_buffer_size, nullptr, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+  }
+  max_count_ = max_count;
+
+  CHECKGLERROR();
+}
+
+void PrefixSum::run(GLuint const buffer_id, unsigned int const count) {
+  if (count == 0u) {
+    return;
+  }
+  if (count > max_count_) {
+    fprintf(stderr, "PrefixSum : %u values exceed the capacity (%u).\n", count, max_count_);
+    return;
+  }
+
+  unsigned int const num_blocks = GetBlockCount(count);
+
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREFIX_SUM_DATA, buffer_id, 0, count * sizeof(GLuint));
+  glBindBufferRange(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREFIX_SUM_BLOCKS, gl_block_sums_buffer_id_, 0, num_blocks * sizeof(GLuint));
+
+  glUseProgram(pgm_.blocks);
+  {
+    glUniform1ui(ulocation_.blocks.numElements, count);
+    glDispatchCompute(num_blocks, 1u, 1u);
+  }
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  /* A single block needs no offsets. */
+  if (num_blocks > 1u) {
+    glUseProgram(pgm_.totals);
+    {
+      glUniform1ui(ulocation_.totals.numBlocks, num_blocks);
+      glDispatchCompute(1u, 1u, 1u);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    glUseProgram(pgm_.add);
+    {
+      glUniform1ui(ulocation_.add.numElements, count);
+      glDispatchCompute(num_blocks, 1u, 1u);
+    }
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  }
+  glUseProgram(0u);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREFIX_SUM_DATA, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PREFIX_SUM_BLOCKS, 0u);
+
+  CHECKGLERROR();
+}
+
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,59 @@
+#ifndef API_PREFIX_SUM_H_
+#define API_PREFIX_SUM_H_
+
+#include "opengl.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Exclusive prefix sum of an uint storage buffer, computed in place.
+ *
+ * Blocks of PARTICLES_KERNEL_GROUP_WIDTH values are scanned in parallel,
+ * their totals are scanned by a single group then added back to the blocks.
+ *
+ * @note Callers synchronize their own writes to the buffer before a scan.
+ */
+class PrefixSum {
+ public:
+  PrefixSum()
+    : max_count_(0u),
+      gl_block_sums_buffer_id_(0u)
+  {}
+
+  /// Allocate the intermediate storage for up to max_count values.
+  void initialize(unsigned int const max_count);
+  void deinitialize();
+
+  /// Reallocate the intermediate storage for up to max_count values.
+  void resize(unsigned int const max_count);
+
+  /// Scan the first count values of the buffer.
+  void run(GLuint const buffer_id, unsigned int const count);
+
+  inline unsigned int max_count() const {
+    return max_count_;
+  }
+
+ private:
+  struct {
+    GLuint blocks;
+    GLuint totals;
+    GLuint add;
+  } pgm_;                               //< Scan kernels.
+
+  struct {
+    struct {
+      GLint numElements;
+    } blocks, add;
+    struct {
+      GLint numBlocks;
+    } totals;
+  } ulocation_;
+
+  unsigned int max_count_;
+  GLuint gl_block_sums_buffer_id_;      //< totals of each block.
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif // API_PREFIX_SUM_H_
@@ -0,0 +1,51 @@
+#ifndef API_RANDOM_H_
+#define API_RANDOM_H_
+
+#include <glm/glm.hpp>
+
+/* -------------------------------------------------------------------------- */
+
+/* Host side of the counter-based random numbers (see inc_random.glsl), values
+ * being hashed from a (id, frame, stream, seed) key. */
+
+/* Independent sequences, as RANDOM_STREAM_* in inc_random.glsl. */
+unsigned int const kRandomStreamEmission    = 0u;
+unsigned int const kRandomStreamScattering  = 1u;
+unsigned int const kRandomStreamPerlinSeed  = 2u;
+
+/* 4D PCG hash. */
+inline glm::uvec4 pcg4d(glm::uvec4 v) {
+  v = v * 1664525u + 1013904223u;
+
+  v.x += v.y*v.w;
+  v.y += v.z*v.x;
+  v.z += v.x*v.y;
+  v.w += v.y*v.z;
+
+  v ^= v >> 16u;
+
+  v.x += v.y*v.w;
+  v.y += v.z*v.x;
+  v.z += v.x*v.y;
+  v.w += v.y*v.z;
+
+  return v;
+}
+
+/* Four uniform values in [0, 1) for an element id on the given stream. */
+inline glm::vec4 Random4(unsigned int const id, unsigned int const frame, unsigned int const stream, unsigned int const seed) {
+  glm::uvec4 const h = pcg4d(glm::uvec4(id, frame, stream, seed));
+  /* Keep the 24 high bits to be exactly representable as float. */
+  return glm::vec4(h >> 8u) * (1.0f / 16777216.0f);
+}
+
+/* Perlin noise permutation offset of a run, in [0, 289) as the permutation is
+ * taken modulo 289 (see inc_perlin.glsl). */
+inline int PerlinPermutationSeed(int const random_seed) {
+  glm::uvec4 const h = pcg4d(glm::uvec4(0u, 0u, kRandomStreamPerlinSeed, static_cast<unsigned int>(random_seed)));
+  return static_cast<int>(h.x % 289u);
+}
+
+/* -------------------------------------------------------------------------- */
+
+#endif // API_RANDOM_H_
@@ -0,0 +1,215 @@
+#include "api/spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include "shaders/sparkle/interop.h"
+
+/* -------------------------------------------------------------------------- */
+
+namespace {
+
+unsigned int GetThreadsGroupCount(unsigned int const count) {
+  return (count + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+}
+
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+
+void SpatialGrid::initialize(unsigned int const max_count, char const* defines) {
+  char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
+  pgm_.count   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_grid_count.glsl", src_buffer, defines);
+  pgm_.scatter = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_grid_scatter.glsl", src_buffer, defines);
+  pgm_.sweep   = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_grid_sweep.glsl", src_buffer);
+  delete [] src_buffer;
+
+  ulocation_.count.gridExtent       = GetUniformLocation(pgm_.count, "uGridExtent");
+  ulocation_.count.gridResolution   = GetUniformLocation(pgm_.count, "uGridResolution");
+  ulocation_.scatter.gridExtent     = GetUniformLocation(pgm_.scatter, "uGridExtent");
+  ulocation_.scatter.gridResolution = GetUniformLocation(pgm_.scatter, "uGridResolution");
+  ulocation_.sweep.gridExtent       = GetUniformLocation(pgm_.sweep, "uGridExtent");
+  ulocation_.sweep.gridResolution   = GetUniformLocation(pgm_.sweep, "uGridResolution");
+  ulocation_.sweep.radius           = GetUniformLocation(pgm_.sweep, "uRadius");
+
+  glGenBuffers(1u, &gl_neighbours_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_neighbours_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), nullptr, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+
+  /* The cells are allocated by the first set_domain. */
+  prefix_sum_.initialize(1u);
+  resolution_ = 0u;
+  extent_ = 0.0f;
+
+  max_count_ = 0u;
+  resize(max_count);
+}
+
+void SpatialGrid::deinitialize() {
+  glDeleteProgram(pgm_.count);
+  glDeleteProgram(pgm_.scatter);
+  glDeleteProgram(pgm_.sweep);
+
+  glDeleteBuffers(1u, &gl_cell_offsets_buffer_id_);
+  glDeleteBuffers(1u, &gl_particle_keys_buffer_id_);
+  glDeleteBuffers(1u, &gl_particles_buffer_id_);
+  glDeleteBuffers(1u, &gl_neighbours_buffer_id_);
+  gl_cell_offsets_buffer_id_ = 0u;
+  gl_particle_keys_buffer_id_ = 0u;
+  gl_particles_buffer_id_ = 0u;
+  gl_neighbours_buffer_id_ = 0u;
+
+  prefix_sum_.deinitialize();
+
+  max_count_ = 0u;
+  resolution_ = 0u;
+}
+
+void SpatialGrid::resize(unsigned int const max_count) {
+  if ((gl_particles_buffer_id_ != 0u) && (max_count == max_count_)) {
+    return;
+  }
+  glDeleteBuffers(1u, &gl_particle_keys_buffer_id_);
+  glDeleteBuffers(1u, &gl_particles_buffer_id_);
+
+  GLuint const count = std::max(max_count, 1u);
+
+  glGenBuffers(1u, &gl_particle_keys_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_particle_keys_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, count * 2u * sizeof(GLuint), nullptr, 0);
+
+  glGenBuffers(1u, &gl_particles_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_particles_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, count * 4u * sizeof(GLuint), nullptr, 0);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+  max_count_ = max_count;
+
+  CHECKGLERROR();
+}
+
+void SpatialGrid::set_domain(float const extent, float const cell_size) {
+  /* Cells are kept at least as large as asked, for the 27 cells sweep to
+   * find every neighbour closer than cell_size. */
+  float const num_cells_per_axis = std::floor(2.0f * extent / std::max(cell_size, 1e-3f));
+  unsigned int const resolution = static_cast<unsigned int>(
+    std::min(std::max(num_cells_per_axis, 1.0f), static_cast<float>(SPATIAL_GRID_MAX_RESOLUTION))
+  );
+  extent_ = extent;
+
+  if (resolution == resolution_) {
+    return;
+  }
+  resolution_ = resolution;
+
+  // One more offset for the total, the cells end being the next cell start.
+  GLuint const num_offsets = num_cells() + 1u;
+  glDeleteBuffers(1u, &gl_cell_offsets_buffer_id_);
+  glGenBuffers(1u, &gl_cell_offsets_buffer_id_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, gl_cell_offsets_buffer_id_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, num_offsets * sizeof(GLuint), nullptr, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+
+  prefix_sum_.resize(num_offsets);
+
+  CHECKGLERROR();
+}
+
+void SpatialGrid::build(unsigned int const max_count) {
+  if (resolution_ == 0u) {
+    fprintf(stderr, "SpatialGrid : the domain is not set.\n");
+    return;
+  }
+  if (max_count > max_count_) {
+    fprintf(stderr, "SpatialGrid : %u particles exceed the capacity (%u).\n", max_count, max_count_);
+    return;
+  }
+
+  unsigned int const num_groups = GetThreadsGroupCount(max_count);
+  unsigned int const num_offsets = num_cells() + 1u;
+
+  /* 1) Count the particles of each cell. */
+  GLuint const zero = 0u;
+  glClearNamedBufferSubData(
+    gl_cell_offsets_buffer_id_, GL_R32UI, 0u, num_offsets * sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+  );
+
+  bind();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_PARTICLE_KEYS, gl_particle_keys_buffer_id_);
+
+  glUseProgram(pgm_.count);
+  {
+    glUniform1f(ulocation_.count.gridExtent, extent_);
+    glUniform1ui(ulocation_.count.gridResolution, resolution_);
+    glDispatchCompute(num_groups, 1u, 1u);
+  }
+  glUseProgram(0u);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  /* 2) Scan the counts to the cells offsets, the last one being the total. */
+  prefix_sum_.run(gl_cell_offsets_buffer_id_, num_offsets);
+
+  /* 3) Scatter the particles to their cell. */
+  glUseProgram(pgm_.scatter);
+  {
+    glUniform1f(ulocation_.scatter.gridExtent, extent_);
+    glUniform1ui(ulocation_.scatter.gridResolution, resolution_);
+    glDispatchCompute(num_groups, 1u, 1u);
+  }
+  glUseProgram(0u);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_PARTICLE_KEYS, 0u);
+  unbind();
+
+  CHECKGLERROR();
+}
+
+void SpatialGrid::bind() {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_CELL_OFFSETS, gl_cell_offsets_buffer_id_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_PARTICLES, gl_particles_buffer_id_);
+}
+
+void SpatialGrid::unbind() {
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_CELL_OFFSETS, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_PARTICLES, 0u);
+}
+
+void SpatialGrid::sweep(float const radius, unsigned int const max_count) {
+  if (resolution_ == 0u) {
+    return;
+  }
+
+  GLuint const zero = 0u;
+  glClearNamedBufferSubData(
+    gl_neighbours_buffer_id_, GL_R32UI, 0u, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero
+  );
+
+  bind();
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_NEIGHBOURS, gl_neighbours_buffer_id_);
+
+  glUseProgram(pgm_.sweep);
+  {
+    glUniform1f(ulocation_.sweep.gridExtent, extent_);
+    glUniform1ui(ulocation_.sweep.gridResolution, resolution_);
+    glUniform1f(ulocation_.sweep.radius, std::min(radius, cell_size()));
+    glDispatchCompute(GetThreadsGroupCount(std::min(max_count, max_count_)), 1u, 1u);
+  }
+  glUseProgram(0u);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_GRID_NEIGHBOURS, 0u);
+  unbind();
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+  CHECKGLERROR();
+}
+
+unsigned int SpatialGrid::get_num_neighbours_from_device() {
+  GLuint num_neighbours = 0u;
+  glGetNamedBufferSubData(gl_neighbours_buffer_id_, 0, sizeof num_neighbours, &num_neighbours);
+  return num_neighbours;
+}
+
+/* -------------------------------------------------------------------------- */
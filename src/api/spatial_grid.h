@@ -0,0 +1,121 @@
+#ifndef API_SPATIAL_GRID_H_
+#define API_SPATIAL_GRID_H_
+
+#include "opengl.h"
+#include "api/prefix_sum.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Uniform grid of the particles, rebuilt each frame by counting sort.
+ *
+ * Particles are counted per cell, the counts are scanned to the cells offsets,
+ * then the particles positions are scattered in cell order. The build is
+ * linear in the particles and the cells counts.
+ *
+ * Kernels find the neighbours of a particle with inc_grid, once the grid is
+ * bound and their uGridExtent / uGridResolution uniforms set from extent()
+ * and resolution().
+ *
+ * @note Callers bind the particles storage A, the pool lists and the atomic
+ * counters before a build, as for the simulation.
+ */
+class SpatialGrid {
+ public:
+  SpatialGrid()
+    : max_count_(0u),
+      resolution_(0u),
+      extent_(0.0f),
+      gl_cell_offsets_buffer_id_(0u),
+      gl_particle_keys_buffer_id_(0u),
+      gl_particles_buffer_id_(0u),
+      gl_neighbours_buffer_id_(0u)
+  {}
+
+  /// Build the kernels with the particles layout and pool defines, and
+  /// allocate the grid for up to max_count particles.
+  void initialize(unsigned int const max_count, char const* defines = nullptr);
+  void deinitialize();
+
+  /// Reallocate the particles storage for up to max_count particles.
+  void resize(unsigned int const max_count);
+
+  /// Cover the cube of half size extent, centered on the origin, with cells
+  /// of at least cell_size, up to SPATIAL_GRID_MAX_RESOLUTION per axis.
+  void set_domain(float const extent, float const cell_size);
+
+  /// Sort by cell the particles read by the simulation, up to the first
+  /// counter, max_count being its upper bound.
+  void build(unsigned int const max_count);
+
+  /// Bind the grid for the kernels using inc_grid.
+  void bind();
+  void unbind();
+
+  /// Count the neighbours closer than radius, capped by the cell size, of the
+  /// max_count first grid particles, with the 27 cells sweep of the kernels.
+  /// Used to benchmark the neighbour queries, the total is read by
+  /// get_num_neighbours_from_device.
+  void sweep(float const radius, unsigned int const max_count);
+
+  /// Read the last sweep total, stalling until the device is done.
+  unsigned int get_num_neighbours_from_device();
+
+  inline unsigned int max_count() const {
+    return max_count_;
+  }
+
+  inline unsigned int resolution() const {
+    return resolution_;
+  }
+
+  inline unsigned int num_cells() const {
+    return resolution_ * resolution_ * resolution_;
+  }
+
+  inline float extent() const {
+    return extent_;
+  }
+
+  inline float cell_size() const {
+    return 2.0f * extent_ / resolution_;
+  }
+
+  /// Position bits and read index of the particles (uvec4), in cell order.
+  inline GLuint particles_buffer_id() const {
+    return gl_particles_buffer_id_;
+  }
+
+ private:
+  struct {
+    GLuint count;
+    GLuint scatter;
+    GLuint sweep;
+  } pgm_;                               //< Build and sweep kernels.
+
+  struct {
+    struct {
+      GLint gridExtent;
+      GLint gridResolution;
+    } count, scatter;
+    struct {
+      GLint gridExtent;
+      GLint gridResolution;
+      GLint radius;
+    } sweep;
+  } ulocation_;
+
+  unsigned int max_count_;
+  unsigned int resolution_;             //< cells per axis.
+  float extent_;                        //< half size of the grid.
+  PrefixSum prefix_sum_;                //< Scan of the cells counts.
+
+  GLuint gl_cell_offsets_buffer_id_;    //< particles count then first particle of each cell, and the total.
+  GLuint gl_particle_keys_buffer_id_;   //< cell and rank in the cell of each read particle.
+  GLuint gl_particles_buffer_id_;       //< position bits and read index of the particles, in cell order.
+  GLuint gl_neighbours_buffer_id_;      //< sweep total.
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif // API_SPATIAL_GRID_H_
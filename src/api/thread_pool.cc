@@ -0,0 +1,111 @@
+#include "api/thread_pool.h"
+
+#include <algorithm>
+#include "api/cpu_trace.h"
+
+/* -------------------------------------------------------------------------- */
+
+void ThreadPool::initialize(unsigned int const num_threads) {
+  unsigned int const hw_threads = std::max(1u, std::thread::hardware_concurrency());
+  num_threads_ = (num_threads > 0u) ? num_threads : hw_threads;
+
+  shutdown_ = false;
+  workers_.reserve(num_threads_ - 1u);
+  for (unsigned int i = 1u; i < num_threads_; ++i) {
+    workers_.emplace_back(&ThreadPool::_worker, this, i);
+  }
+}
+
+void ThreadPool::deinitialize() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  cv_start_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  num_threads_ = 1u;
+}
+
+void ThreadPool::parallel_for(unsigned int const count, TaskFunc_t const& task) {
+  if (count == 0u) {
+    return;
+  }
+
+  /* Small dispatches are not worth the synchronization. */
+  if (workers_.empty() || (count <= kChunkAlignment)) {
+    for (unsigned int i = 0u; i < num_threads_; ++i) {
+      unsigned int first, last;
+      chunk_range(count, i, first, last);
+      task(first, last, i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_count_ = count;
+    task_ = &task;
+    num_pending_ = static_cast<unsigned int>(workers_.size());
+    ++generation_;
+  }
+  cv_start_.notify_all();
+
+  /* The calling thread handles the first chunk. */
+  _run_chunk(0u);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_done_.wait(lock, [this] { return num_pending_ == 0u; });
+  task_ = nullptr;
+}
+
+void ThreadPool::chunk_range(unsigned int const count, unsigned int const chunk_id,
+                             unsigned int &first, unsigned int &last) const {
+  unsigned int const num_blocks = (count + kChunkAlignment - 1u) / kChunkAlignment;
+  unsigned int const blocks_per_chunk = (num_blocks + num_threads_ - 1u) / num_threads_;
+  unsigned int const chunk_size = blocks_per_chunk * kChunkAlignment;
+
+  first = std::min(count, chunk_id * chunk_size);
+  last  = std::min(count, first + chunk_size);
+}
+
+// ----------------------------------------------------------------------------
+
+void ThreadPool::_worker(unsigned int const chunk_id) {
+  unsigned int last_generation = 0u;
+
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_start_.wait(lock, [&] { return shutdown_ || (generation_ != last_generation); });
+      if (shutdown_) {
+        return;
+      }
+      last_generation = generation_;
+    }
+
+    _run_chunk(chunk_id);
+
+    bool notify = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      notify = (--num_pending_ == 0u);
+    }
+    if (notify) {
+      cv_done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::_run_chunk(unsigned int const chunk_id) {
+  CPU_TRACE_SCOPE("ThreadPool::_run_chunk");
+
+  unsigned int first, last;
+  chunk_range(task_count_, chunk_id, first, last);
+  (*task_)(first, last, chunk_id);
+}
+
+/* -------------------------------------------------------------------------- */
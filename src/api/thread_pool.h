@@ -0,0 +1,71 @@
+#ifndef API_THREAD_POOL_H_
+#define API_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * @brief Fixed pool of worker threads splitting a range of elements into
+ * contiguous chunks processed in parallel.
+ *
+ * @note The calling thread always processes the first chunk, so a pool
+ * initialized with N threads spawns N-1 workers.
+ */
+class ThreadPool {
+ public:
+  /* Chunk boundaries are multiple of this value (to keep SIMD lanes full). */
+  static unsigned int const kChunkAlignment = 16u;
+
+  /* Process elements in [first, last), chunk_id is in [0, num_threads()). */
+  using TaskFunc_t = std::function<void(unsigned int first, unsigned int last, unsigned int chunk_id)>;
+
+  ThreadPool() :
+    num_threads_(1u),
+    generation_(0u),
+    num_pending_(0u),
+    task_count_(0u),
+    task_(nullptr),
+    shutdown_(false)
+  {}
+
+  /// Spawn the workers, when num_threads is 0 the hardware concurrency is used.
+  void initialize(unsigned int const num_threads = 0u);
+  void deinitialize();
+
+  /// Process [0, count) in parallel and return when all chunks are done.
+  void parallel_for(unsigned int const count, TaskFunc_t const& task);
+
+  /// Retrieve the range of elements processed by a chunk for a given count.
+  void chunk_range(unsigned int const count, unsigned int const chunk_id,
+                   unsigned int &first, unsigned int &last) const;
+
+  inline unsigned int num_threads() const {
+    return num_threads_;
+  }
+
+ private:
+  void _worker(unsigned int const chunk_id);
+  void _run_chunk(unsigned int const chunk_id);
+
+  unsigned int num_threads_;                  //< number of chunks per dispatch.
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_start_;
+  std::condition_variable cv_done_;
+  unsigned int generation_;                   //< incremented for each dispatch.
+  unsigned int num_pending_;                  //< workers still running the current task.
+
+  unsigned int task_count_;
+  TaskFunc_t const* task_;
+  bool shutdown_;
+};
+
+/* -------------------------------------------------------------------------- */
+
+#endif  // API_THREAD_POOL_H_
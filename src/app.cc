@@ -7,10 +7,15 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include "glfw.h"
 #include "events.h"
+#include "api/cpu_trace.h"
 
 // ----------------------------------------------------------------------------
 
-bool App::init(char const* title) {
+bool App::init(char const* title,
+               bool use_cpu_simulation,
+               GPUParticle::ParticleLayout const layout,
+               GPUParticle::ParticlePool const pool,
+               unsigned int const max_particle_count) {
   /* System parameters */
   std::setbuf(stderr, nullptr);
   std::srand(static_cast<uint32_t>(std::time(nullptr)));
@@ -64,7 +69,7 @@ bool App::init(char const* title) {
   );
 
   /* Initialize the scene. */
-  scene_.init();
+  scene_.init(use_cpu_simulation, layout, pool, max_particle_count);
   ui_.set_mainview(scene_.view());
 
   /* Start the chrono. */
@@ -83,6 +88,8 @@ void App::deinit() {
 void App::run() {
   /* Mainloop */
   while (!glfwWindowShouldClose(window_)) {
+    CPU_TRACE_SCOPE("App::run");
+
     /* Manage events */
     HandleEvents();
 
@@ -95,12 +102,17 @@ void App::run() {
     /* Render UI */
     ui_.render();
 
-    /* Swap front & back buffers */
-    glfwSwapBuffers(window_);
+    /* Swap front & back buffers, where the driver usually stalls. */
+    {
+      CPU_TRACE_SCOPE("glfwSwapBuffers");
+      glfwSwapBuffers(window_);
+    }
   }
 }
 
 void App::_frame() {
+  CPU_TRACE_SCOPE("App::_frame");
+
   /* Update chrono and calculate deltatim */
   _update_time();
 
@@ -21,7 +21,11 @@ class App {
     deltatime_(0.0f)
   {}
   
-  bool init(char const* title);
+  bool init(char const* title,
+            bool use_cpu_simulation = false,
+            GPUParticle::ParticleLayout const layout = GPUParticle::LAYOUT_AOS,
+            GPUParticle::ParticlePool const pool = GPUParticle::POOL_APPEND_CONSUME,
+            unsigned int const max_particle_count = GPUParticle::kDefaultMaxParticleCount);
   void deinit();
   
   void run();
@@ -0,0 +1,814 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "opengl.h"
+#include "api/cpu_trace.h"
+#include "api/gpu_particle.h"
+#include "api/spatial_grid.h"
+#include "shaders/sparkle/interop.h"
+
+/* -------------------------------------------------------------------------- */
+
+/**
+ * Headless benchmark of the GPUParticle pipeline.
+ *
+ * Runs on a surfaceless EGL context (eg. Mesa llvmpipe) and steps the
+ * simulation with a fixed timestep, then writes its timings as JSON.
+ *
+ * usage : sparkle_bench [--frames N] [--particles N] [--dt seconds]
+ *                       [--layout aos|soa|aosoa32|aosoa64|packed]
+ *                       [--pool appendconsume|freelist|ring]
+ *                       [--sort none|bitonic|radix|coherent]
+ *                       [--emitters N] [--systems N] [--burst N] [--fluid] [--sync]
+ *                       [--output file.json] [--trace file.json]
+ *
+ *         sparkle_bench --grid [--frames N] [--particles N] [--cell size]
+ *                       [--fluid] [--clustered] [--output file.json]
+ *
+ * The grid mode times the spatial grid build and a 27 cells neighbour sweep
+ * over particles spread uniformly in the default simulation volume, or in
+ * gaussian clusters with --clustered. With --fluid it also times the SPH
+ * density and forces passes, whose smoothing radius is the cell size, and
+ * checks their last results against a host reference. Otherwise --fluid
+ * enables the SPH forces of the main system.
+ */
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA     0x31DD
+#endif
+
+namespace {
+
+char const* kSortNames[] = { "bitonic", "radix", "coherent" };
+
+struct BenchParameters_t {
+  unsigned int num_frames = 600u;
+  unsigned int num_particles = GPUParticle::kDefaultMaxParticleCount;
+  unsigned int num_emitters = 1u;               //< including the main one.
+  unsigned int num_systems = 1u;                //< including the main one.
+  unsigned int burst_particles = 0u;            //< pool capacity of the middle third of the frames, when set.
+  float time_step = 1.0f / 60.0f;
+  GPUParticle::ParticleLayout layout = GPUParticle::LAYOUT_AOS;
+  GPUParticle::ParticlePool pool = GPUParticle::POOL_APPEND_CONSUME;
+  bool enable_sorting = true;
+  GPUParticle::SortEngine sort_engine = GPUParticle::SORT_RADIX;
+  bool enable_sync_readback = false;
+  char const* output = nullptr;
+  char const* trace = nullptr;                  //< CPU trace output, when set.
+  bool grid = false;                            //< benchmark the spatial grid instead of the pipeline.
+  float cell_size = 4.0f;                       //< grid cells size, and neighbours distance.
+  bool fluid = false;                           //< SPH forces on the main system, or passes of the grid mode.
+  bool clustered = false;                       //< grid mode particles spread in clusters instead of uniformly.
+};
+
+struct EGLState_t {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  EGLContext context = EGL_NO_CONTEXT;
+};
+
+bool ParseArgs(int argc, char *argv[], BenchParameters_t &params) {
+  for (int i = 1; i < argc; ++i) {
+    char const* arg = argv[i];
+    char const* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+    if (0 == strcmp(arg, "--sync")) {
+      params.enable_sync_readback = true;
+      continue;
+    }
+    if (0 == strcmp(arg, "--grid")) {
+      params.grid = true;
+      continue;
+    }
+    if (0 == strcmp(arg, "--fluid")) {
+      params.fluid = true;
+      continue;
+    }
+    if (0 == strcmp(arg, "--clustered")) {
+      params.clustered = true;
+      continue;
+    }
+    if (nullptr == value) {
+      fprintf(stderr, "Missing or unknown argument \"%s\".\n", arg);
+      return false;
+    }
+    ++i;
+
+    if (0 == strcmp(arg, "--frames")) {
+      params.num_frames = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (0 == strcmp(arg, "--particles")) {
+      params.num_particles = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (0 == strcmp(arg, "--emitters")) {
+      params.num_emitters = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (0 == strcmp(arg, "--burst")) {
+      params.burst_particles = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (0 == strcmp(arg, "--systems")) {
+      params.num_systems = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+    } else if (0 == strcmp(arg, "--dt")) {
+      params.time_step = strtof(value, nullptr);
+    } else if (0 == strcmp(arg, "--cell")) {
+      params.cell_size = strtof(value, nullptr);
+    } else if (0 == strcmp(arg, "--output")) {
+      params.output = value;
+    } else if (0 == strcmp(arg, "--trace")) {
+#if USE_CPU_TRACE
+      params.trace = value;
+#else
+      fprintf(stderr, "CPU trace zones are compiled out, --trace is ignored.\n");
+#endif
+    } else if (0 == strcmp(arg, "--layout")) {
+      int j = 0;
+      while ((j < GPUParticle::kNumParticleLayout)
+          && strcmp(value, GPUParticle::LayoutName(GPUParticle::ParticleLayout(j)))) {
+        ++j;
+      }
+      if (j == GPUParticle::kNumParticleLayout) {
+        fprintf(stderr, "Unknown particles layout \"%s\".\n", value);
+        return false;
+      }
+      params.layout = GPUParticle::ParticleLayout(j);
+    } else if (0 == strcmp(arg, "--pool")) {
+      int j = 0;
+      while ((j < GPUParticle::kNumParticlePool)
+          && strcmp(value, GPUParticle::PoolName(GPUParticle::ParticlePool(j)))) {
+        ++j;
+      }
+      if (j == GPUParticle::kNumParticlePool) {
+        fprintf(stderr, "Unknown particles pool \"%s\".\n", value);
+        return false;
+      }
+      params.pool = GPUParticle::ParticlePool(j);
+    } else if (0 == strcmp(arg, "--sort")) {
+      params.enable_sorting = (0 != strcmp(value, "none"));
+      if (params.enable_sorting) {
+        int j = 0;
+        while ((j < GPUParticle::kNumSortEngine) && strcmp(value, kSortNames[j])) {
+          ++j;
+        }
+        if (j == GPUParticle::kNumSortEngine) {
+          fprintf(stderr, "Unknown sort engine \"%s\".\n", value);
+          return false;
+        }
+        params.sort_engine = GPUParticle::SortEngine(j);
+      }
+    } else {
+      fprintf(stderr, "Unknown argument \"%s\".\n", arg);
+      return false;
+    }
+  }
+
+  if ((0u == params.num_frames) || (params.time_step <= 0.0f)) {
+    fprintf(stderr, "Invalid frame count or timestep.\n");
+    return false;
+  }
+
+  if (params.grid && ((0u == params.num_particles) || (params.cell_size <= 0.0f))) {
+    fprintf(stderr, "Invalid particle count or grid cell size.\n");
+    return false;
+  }
+
+
+  if ((0u == params.num_emitters) || (params.num_emitters > GPUParticle::kMaxEmitterCount)) {
+    fprintf(stderr, "Invalid emitter count, expected 1 to %u.\n", GPUParticle::kMaxEmitterCount);
+    return false;
+  }
+
+  if ((0u == params.num_systems) || (params.num_systems > GPUParticle::kMaxSystemCount)) {
+    fprintf(stderr, "Invalid system count, expected 1 to %u.\n", GPUParticle::kMaxSystemCount);
+    return false;
+  }
+
+  if ((params.num_systems > 1u) && (params.layout == GPUParticle::LAYOUT_PACKED)) {
+    fprintf(stderr, "Packed particles only use the main system.\n");
+    return false;
+  }
+
+  return true;
+}
+
+bool InitEGL(EGLState_t &egl) {
+  /* Prefer the surfaceless platform, which needs neither X11 nor a GPU. */
+  typedef EGLDisplay (*PFNGETPLATFORMDISPLAY)(EGLenum, void*, EGLint const*);
+  PFNGETPLATFORMDISPLAY const eglGetPlatformDisplayEXT =
+    reinterpret_cast<PFNGETPLATFORMDISPLAY>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+
+  if (eglGetPlatformDisplayEXT) {
+    egl.display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (EGL_NO_DISPLAY == egl.display) {
+    egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  EGLint major = 0;
+  EGLint minor = 0;
+  if ((EGL_NO_DISPLAY == egl.display) || !eglInitialize(egl.display, &major, &minor)) {
+    fprintf(stderr, "EGL : no display available.\n");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    fprintf(stderr, "EGL : desktop OpenGL is not supported.\n");
+    return false;
+  }
+
+  EGLint const config_attribs[] = {
+    EGL_SURFACE_TYPE,     EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE,  EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLConfig config;
+  EGLint num_configs = 0;
+  if (!eglChooseConfig(egl.display, config_attribs, &config, 1, &num_configs) || (num_configs < 1)) {
+    fprintf(stderr, "EGL : no suitable config found.\n");
+    return false;
+  }
+
+  /* Same version as the demo window. */
+  EGLint const context_attribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION,        4,
+    EGL_CONTEXT_MINOR_VERSION,        4,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK,  EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  egl.context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, context_attribs);
+  if (EGL_NO_CONTEXT == egl.context) {
+    fprintf(stderr, "EGL : failed to create an OpenGL 4.4 core context.\n");
+    return false;
+  }
+
+  if (!eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl.context)) {
+    fprintf(stderr, "EGL : failed to make the context current.\n");
+    return false;
+  }
+
+  fprintf(stderr, "[ EGL %d.%d, %s ]\n", major, minor, glGetString(GL_RENDERER));
+
+  return true;
+}
+
+void DeinitEGL(EGLState_t &egl) {
+  if (EGL_NO_DISPLAY == egl.display) {
+    return;
+  }
+  eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (EGL_NO_CONTEXT != egl.context) {
+    eglDestroyContext(egl.display, egl.context);
+  }
+  eglTerminate(egl.display);
+}
+
+/* Spread the extra emitters on a circle around the main one, and over the
+ * extra systems, which vary the curl noise strength. */
+void SetupEmitters(GPUParticle &gpu_particle, unsigned int const num_emitters, unsigned int const num_systems) {
+  auto const& sim = gpu_particle.simulation_parameters();
+
+  for (unsigned int i = 1u; i < num_systems; ++i) {
+    GPUParticle::System_t system;
+    system.curlnoise_factor = sim.curlnoise_factor * (0.25f + (1.5f * i) / num_systems);
+    gpu_particle.add_system(system);
+  }
+  unsigned int const first_system = (num_systems > 1u) ? 1u : 0u;
+
+  unsigned int const num_extra = num_emitters - 1u;
+
+  for (unsigned int i = 0u; i < num_extra; ++i) {
+    float const theta = (2.0f * 3.14159265f * i) / num_extra;
+
+    GPUParticle::Emitter_t emitter;
+    emitter.type = GPUParticle::EMITTER_BALL;
+    emitter.position[0] = 0.35f * sim.bounding_volume_size * cosf(theta);
+    emitter.position[2] = 0.35f * sim.bounding_volume_size * sinf(theta);
+    emitter.radius = 2.0f;
+    emitter.rate = 1000.0f;
+    emitter.min_age = sim.min_age;
+    emitter.max_age = sim.max_age;
+    emitter.system = first_system + i % (num_systems - first_system);
+    gpu_particle.add_emitter(emitter);
+  }
+}
+
+void WriteReport(FILE *fd,
+                 BenchParameters_t const& params,
+                 GPUParticle &gpu_particle,
+                 double const elapsed_seconds,
+                 unsigned int const min_alive,
+                 unsigned int const max_alive,
+                 double const avg_alive,
+                 double const avg_traffic_bytes) {
+  GPUProfiler const& profiler = gpu_particle.profiler();
+
+  fprintf(fd, "{\n");
+  fprintf(fd, "  \"config\": {\n");
+  fprintf(fd, "    \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+  fprintf(fd, "    \"frames\": %u,\n", params.num_frames);
+  fprintf(fd, "    \"particles\": %u,\n", gpu_particle.max_particle_count());
+  fprintf(fd, "    \"emitters\": %u,\n", gpu_particle.num_emitters());
+  fprintf(fd, "    \"systems\": %u,\n", gpu_particle.num_systems());
+  fprintf(fd, "    \"burst_particles\": %u,\n", params.burst_particles);
+  fprintf(fd, "    \"time_step\": %.6f,\n", params.time_step);
+  fprintf(fd, "    \"layout\": \"%s\",\n", GPUParticle::LayoutName(params.layout));
+  fprintf(fd, "    \"pool\": \"%s\",\n", GPUParticle::PoolName(params.pool));
+  fprintf(fd, "    \"sort\": \"%s\",\n", params.enable_sorting ? kSortNames[params.sort_engine] : "none");
+  fprintf(fd, "    \"fluid\": %s,\n", params.fluid ? "true" : "false");
+  fprintf(fd, "    \"sync_readback\": %s\n", params.enable_sync_readback ? "true" : "false");
+  fprintf(fd, "  },\n");
+  fprintf(fd, "  \"elapsed_s\": %.6f,\n", elapsed_seconds);
+  fprintf(fd, "  \"fps\": %.3f,\n", params.num_frames / elapsed_seconds);
+  fprintf(fd, "  \"alive\": { \"min\": %u, \"avg\": %.1f, \"max\": %u, \"last\": %u },\n",
+    min_alive, avg_alive, max_alive, gpu_particle.num_alive_particles()
+  );
+  // Estimated by GPUParticle, the pool memory is the last frame one.
+  double const kBytesToMB = 1.0 / (1024.0 * 1024.0);
+  fprintf(fd, "  \"memory\": { \"pool_mb\": %.3f, \"traffic_mb_per_frame\": %.3f },\n",
+    gpu_particle.pipeline_traffic().pool_bytes * kBytesToMB, avg_traffic_bytes * kBytesToMB
+  );
+  fprintf(fd, "  \"dropped_samples\": %u,\n", profiler.num_dropped());
+  fprintf(fd, "  \"sections\": [\n");
+  for (unsigned int i = 0u; i < profiler.num_sections(); ++i) {
+    GPUProfiler::Statistics_t const& s = profiler.statistics(i);
+    fprintf(fd, "    { \"name\": \"%s\", \"min_ms\": %.6f, \"avg_ms\": %.6f, \"p99_ms\": %.6f, \"samples\": %u }%s\n",
+      profiler.name(i), s.min_ms, s.avg_ms, s.p99_ms, s.num_samples, (i + 1u < profiler.num_sections()) ? "," : ""
+    );
+  }
+  fprintf(fd, "  ]\n}\n");
+}
+
+/* Host mirror of inc_fluid, on the bench particles. */
+struct FluidReference_t {
+  float radius;
+  float rest_density;
+  float stiffness;
+  float viscosity;
+
+  float kernel(float const r2) const {
+    float const x = radius * radius - r2;
+    return 315.0f / (64.0f * kPi * powf(radius, 9.0f)) * x * x * x;
+  }
+
+  glm::vec3 kernel_gradient(glm::vec3 const& d, float const r) const {
+    float const x = radius - r;
+    return -45.0f / (kPi * powf(radius, 6.0f)) * x * x * (d / r);
+  }
+
+  float kernel_laplacian(float const r) const {
+    return 45.0f / (kPi * powf(radius, 6.0f)) * (radius - r);
+  }
+
+  float pressure(float const density) const {
+    return stiffness * std::max(density - rest_density, 0.0f);
+  }
+
+  static constexpr float kPi = 3.141593f;  //< as inc_math.
+};
+
+constexpr float FluidReference_t::kPi;
+
+struct FluidErrors_t {
+  unsigned int num_checked = 0u;
+  double max_density = 0.0;       //< relative to each density.
+  double max_acceleration = 0.0;  //< relative to the largest acceleration checked.
+};
+
+/* Compare the fluid states and accelerations of the device, in grid order, to
+ * the host reference over a sample of the particles. */
+FluidErrors_t CheckFluid(FluidReference_t const& fluid,
+                         SpatialGrid const& grid,
+                         std::vector<glm::vec4> const& positions,
+                         std::vector<glm::vec4> const& velocities,
+                         GLuint const fluid_states_buffer_id,
+                         GLuint const fluid_accelerations_buffer_id) {
+  unsigned int const num_particles = static_cast<unsigned int>(positions.size());
+  size_t const bytesize = num_particles * sizeof(glm::vec4);
+
+  std::vector<glm::uvec4> grid_particles(num_particles);
+  std::vector<glm::vec4> states(num_particles);
+  std::vector<glm::vec4> accelerations(num_particles);
+  glGetNamedBufferSubData(grid.particles_buffer_id(), 0, bytesize, grid_particles.data());
+  glGetNamedBufferSubData(fluid_states_buffer_id, 0, bytesize, states.data());
+  glGetNamedBufferSubData(fluid_accelerations_buffer_id, 0, bytesize, accelerations.data());
+
+  // Grid position of each particle.
+  std::vector<unsigned int> grid_indices(num_particles);
+  for (unsigned int i = 0u; i < num_particles; ++i) {
+    grid_indices[grid_particles[i].w] = i;
+  }
+
+  /* Host grid, with the device cells. */
+  int const resolution = static_cast<int>(grid.resolution());
+  float const cells_per_unit = resolution / (2.0f * grid.extent());
+  auto const cell_coords = [&](glm::vec4 const& p) {
+    glm::ivec3 const coords(glm::floor((glm::vec3(p) + grid.extent()) * cells_per_unit));
+    return glm::clamp(coords, glm::ivec3(0), glm::ivec3(resolution - 1));
+  };
+  auto const cell_index = [resolution](glm::ivec3 const& c) {
+    return static_cast<unsigned int>(c.x + resolution * (c.y + resolution * c.z));
+  };
+
+  std::vector<unsigned int> offsets(grid.num_cells() + 1u, 0u);
+  for (auto const& p : positions) {
+    ++offsets[cell_index(cell_coords(p)) + 1u];
+  }
+  for (size_t i = 1u; i < offsets.size(); ++i) {
+    offsets[i] += offsets[i - 1u];
+  }
+  std::vector<unsigned int> sorted(num_particles);
+  {
+    std::vector<unsigned int> heads(offsets.cbegin(), offsets.cend() - 1);
+    for (unsigned int i = 0u; i < num_particles; ++i) {
+      sorted[heads[cell_index(cell_coords(positions[i]))]++] = i;
+    }
+  }
+
+  // Call f(j, d, r2) for each other particle j closer than the radius.
+  float const h2 = fluid.radius * fluid.radius;
+  auto const for_each_neighbour = [&](unsigned int const i, auto const& f) {
+    glm::vec3 const position(positions[i]);
+    glm::ivec3 const cell = cell_coords(positions[i]);
+    glm::ivec3 const lo = glm::max(cell - 1, glm::ivec3(0));
+    glm::ivec3 const hi = glm::min(cell + 1, glm::ivec3(resolution - 1));
+    for (int z = lo.z; z <= hi.z; ++z) {
+      for (int y = lo.y; y <= hi.y; ++y) {
+        for (int x = lo.x; x <= hi.x; ++x) {
+          unsigned int const c = cell_index(glm::ivec3(x, y, z));
+          for (unsigned int k = offsets[c]; k < offsets[c + 1u]; ++k) {
+            unsigned int const j = sorted[k];
+            glm::vec3 const d = position - glm::vec3(positions[j]);
+            float const r2 = glm::dot(d, d);
+            if ((r2 < h2) && (j != i)) {
+              f(j, d, r2);
+            }
+          }
+        }
+      }
+    }
+  };
+
+  /* Every density is needed by the accelerations. */
+  std::vector<float> densities(num_particles);
+  for (unsigned int i = 0u; i < num_particles; ++i) {
+    float density = fluid.kernel(0.0f);
+    for_each_neighbour(i, [&](unsigned int, glm::vec3 const&, float const r2) {
+      density += fluid.kernel(r2);
+    });
+    densities[i] = density;
+  }
+
+  /* Accelerations of a strided sample, as the unfactorised SPH sums. */
+  unsigned int const kMaxChecked = 65536u;
+  unsigned int const stride = (num_particles + kMaxChecked - 1u) / kMaxChecked;
+
+  FluidErrors_t errors;
+  double max_error = 0.0;
+  double max_norm = 0.0;
+  for (unsigned int i = 0u; i < num_particles; i += stride) {
+    glm::vec3 const velocity(velocities[i]);
+    float const pressure = fluid.pressure(densities[i]);
+    glm::vec3 pressure_force(0.0f);
+    glm::vec3 viscosity_force(0.0f);
+    for_each_neighbour(i, [&](unsigned int const j, glm::vec3 const& d, float const r2) {
+      if (r2 > 0.0f) {
+        float const r = sqrtf(r2);
+        float const pressure_j = fluid.pressure(densities[j]);
+        pressure_force -= (pressure + pressure_j) / (2.0f * densities[j]) * fluid.kernel_gradient(d, r);
+        viscosity_force += fluid.kernel_laplacian(r) / densities[j] * (glm::vec3(velocities[j]) - velocity);
+      }
+    });
+    glm::vec3 const acceleration = (pressure_force + fluid.viscosity * viscosity_force) / densities[i];
+
+    unsigned int const tid = grid_indices[i];
+    double const density_error = fabs(states[tid].w - densities[i]) / densities[i];
+    errors.max_density = std::max(errors.max_density, density_error);
+    max_error = std::max(max_error, static_cast<double>(glm::length(glm::vec3(accelerations[tid]) - acceleration)));
+    max_norm = std::max(max_norm, static_cast<double>(glm::length(acceleration)));
+    ++errors.num_checked;
+  }
+  errors.max_acceleration = (max_norm > 0.0) ? max_error / max_norm : max_error;
+
+  return errors;
+}
+
+/* Time the grid build and its neighbour sweep, each frame, over the same
+ * particles spread uniformly or in clusters in the default simulation volume,
+ * then the fluid passes when asked. */
+void RunGridBenchmark(BenchParameters_t const& params, FILE *fd) {
+  enum GridSection {
+    SECTION_GRID_BUILD,
+    SECTION_GRID_SWEEP,
+    SECTION_FLUID_DENSITY,
+    SECTION_FLUID_FORCES,
+    kNumGridSection
+  };
+  char const* const kGridSectionNames[kNumGridSection] = {
+    "grid_build", "grid_sweep", "fluid_density", "fluid_forces"
+  };
+
+  unsigned int const num_particles = params.num_particles;
+  float const extent = 0.5f * GPUParticle::kDefaultSimulationVolumeSize;
+
+  /* The grid kernels only read the positions stream of the SoA layout, the
+   * fluid ones its velocities too. */
+  std::mt19937 rng(0u);
+  std::uniform_real_distribution<float> distrib(-extent, extent);
+  std::uniform_real_distribution<float> velocity_distrib(-1.0f, 1.0f);
+  std::vector<glm::vec4> positions(num_particles);
+  std::vector<glm::vec4> velocities(num_particles);
+  if (params.clustered) {
+    /* Clusters a few cells wide, dense cells sitting next to empty ones. */
+    unsigned int const kNumClusters = 16u;
+    std::uniform_real_distribution<float> center_distrib(-0.75f * extent, 0.75f * extent);
+    std::normal_distribution<float> offset_distrib(0.0f, 2.0f * params.cell_size);
+    glm::vec3 centers[kNumClusters];
+    for (auto &center : centers) {
+      center = glm::vec3(center_distrib(rng), center_distrib(rng), center_distrib(rng));
+    }
+    for (unsigned int i = 0u; i < num_particles; ++i) {
+      glm::vec3 const offset(offset_distrib(rng), offset_distrib(rng), offset_distrib(rng));
+      glm::vec3 const position = glm::clamp(centers[i % kNumClusters] + offset, glm::vec3(-extent), glm::vec3(extent));
+      positions[i] = glm::vec4(position, 1.0f);
+    }
+  } else {
+    for (auto &position : positions) {
+      position = glm::vec4(distrib(rng), distrib(rng), distrib(rng), 1.0f);
+    }
+  }
+  for (auto &velocity : velocities) {
+    velocity = glm::vec4(velocity_distrib(rng), velocity_distrib(rng), velocity_distrib(rng), 0.0f);
+  }
+
+  size_t const bytesize = num_particles * sizeof(glm::vec4);
+  GLuint particles_buffer_ids[3u];
+  glGenBuffers(3u, particles_buffer_ids);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, particles_buffer_ids[0u]);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytesize, positions.data(), 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, particles_buffer_ids[1u]);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytesize, velocities.data(), 0);
+  // Attributes are unused, but bound as the particles loads declare them.
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, particles_buffer_ids[2u]);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytesize, nullptr, 0);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+
+  // The particles count is read from the first counter, as in the simulation.
+  GLuint counter_buffer_id = 0u;
+  glGenBuffers(1u, &counter_buffer_id);
+  glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counter_buffer_id);
+  glBufferStorage(GL_ATOMIC_COUNTER_BUFFER, sizeof num_particles, &num_particles, 0);
+  glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0u);
+
+  char const* const kDefines = "#define SPARKLE_USE_SOA_LAYOUT 1\n";
+
+  SpatialGrid grid;
+  grid.initialize(num_particles, kDefines);
+  grid.set_domain(extent, params.cell_size);
+
+  /* SPH passes with the demo parameters, but for the radius and the rest
+   * density. Uniform particles are too sparse for any rest density, it is
+   * null for the pressure to act on them. Clustered ones are given their
+   * average density, exceeded in the clusters only, so that the pressure is
+   * clamped to zero for some particles and not for others. */
+  GPUParticle::SimulationParameters_t const sim;
+  float const rest_density = params.clustered ? num_particles / (8.0f * extent * extent * extent) : 0.0f;
+  FluidReference_t const fluid{ params.cell_size, rest_density, sim.fluid_stiffness, sim.fluid_viscosity };
+
+  struct {
+    GLuint density = 0u;
+    GLuint forces = 0u;
+  } pgm;
+  GLuint fluid_buffer_ids[2u] = { 0u, 0u };
+  if (params.fluid) {
+    char *src_buffer = new char[MAX_SHADER_BUFFERSIZE]();
+    pgm.density = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_fluid_density.glsl", src_buffer, kDefines);
+    pgm.forces  = CreateComputeProgram(SHADERS_DIR "/sparkle/cs_fluid_forces.glsl", src_buffer);
+    delete [] src_buffer;
+
+    for (auto const program : { pgm.density, pgm.forces }) {
+      glProgramUniform1f(program, GetUniformLocation(program, "uGridExtent"), grid.extent());
+      glProgramUniform1ui(program, GetUniformLocation(program, "uGridResolution"), grid.resolution());
+      glProgramUniform1f(program, GetUniformLocation(program, "uFluidRadius"), fluid.radius);
+    }
+    glProgramUniform1f(pgm.forces, GetUniformLocation(pgm.forces, "uFluidRestDensity"), fluid.rest_density);
+    glProgramUniform1f(pgm.forces, GetUniformLocation(pgm.forces, "uFluidStiffness"), fluid.stiffness);
+    glProgramUniform1f(pgm.forces, GetUniformLocation(pgm.forces, "uFluidViscosity"), fluid.viscosity);
+
+    glGenBuffers(2u, fluid_buffer_ids);
+    for (auto const buffer_id : fluid_buffer_ids) {
+      glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer_id);
+      glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytesize, nullptr, 0);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0u);
+  }
+  GLuint const num_groups = (num_particles + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+
+  GPUProfiler profiler;
+  profiler.initialize(params.fluid ? kNumGridSection : SECTION_FLUID_DENSITY, kGridSectionNames);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_A, particles_buffer_ids[0u]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_VELOCITIES_A, particles_buffer_ids[1u]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_ATTRIBUTES_A, particles_buffer_ids[2u]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, fluid_buffer_ids[0u]);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_ACCELERATIONS, fluid_buffer_ids[1u]);
+  glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, ATOMIC_COUNTER_BINDING_FIRST, counter_buffer_id);
+
+  auto const start = std::chrono::steady_clock::now();
+  for (unsigned int frame = 0u; frame < params.num_frames; ++frame) {
+    profiler.begin_frame();
+
+    profiler.begin(SECTION_GRID_BUILD);
+    grid.build(num_particles);
+    profiler.end(SECTION_GRID_BUILD);
+
+    profiler.begin(SECTION_GRID_SWEEP);
+    grid.sweep(params.cell_size, num_particles);
+    profiler.end(SECTION_GRID_SWEEP);
+
+    if (params.fluid) {
+      grid.bind();
+
+      glUseProgram(pgm.density);
+      profiler.begin(SECTION_FLUID_DENSITY);
+      glDispatchCompute(num_groups, 1u, 1u);
+      profiler.end(SECTION_FLUID_DENSITY);
+      glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+      glUseProgram(pgm.forces);
+      profiler.begin(SECTION_FLUID_FORCES);
+      glDispatchCompute(num_groups, 1u, 1u);
+      profiler.end(SECTION_FLUID_FORCES);
+      glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+      glUseProgram(0u);
+      grid.unbind();
+    }
+  }
+  profiler.flush();
+  auto const stop = std::chrono::steady_clock::now();
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_POSITIONS_A, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_VELOCITIES_A, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_PARTICLE_ATTRIBUTES_A, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_STATES, 0u);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, STORAGE_BINDING_FLUID_ACCELERATIONS, 0u);
+  glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, ATOMIC_COUNTER_BINDING_FIRST, 0u);
+
+  double const elapsed_seconds = std::chrono::duration<double>(stop - start).count();
+  double const avg_neighbours = grid.get_num_neighbours_from_device() / static_cast<double>(num_particles);
+
+  fprintf(fd, "{\n");
+  fprintf(fd, "  \"config\": {\n");
+  fprintf(fd, "    \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+  fprintf(fd, "    \"mode\": \"%s\",\n", params.fluid ? "fluid" : "grid");
+  fprintf(fd, "    \"distribution\": \"%s\",\n", params.clustered ? "clustered" : "uniform");
+  fprintf(fd, "    \"frames\": %u,\n", params.num_frames);
+  fprintf(fd, "    \"particles\": %u,\n", num_particles);
+  fprintf(fd, "    \"resolution\": %u,\n", grid.resolution());
+  fprintf(fd, "    \"cell_size\": %.6f\n", grid.cell_size());
+  fprintf(fd, "  },\n");
+  fprintf(fd, "  \"elapsed_s\": %.6f,\n", elapsed_seconds);
+  fprintf(fd, "  \"fps\": %.3f,\n", params.num_frames / elapsed_seconds);
+  fprintf(fd, "  \"neighbours_avg\": %.3f,\n", avg_neighbours);
+  if (params.fluid) {
+    FluidErrors_t const errors = CheckFluid(fluid, grid, positions, velocities, fluid_buffer_ids[0u], fluid_buffer_ids[1u]);
+    fprintf(fd, "  \"fluid\": {\n");
+    fprintf(fd, "    \"radius\": %.6f,\n", fluid.radius);
+    fprintf(fd, "    \"rest_density\": %.6f,\n", fluid.rest_density);
+    fprintf(fd, "    \"stiffness\": %.6f,\n", fluid.stiffness);
+    fprintf(fd, "    \"viscosity\": %.6f,\n", fluid.viscosity);
+    fprintf(fd, "    \"checked\": %u,\n", errors.num_checked);
+    fprintf(fd, "    \"max_density_error\": %.3e,\n", errors.max_density);
+    fprintf(fd, "    \"max_acceleration_error\": %.3e\n", errors.max_acceleration);
+    fprintf(fd, "  },\n");
+  }
+  fprintf(fd, "  \"dropped_samples\": %u,\n", profiler.num_dropped());
+  fprintf(fd, "  \"sections\": [\n");
+  for (unsigned int i = 0u; i < profiler.num_sections(); ++i) {
+    GPUProfiler::Statistics_t const& s = profiler.statistics(i);
+    fprintf(fd, "    { \"name\": \"%s\", \"min_ms\": %.6f, \"avg_ms\": %.6f, \"p99_ms\": %.6f, \"samples\": %u }%s\n",
+      profiler.name(i), s.min_ms, s.avg_ms, s.p99_ms, s.num_samples, (i + 1u < profiler.num_sections()) ? "," : ""
+    );
+  }
+  fprintf(fd, "  ]\n}\n");
+
+  profiler.deinitialize();
+  grid.deinitialize();
+  glDeleteProgram(pgm.density);
+  glDeleteProgram(pgm.forces);
+  glDeleteBuffers(2u, fluid_buffer_ids);
+  glDeleteBuffers(3u, particles_buffer_ids);
+  glDeleteBuffers(1u, &counter_buffer_id);
+  CHECKGLERROR();
+}
+
+}  // namespace
+
+/* -------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[]) {
+  BenchParameters_t params;
+  if (!ParseArgs(argc, argv, params)) {
+    return EXIT_FAILURE;
+  }
+
+  EGLState_t egl;
+  if (!InitEGL(egl)) {
+    DeinitEGL(egl);
+    return EXIT_FAILURE;
+  }
+  InitGL();
+
+  if (params.grid) {
+    FILE *fd = params.output ? fopen(params.output, "w") : stdout;
+    if (!fd) {
+      fprintf(stderr, "Can't write \"%s\".\n", params.output);
+    } else {
+      RunGridBenchmark(params, fd);
+      if (fd != stdout) {
+        fclose(fd);
+      }
+    }
+    DeinitEGL(egl);
+    return fd ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  GPUParticle gpu_particle;
+  gpu_particle.init(params.layout, params.num_particles, params.pool);
+  gpu_particle.enable_sorting(params.enable_sorting);
+  gpu_particle.enable_sync_readback(params.enable_sync_readback);
+  gpu_particle.rendering_parameters().sort_engine = params.sort_engine;
+  SetupEmitters(gpu_particle, params.num_emitters, params.num_systems);
+  gpu_particle.simulation_parameters().enable_fluid = params.fluid;
+
+  /* Fixed point of view, as the demo default camera. */
+  glm::mat4x4 const view = glm::lookAt(glm::vec3(0.0f, 0.65f*295.0f, 295.0f),
+                                       glm::vec3(0.0f, 0.0f, 0.0f),
+                                       glm::vec3(0.0f, 1.0f, 0.0f));
+
+  /// @note Rendering is not benchmarked, surfaceless contexts have no
+  /// default framebuffer.
+  unsigned int min_alive = ~0u;
+  unsigned int max_alive = 0u;
+  double sum_alive = 0.0;
+  double sum_traffic = 0.0;
+
+#if USE_CPU_TRACE
+  EnableCPUTrace(nullptr != params.trace);
+#endif
+
+  auto const start = std::chrono::steady_clock::now();
+  for (unsigned int frame = 0u; frame < params.num_frames; ++frame) {
+    /* Grow the pool for a burst, then give the memory back. */
+    if (params.burst_particles > 0u) {
+      if (frame == params.num_frames / 3u) {
+        gpu_particle.resize(params.burst_particles);
+      } else if (frame == (2u * params.num_frames) / 3u) {
+        gpu_particle.resize(params.num_particles);
+      }
+    }
+
+    gpu_particle.begin_frame();
+    gpu_particle.update(params.time_step, view);
+    gpu_particle.end_frame(view);
+
+    unsigned int const alive = gpu_particle.num_alive_particles();
+    min_alive = std::min(min_alive, alive);
+    max_alive = std::max(max_alive, alive);
+    sum_alive += alive;
+    sum_traffic += gpu_particle.pipeline_traffic().split_bytes;
+  }
+  gpu_particle.profiler().flush();
+  auto const stop = std::chrono::steady_clock::now();
+
+#if USE_CPU_TRACE
+  EnableCPUTrace(false);
+  if (params.trace) {
+    DumpCPUTrace(params.trace);
+  }
+#endif
+
+  double const elapsed_seconds = std::chrono::duration<double>(stop - start).count();
+  double const avg_alive = sum_alive / params.num_frames;
+  double const avg_traffic = sum_traffic / params.num_frames;
+
+  FILE *fd = params.output ? fopen(params.output, "w") : stdout;
+  if (!fd) {
+    fprintf(stderr, "Can't write \"%s\".\n", params.output);
+  } else {
+    WriteReport(fd, params, gpu_particle, elapsed_seconds, min_alive, max_alive, avg_alive, avg_traffic);
+    if (fd != stdout) {
+      fclose(fd);
+    }
+  }
+
+  gpu_particle.deinit();
+  CHECKGLERROR();
+  DeinitEGL(egl);
+
+  return fd ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* -------------------------------------------------------------------------- */
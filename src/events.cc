@@ -1,6 +1,7 @@
 #include "events.h"
 #include "imgui.h"
 #include "glfw.h"
+#include "api/cpu_trace.h"
 
 /* -------------------------------------------------------------------------- */
 
@@ -44,6 +45,8 @@ void InitEvents(GLFWwindow* window) {
 
 extern
 void HandleEvents() {
+  CPU_TRACE_SCOPE("HandleEvents");
+
   s_Global.bMouseMove = false;
   s_Global.wheelDelta = 0.0f;
   glfwPollEvents();
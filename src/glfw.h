@@ -1,7 +1,8 @@
 #ifndef DEMO_GLFW_H_
 #define DEMO_GLFW_H_
 
-/* Wrapper around glfw to always load OpenGL extensions before it. */
+/* Wrapper around glfw to always load OpenGL extensions before it.
+ * Headless builds (USE_EGL) create their context with EGL instead. */
 
 // Use GLEW if enabled, otherwise load extensions manually.
 #if USE_GLEW
@@ -10,6 +11,10 @@
 #include "ext/_extensions.h"
 #endif
 
+#if USE_EGL
+#include "EGL/egl.h"
+#else
 #include "GLFW/glfw3.h"
+#endif
 
 #endif  // DEMO_GLFW_H_
\ No newline at end of file
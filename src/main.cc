@@ -1,4 +1,6 @@
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include "app.h"
 
 /* -------------------------------------------------------------------------- */
@@ -7,10 +9,59 @@
 
 /* -------------------------------------------------------------------------- */
 
-int main(int, char *[]) {
+int main(int argc, char *argv[]) {
   App app;
 
-  if (!app.init(WINDOW_TITLE)) {
+  /* Simulate particles on the host with '--cpu', choose the device
+   * particles storage with '--layout <aos|soa|aosoa32|aosoa64|packed>',
+   * its pool with '--pool <appendconsume|freelist|ring>' and the pool
+   * initial capacity with '--particles <count>'. */
+  bool use_cpu_simulation = false;
+  GPUParticle::ParticleLayout layout = GPUParticle::LAYOUT_AOS;
+  GPUParticle::ParticlePool pool = GPUParticle::POOL_APPEND_CONSUME;
+  unsigned int max_particle_count = GPUParticle::kDefaultMaxParticleCount;
+  for (int i = 1; i < argc; ++i) {
+    use_cpu_simulation |= (0 == strcmp(argv[i], "--cpu"));
+
+    if ((0 == strcmp(argv[i], "--layout")) && (i + 1 < argc)) {
+      char const* name = argv[++i];
+      int j = 0;
+      while ((j < GPUParticle::kNumParticleLayout)
+          && strcmp(name, GPUParticle::LayoutName(GPUParticle::ParticleLayout(j)))) {
+        ++j;
+      }
+      if (j == GPUParticle::kNumParticleLayout) {
+        fprintf(stderr, "Unknown particles layout \"%s\".\n", name);
+        return EXIT_FAILURE;
+      }
+      layout = GPUParticle::ParticleLayout(j);
+    }
+
+    if ((0 == strcmp(argv[i], "--pool")) && (i + 1 < argc)) {
+      char const* name = argv[++i];
+      int j = 0;
+      while ((j < GPUParticle::kNumParticlePool)
+          && strcmp(name, GPUParticle::PoolName(GPUParticle::ParticlePool(j)))) {
+        ++j;
+      }
+      if (j == GPUParticle::kNumParticlePool) {
+        fprintf(stderr, "Unknown particles pool \"%s\".\n", name);
+        return EXIT_FAILURE;
+      }
+      pool = GPUParticle::ParticlePool(j);
+    }
+
+    if ((0 == strcmp(argv[i], "--particles")) && (i + 1 < argc)) {
+      char const* value = argv[++i];
+      max_particle_count = static_cast<unsigned int>(strtoul(value, nullptr, 10));
+      if (max_particle_count == 0u) {
+        fprintf(stderr, "Invalid particles count \"%s\".\n", value);
+        return EXIT_FAILURE;
+      }
+    }
+  }
+
+  if (!app.init(WINDOW_TITLE, use_cpu_simulation, layout, pool, max_particle_count)) {
     return EXIT_FAILURE;
   }
 
@@ -11,20 +11,34 @@ static
 int checkExtensions(char const** extensions) {
   unsigned int i = 0u;
   int valid = 1;
+#if USE_EGL
+  /* Core 4.4 contexts, as created by the headless build, provide them all. */
+  (void)i;
+  (void)extensions;
+#else
   for (i = 0u; extensions[i] != nullptr; ++i) {
     if (!glfwExtensionSupported(extensions[i])) {
       fprintf(stderr, "warning : Extension \"%s\" is not supported.\n", extensions[i]);
       valid = 0;
     }
   }
+#endif
   return valid;
 }
 
 #ifndef USE_GLEW
 
+#if USE_EGL
+typedef __eglMustCastToProperFunctionPointerType ProcAddress_t;
+#define GetProcAddress  eglGetProcAddress
+#else
+typedef GLFWglproc ProcAddress_t;
+#define GetProcAddress  glfwGetProcAddress
+#endif
+
 static
-GLFWglproc getAddress(char const* name) {
-  GLFWglproc ptr = glfwGetProcAddress(name);
+ProcAddress_t getAddress(char const* name) {
+  ProcAddress_t ptr = GetProcAddress(name);
   if (nullptr == ptr) {
     fprintf(stderr, "error: Extension function %s not found.\n", name);
   }
@@ -177,6 +191,30 @@ void ReadShaderFile(char const* filename, unsigned int const maxsize, char out[]
   }
 }
 
+/* Insert the defines after the first line of the shader (its #version). */
+static
+void InsertDefines(char const* defines, unsigned int const maxsize, char out[]) {
+  if (!defines || (defines[0] == '\0')) {
+    return;
+  }
+
+  char *first = strchr(out, '\n');
+  if (!first) {
+    return;
+  }
+  ++first;
+
+  size_t const len = strlen(defines);
+  size_t const tail_len = strlen(first) + 1u;
+  if (static_cast<size_t>(first - out) + len + tail_len > maxsize) {
+    fprintf(stderr, "Error : no room left for the shader defines.\n");
+    return;
+  }
+
+  memmove(first + len, first, tail_len);
+  memcpy(first, defines, len);
+}
+
 // ----------------------------------------------------------------------------
 
 extern
@@ -210,7 +248,7 @@ void InitGL() {
 }
 
 extern
-GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* fsfile, char *src_buffer) {
+GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* fsfile, char *src_buffer, char const* defines) {
   GLuint pgm = 0u;
   GLuint vshader = 0u;
   GLuint gshader = 0u;
@@ -222,6 +260,7 @@ GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* f
   /* Vertex Shader */
   vshader = glCreateShader(GL_VERTEX_SHADER);
   ReadShaderFile(vsfile, MAX_SHADER_BUFFERSIZE, src_buffer);
+  InsertDefines(defines, MAX_SHADER_BUFFERSIZE, src_buffer);
   glShaderSource(vshader, 1, (const GLchar**)&src_buffer, nullptr);
   glCompileShader(vshader);
   CheckShaderStatus(vshader, vsfile);
@@ -230,6 +269,7 @@ GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* f
   if (gsfile) {
     gshader = glCreateShader(GL_GEOMETRY_SHADER);
     ReadShaderFile(gsfile, MAX_SHADER_BUFFERSIZE, src_buffer);
+    InsertDefines(defines, MAX_SHADER_BUFFERSIZE, src_buffer);
     glShaderSource(gshader, 1, (const GLchar**)&src_buffer, nullptr);
     glCompileShader(gshader);
     CheckShaderStatus(gshader, gsfile);
@@ -238,6 +278,7 @@ GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* f
   /* Fragment Shader */
   fshader = glCreateShader(GL_FRAGMENT_SHADER);
   ReadShaderFile(fsfile, MAX_SHADER_BUFFERSIZE, src_buffer);
+  InsertDefines(defines, MAX_SHADER_BUFFERSIZE, src_buffer);
   glShaderSource(fshader, 1, (const GLchar**)&src_buffer, nullptr);
   glCompileShader(fshader);
   CheckShaderStatus(fshader, fsfile);
@@ -253,15 +294,16 @@ GLuint CreateRenderProgram(char const* vsfile, char const* gsfile, char const* f
 }
 
 extern
-GLuint CreateRenderProgram(char const* vsfile, char const* fsfile, char *src_buffer) {
-  return CreateRenderProgram(vsfile, nullptr, fsfile, src_buffer);
+GLuint CreateRenderProgram(char const* vsfile, char const* fsfile, char *src_buffer, char const* defines) {
+  return CreateRenderProgram(vsfile, nullptr, fsfile, src_buffer, defines);
 }
 
 extern
-GLuint CreateComputeProgram(char const* program_name, char *src_buffer) {
+GLuint CreateComputeProgram(char const* program_name, char *src_buffer, char const* defines) {
   GLuint pgm = 0u;
 
   ReadShaderFile(program_name, MAX_SHADER_BUFFERSIZE, src_buffer);
+  InsertDefines(defines, MAX_SHADER_BUFFERSIZE, src_buffer);
   pgm = glCreateShaderProgramv(GL_COMPUTE_SHADER, 1, (const GLchar**)&src_buffer);
   if (!CheckProgramStatus(pgm, program_name)) {
     exit(EXIT_FAILURE);
@@ -21,9 +21,10 @@
 // ----------------------------------------------------------------------------
 
 void InitGL();
-GLuint CreateRenderProgram(char const* vsfile, const char *gsfile, char const* fsfile, char *src_buffer);
-GLuint CreateRenderProgram(char const* vsfile, char const* fsfile, char *src_buffer);
-GLuint CreateComputeProgram(char const* program_name, char *src_buffer);
+/* Optional defines are inserted after the shaders #version line. */
+GLuint CreateRenderProgram(char const* vsfile, const char *gsfile, char const* fsfile, char *src_buffer, char const* defines = nullptr);
+GLuint CreateRenderProgram(char const* vsfile, char const* fsfile, char *src_buffer, char const* defines = nullptr);
+GLuint CreateComputeProgram(char const* program_name, char *src_buffer, char const* defines = nullptr);
 void CheckShaderStatus(GLuint shader, char const* name);
 bool CheckProgramStatus(GLuint program, char const* name);
 void CheckGLError(char const* file, int const line, char const* errMsg, bool bExitOnFail);
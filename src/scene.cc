@@ -1,23 +1,41 @@
 #include "scene.h"
 
+#include <algorithm>
 #include <array>
 #include <vector>
 
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
 
+#include "api/cpu_particle.h"
+#include "api/cpu_trace.h"
 #include "api/gpu_particle.h"
 #include "ui/views/views.h"
 
 // ============================================================================
 
-void Scene::init() {
+void Scene::init(bool use_cpu_simulation,
+                 GPUParticle::ParticleLayout const layout,
+                 GPUParticle::ParticlePool const pool,
+                 unsigned int const max_particle_count) {
   /* Init shaders */
   setup_shaders();
 
   /* Init Particles */
-  gpu_particle_ = new GPUParticle();
-  gpu_particle_->init();
+  if (use_cpu_simulation) {
+    cpu_particle_ = new CPUParticle();
+    cpu_particle_->init();
+  } else {
+    gpu_particle_ = new GPUParticle();
+    gpu_particle_->init(layout, max_particle_count, pool);
+    debug_parameters_.gpu_simulation = true;
+    debug_parameters_.profiler = &gpu_particle_->profiler();
+
+    for (unsigned int n = gpu_particle_->max_particle_count(); n > 1u; n >>= 1u) {
+      ++pool_capacity_log2_;
+    }
+    debug_parameters_.pool_capacity_log2 = pool_capacity_log2_;
+  }
 
   /* Init geometry */
   setup_grid_geometry();
@@ -43,8 +61,13 @@ void Scene::deinit() {
   delete views_.rendering;
   delete views_.debug;
 
-  gpu_particle_->deinit();
-  delete gpu_particle_;
+  if (cpu_particle_) {
+    cpu_particle_->deinit();
+    delete cpu_particle_;
+  } else {
+    gpu_particle_->deinit();
+    delete gpu_particle_;
+  }
 
   glDeleteVertexArrays(1u, &geo_.grid.vao);
   glDeleteVertexArrays(1u, &geo_.wirecube.vao);
@@ -56,17 +79,71 @@ void Scene::deinit() {
 }
 
 void Scene::update(glm::mat4x4 const &view, float const dt) {
-  if (debug_parameters_.freeze) {
-    // BUG: this will prevent particles to be sorted for rendering when needed.
-    return;
+  CPU_TRACE_SCOPE("Scene::update");
+
+#if USE_CPU_TRACE
+  EnableCPUTrace(debug_parameters_.cpu_trace);
+#endif
+
+  auto const& params = simulation_parameters();
+
+  /* With a fixed rate, the frame time is accumulated and simulated by whole
+   * steps, the particles are then rendered between the last two states.
+   * Frozen particles take no step, but are still sorted for the view. */
+  float time_step = dt;
+  unsigned int num_steps = debug_parameters_.freeze ? 0u : 1u;
+  float rewind_time = 0.0f;
+  if (params.simulation_rate > 0) {
+    time_step = 1.0f / params.simulation_rate;
+    if (!debug_parameters_.freeze) {
+      time_accumulator_ += dt;
+      num_steps = static_cast<unsigned int>(time_accumulator_ / time_step);
+      time_accumulator_ -= num_steps * time_step;
+
+      /* Drop the time that can't be caught up, instead of taking ever more
+       * steps per frame. */
+      unsigned int const max_steps = static_cast<unsigned int>(std::max(params.max_substeps, 1));
+      num_steps = std::min(num_steps, max_steps);
+    }
+
+    rewind_time = (time_step - time_accumulator_) * params.time_step_factor;
+  } else {
+    time_accumulator_ = 0.0f;
+  }
+
+  if (cpu_particle_) {
+    for (unsigned int i = 0u; i < num_steps; ++i) {
+      cpu_particle_->update(time_step, view);
+    }
+    cpu_particle_->set_render_rewind_time(rewind_time);
+  } else {
+    gpu_particle_->enable_sync_readback(debug_parameters_.sync_readback);
+    gpu_particle_->enable_sort_benchmark(debug_parameters_.benchmark_sorting);
+    gpu_particle_->enable_fused_pipeline(debug_parameters_.fused_pipeline);
+    if (debug_parameters_.pool_capacity_log2 != pool_capacity_log2_) {
+      pool_capacity_log2_ = debug_parameters_.pool_capacity_log2;
+      gpu_particle_->resize(1u << pool_capacity_log2_);
+    }
+    if ((debug_parameters_.extra_emitters != num_extra_emitters_)
+     || (debug_parameters_.extra_systems != num_extra_systems_)) {
+      setup_extra_emitters(debug_parameters_.extra_emitters, debug_parameters_.extra_systems);
+    }
+    /* Profiled and sorted once per rendered frame, whatever its steps. */
+    gpu_particle_->begin_frame();
+    for (unsigned int i = 0u; i < num_steps; ++i) {
+      gpu_particle_->update(time_step, view);
+    }
+    gpu_particle_->end_frame(view, rewind_time);
+    debug_parameters_.pipeline_traffic = gpu_particle_->pipeline_traffic();
   }
-  gpu_particle_->update(dt, view);
 }
 
 void Scene::render(glm::mat4x4 const &view, glm::mat4x4 const& viewProj) {
+  CPU_TRACE_SCOPE("Scene::render");
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  const auto& simulation_parameters = gpu_particle_->simulation_parameters();
+  const auto& simulation_params = simulation_parameters();
   glm::mat4x4 mvp;
   glm::mat4x4 model;
   glm::vec4 color;
@@ -86,19 +163,23 @@ void Scene::render(glm::mat4x4 const &view, glm::mat4x4 const& viewProj) {
   glDisable(GL_DEPTH_TEST);
   glEnable(GL_BLEND);
 
-  if (true) {
+  bool const alpha_blending = cpu_particle_ ? cpu_particle_->rendering_parameters().enable_alpha_blending
+                                            : gpu_particle_->rendering_parameters().enable_alpha_blending;
+  if (!alpha_blending) {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE);
   } else {
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    gpu_particle_->enable_sorting(true);
+  }
+  if (gpu_particle_) {
+    gpu_particle_->enable_sorting(alpha_blending);
   }
 
   // Emitters.
   if (debug_parameters_.show_emitter) {
-    const float radius = simulation_parameters.emitter_radius;
+    const float radius = simulation_params.emitter_radius;
     glm::vec3 scale(1.0f);
 
-    switch (simulation_parameters.emitter_type) {
+    switch (simulation_params.emitter_type) {
       case GPUParticle::EMITTER_DISK:
         scale = glm::vec3(radius, 1.0f, radius);
       break;
@@ -113,7 +194,7 @@ void Scene::render(glm::mat4x4 const &view, glm::mat4x4 const& viewProj) {
       break;
     }
 
-    const float *v = simulation_parameters.emitter_position;
+    const float *v = simulation_params.emitter_position;
     model =   glm::translate(glm::mat4(), glm::vec3(v[0], v[1], v[2]))
             * glm::scale(glm::mat4(), scale);
     color = glm::vec4(0.9f, 0.9f, 1.0f, 0.05f);
@@ -122,14 +203,16 @@ void Scene::render(glm::mat4x4 const &view, glm::mat4x4 const& viewProj) {
   }
 
   // Particles.
-  gpu_particle_->render(view, viewProj);
+  if (cpu_particle_) {
+    cpu_particle_->render(view, viewProj);
+  } else {
+    gpu_particle_->render(view, viewProj);
+  }
 
   // Bounding and test volumes.
   glEnable(GL_DEPTH_TEST);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-  const auto &simulation_params = gpu_particle_->simulation_parameters();
-
   if (debug_parameters_.show_simulation_volume) {
     switch (simulation_params.bounding_volume) {
       case GPUParticle::VOLUME_SPHERE: {
@@ -412,8 +495,12 @@ void Scene::setup_texture() {
 
 void Scene::setup_views() {
   views_.main = new views::Main();
-  views_.simulation = new views::Simulation(gpu_particle_->simulation_parameters());
-  views_.rendering = new views::Rendering(gpu_particle_->rendering_parameters());
+  views_.simulation = gpu_particle_ ? new views::Simulation(simulation_parameters(), gpu_particle_->max_bounding_volume_size())
+                                    : new views::Simulation(simulation_parameters());
+  views_.rendering = new views::Rendering(
+    cpu_particle_ ? cpu_particle_->rendering_parameters()
+                  : gpu_particle_->rendering_parameters()
+  );
   views_.debug = new views::Debug(debug_parameters_);
 
   views_.main->push_view(views_.simulation);
@@ -421,8 +508,67 @@ void Scene::setup_views() {
   views_.main->push_view(views_.debug);
 }
 
+GPUParticle::SimulationParameters_t& Scene::simulation_parameters() {
+  return cpu_particle_ ? cpu_particle_->simulation_parameters()
+                       : gpu_particle_->simulation_parameters();
+}
+
+void Scene::setup_extra_emitters(int const num_emitters, int const num_systems) {
+  auto const& params = simulation_parameters();
+
+  /* Variations of the main system forces, in its volume. */
+  gpu_particle_->clear_systems();
+  for (int i = 0; i < num_systems; ++i) {
+    float const t = (i + 1.0f) / num_systems;
+
+    GPUParticle::System_t system;
+    system.bounding_volume = params.bounding_volume;
+    system.bounding_volume_size = params.bounding_volume_size;
+    system.curlnoise_factor = params.curlnoise_factor * (0.25f + 1.5f * t);
+    system.velocity_factor = params.velocity_factor * (0.5f + t);
+    system.enable_scattering = (i % 2) != 0;
+    system.enable_curlnoise = params.enable_curlnoise;
+    if (gpu_particle_->add_system(system) < 0) {
+      break;
+    }
+  }
+
+  /* Small emitters spread evenly on a sphere, shooting outward. */
+  float const kGoldenAngle = 2.39996323f;
+  float const radius = 0.35f * params.bounding_volume_size;
+  float const speed = glm::length(glm::vec3(params.emitter_direction[0], params.emitter_direction[1], params.emitter_direction[2]));
+
+  /* The main system is used when there are no others. */
+  int const first_system = (gpu_particle_->num_systems() > 1u) ? 1 : 0;
+  int const system_count = static_cast<int>(gpu_particle_->num_systems()) - first_system;
+
+  for (int i = 0; i < num_emitters; ++i) {
+    float const y = 1.0f - 2.0f * (i + 0.5f) / num_emitters;
+    float const r = sqrtf(1.0f - y * y);
+    float const theta = kGoldenAngle * i;
+    glm::vec3 const normal(r * cosf(theta), y, r * sinf(theta));
+
+    GPUParticle::Emitter_t emitter;
+    emitter.type = GPUParticle::EMITTER_BALL;
+    emitter.radius = 2.0f;
+    emitter.rate = 1000.0f;
+    emitter.min_age = params.min_age;
+    emitter.max_age = params.max_age;
+    emitter.system = static_cast<unsigned int>(first_system + i % system_count);
+    for (int j = 0; j < 3; ++j) {
+      emitter.position[j] = radius * normal[j];
+      emitter.direction[j] = speed * normal[j];
+    }
+    if (!gpu_particle_->add_emitter(emitter)) {
+      break;
+    }
+  }
+  num_extra_emitters_ = num_emitters;
+  num_extra_systems_ = num_systems;
+}
+
 void Scene::draw_grid(glm::mat4x4 const &mvp) {
-  const auto& simulation_params = gpu_particle_->simulation_parameters();
+  const auto& simulation_params = simulation_parameters();
 
   glUseProgram(pgm_.grid);
   {
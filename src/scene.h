@@ -6,7 +6,8 @@
 #include "opengl.h"
 #include "glm/mat4x4.hpp"
 #include "glm/vec4.hpp"
-class GPUParticle;
+#include "api/gpu_particle.h"
+class CPUParticle;
 class UIView;
 namespace views {
 class Main;
@@ -21,13 +22,35 @@ class Scene {
     bool show_emitter = true;
     bool show_simulation_volume = true;
     bool freeze = false;
+    bool sync_readback = false;
+    bool benchmark_sorting = false;
+    bool fused_pipeline = false;
+    bool cpu_trace = false;                           //< record the CPU_TRACE_SCOPE zones.
+    int extra_emitters = 0;                           //< emitters added around the main one.
+    int extra_systems = 0;                            //< systems the extra emitters are spread over.
+    bool gpu_simulation = false;                      //< set by the scene, false with the CPU backend.
+    int pool_capacity_log2 = 0;                       //< particles pool capacity, set by the scene on init.
+    GPUParticle::PipelineTraffic_t pipeline_traffic;  //< set by the scene, for display.
+    GPUProfiler *profiler = nullptr;                  //< set by the scene, null with the CPU backend.
   };
 
   Scene() :
-    gpu_particle_(nullptr)
+    gpu_particle_(nullptr),
+    cpu_particle_(nullptr),
+    time_accumulator_(0.0f),
+    num_extra_emitters_(0),
+    num_extra_systems_(0),
+    pool_capacity_log2_(0)
   {}
 
-  void init();
+  /// @param use_cpu_simulation simulate particles on the host instead of the device.
+  /// @param layout storage layout of the device particles.
+  /// @param pool management of the device particles pool.
+  /// @param max_particle_count initial capacity of the device particles pool.
+  void init(bool use_cpu_simulation = false,
+            GPUParticle::ParticleLayout const layout = GPUParticle::LAYOUT_AOS,
+            GPUParticle::ParticlePool const pool = GPUParticle::POOL_APPEND_CONSUME,
+            unsigned int const max_particle_count = GPUParticle::kDefaultMaxParticleCount);
   void deinit();
 
   void update(glm::mat4x4 const& view, float const dt);
@@ -43,6 +66,10 @@ class Scene {
   void setup_texture();
   void setup_views();
 
+  GPUParticle::SimulationParameters_t& simulation_parameters();
+
+  void setup_extra_emitters(int const num_emitters, int const num_systems);
+
   void draw_grid(glm::mat4x4 const &mvp);
   void draw_wirecube(glm::mat4x4 const &mvp, const glm::vec4 &color);
   void draw_sphere(glm::mat4x4 const &mvp, const glm::vec4 &color, bool bFill = false);
@@ -91,6 +118,11 @@ class Scene {
 
   GLuint gl_sprite_tex_;
   GPUParticle *gpu_particle_;
+  CPUParticle *cpu_particle_;                     //< used instead of gpu_particle_ when set.
+  float time_accumulator_;                        //< frame time not simulated yet, with a fixed rate.
+  int num_extra_emitters_;                        //< extra emitters in the device table.
+  int num_extra_systems_;                         //< extra systems in the device table.
+  int pool_capacity_log2_;                        //< capacity the device pool was last resized to.
 
   struct {
     views::Main *main;
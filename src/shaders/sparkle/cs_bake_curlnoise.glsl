@@ -0,0 +1,42 @@
+#version 430 core
+
+// ============================================================================
+
+/* Precompute the curl noise over the simulation volume, so that the
+ * simulation stage can replace the noise evaluations by one texture fetch.
+ */
+
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_curlnoise.glsl"
+
+// ----------------------------------------------------------------------------
+
+// Half size of the baked volume, centered at the origin.
+uniform float uExtent;
+uniform float uCurlNoiseScale;
+
+layout(rgba16f, binding = IMAGE_BINDING_CURLNOISE)
+writeonly uniform image3D uCurlNoiseImage;
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = CURLNOISE_BAKE_GROUP_WIDTH,
+       local_size_y = CURLNOISE_BAKE_GROUP_WIDTH,
+       local_size_z = CURLNOISE_BAKE_GROUP_WIDTH) in;
+void main() {
+  const ivec3 coords = ivec3(gl_GlobalInvocationID);
+  const ivec3 resolution = imageSize(uCurlNoiseImage);
+
+  if (any(greaterThanEqual(coords, resolution))) {
+    return;
+  }
+
+  // Sample at texel centers, as expected by trilinear filtering.
+  const vec3 texcoord = (vec3(coords) + 0.5f) / vec3(resolution);
+  const vec3 pos = (2.0f * texcoord - 1.0f) * uExtent;
+
+  const vec3 curl = compute_curl_analytic(pos * uCurlNoiseScale);
+  imageStore(uCurlNoiseImage, coords, vec4(curl, 0.0f));
+}
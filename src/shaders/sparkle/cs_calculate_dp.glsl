@@ -8,6 +8,12 @@
 */
 
 #include "sparkle/interop.h"
+#include "sparkle/inc_storage.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -15,39 +21,35 @@ uniform mat4 uViewMatrix;
 
 // ----------------------------------------------------------------------------
 
-#if SPARKLE_USE_SOA_LAYOUT
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_B)
-readonly buffer PositionBufferB {
-  vec4 positions[];
-};
-
-#else
-
-layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
-readonly buffer ParticleBufferB {
-  TParticle particles[];
-};
+layout(binding = ATOMIC_COUNTER_BINDING_SECOND)
+uniform atomic_uint write_count;
 
-#endif
+// ----------------------------------------------------------------------------
 
 layout(std430, binding = STORAGE_BINDING_DOT_PRODUCTS)
 writeonly coherent buffer DotProducts {
   float dp[];
 };
 
+#if SPARKLE_USE_RING
+// Ring pool : the rank of each particle in the previous sorted order is
+// written here, as the simulation does not know its ring index once the tail
+// moved.
+layout(std430, binding = STORAGE_BINDING_PREVIOUS_RANKS)
+writeonly buffer PreviousRanks {
+  uint previous_ranks[];
+};
+#endif
+
 // ----------------------------------------------------------------------------
 
 vec4 GetPositionWS(in uint id) {
-  vec4 pos;
-
-#if SPARKLE_USE_SOA_LAYOUT
-  pos = positions[id];
+#if SPARKLE_USE_FREE_LIST
+  // Simulated particles stayed in their slot.
+  return vec4(LoadPositionA(alive_indices_b[id]), 1.0f);
 #else
-  pos = particles[id].position;
+  return vec4(LoadPositionB(id), 1.0f);
 #endif
-
-  return vec4(pos.xyz, 1.0f);
 }
 
 // ----------------------------------------------------------------------------
@@ -56,8 +58,29 @@ layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
 void main() {
   const uint tid = gl_GlobalInvocationID.x;
 
+  // The host only knows an upper bound of the particle count, slots past the
+  // simulated particles keep their clear value and are sorted last.
+  if (tid >= atomicCounter(write_count)) {
+    return;
+  }
+
+#if SPARKLE_USE_RING
+  // Survivors ranks were set by the last sort_final, newborns ranks follow
+  // them (see cs_emission).
+  const uint slot = RingSlot(tid);
+  previous_ranks[tid] = slot_ranks[slot];
+
+  // Masked particles are kept in the sorted slots, past the alive ones.
+  const TParticle p = LoadParticleA(slot);
+  if (p.age <= 0.0f) {
+    dp[tid] = kMaskedDepth;
+    return;
+  }
+  vec4 positionVS = uViewMatrix * vec4(p.position.xyz, 1.0f);
+#else
   // Transform a particle's position from world space to view space.
   vec4 positionVS = uViewMatrix * GetPositionWS(tid);
+#endif
 
   // The default front of camera in view space.
   const vec3 targetVS = vec3(0.0f, 0.0f, -1.0f);
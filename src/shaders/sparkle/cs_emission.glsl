@@ -1,4 +1,7 @@
 #version 430 core
+#extension GL_KHR_shader_subgroup_ballot : enable
+#extension GL_ARB_shader_ballot : enable
+#extension GL_ARB_gpu_shader_int64 : enable
 
 // ============================================================================
 /*
@@ -8,121 +11,66 @@
 // ============================================================================
 
 #include "sparkle/interop.h"
-#include "sparkle/inc_math.glsl"
+#include "sparkle/inc_random.glsl"
+#include "sparkle/inc_emission.glsl"
+#include "sparkle/inc_append.glsl"
+#include "sparkle/inc_storage.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
 
 //-----------------------------------------------------------------------------
 
-layout(location=0) uniform uint uEmitCount;
-layout(location=1) uniform uint uEmitterType;
-layout(location=2) uniform vec3 uEmitterPosition;
-layout(location=3) uniform vec3 uEmitterDirection;
-layout(location=4) uniform float uEmitterRadius;
-layout(location=5) uniform float uParticleMinAge;
-layout(location=6) uniform float uParticleMaxAge;
+// Pool capacity, the host budget might exceed it.
+uniform uint uMaxParticleCount;
 
 //-----------------------------------------------------------------------------
 
-layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
-uniform atomic_uint write_count;
-
-#if SPARKLE_USE_SOA_LAYOUT
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_A)
-writeonly buffer PositionBufferA {
-  vec4 positions[];
-};
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_A)
-writeonly buffer VelocityBufferA {
-  vec4 velocities[];
-};
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A)
-writeonly buffer AttributeBufferA {
-  vec4 attributes[];
-};
-
-#else
-
-layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
-writeonly buffer ParticleBufferA {
-  TParticle particles[];
-};
+void PushParticle(in TParticle p, in bool emit) {
+  // Emit particle id, reserved by the whole group.
+  // The host budget is based on a delayed particle count, so the pool
+  // might already be full.
+  const uint id = GroupAppend(emit, uMaxParticleCount);
 
-#endif
-
-layout(std430, binding = STORAGE_BINDING_RANDOM_VALUES)
-readonly buffer RandomBuffer {
-  float randbuffer[];
-};
-
-// ----------------------------------------------------------------------------
-
-void PushParticle(in vec3 position,
-                  in vec3 velocity,
-                  in float age)
-{
-  // Emit particle id.
-  const uint id = atomicCounterIncrement(write_count);
+  if (!emit || (id >= uMaxParticleCount)) {
+    return;
+  }
 
-#if SPARKLE_USE_SOA_LAYOUT
-  positions[id]  = vec4(position, 1.0f);
-  velocities[id] = vec4(velocity, 0.0f);
-  attributes[id] = vec4(age, age, 0.0f, uintBitsToFloat(id));
+#if SPARKLE_USE_FREE_LIST
+  // Newborns take a free slot, listed after the alive particles.
+  const uint slot = PopFreeSlot(id, uMaxParticleCount);
+  alive_indices_a[id] = slot;
+  p.id = slot;
+  StoreParticleA(slot, p);
+#elif SPARKLE_USE_RING
+  // Newborns are written at the head of the ring, their rank follows the
+  // previous sorted particles (see cs_calculate_dp).
+  const uint slot = RingSlot(id);
+  slot_ranks[slot] = id;
+  p.id = slot;
+  StoreParticleA(slot, p);
 #else
-  TParticle p;
-  p.position = vec4(position, 1.0f);
-  p.velocity = vec4(velocity, 0.0f);
-  p.start_age = age;
-  p.age = age;
   p.id = id;
-
-  particles[id] = p;
+  StoreParticleA(id, p);
 #endif
 }
 
 // ----------------------------------------------------------------------------
 
-void CreateParticle(const uint gid) {
-  // Random vector.
-  const uint rid = 3u * gid;
-  const vec3 rn = vec3(randbuffer[rid], randbuffer[rid+1u], randbuffer[rid+2u]);
-
-  // Position
-  vec3 pos = uEmitterPosition;
-  if (uEmitterType == 1) {
-    //pos += disk_distribution(uEmitterRadius, rn.xy);
-    pos += disk_even_distribution(uEmitterRadius, gid, uEmitCount);
-  } else if (uEmitterType == 2) {
-    pos += sphere_distribution(uEmitterRadius, rn.xy);
-  } else if (uEmitterType == 3) {
-    pos += ball_distribution(uEmitterRadius, rn);
-  }
-
-  // Velocity
-  vec3 vel = uEmitterDirection;
-
-  // Age
-  // The age is set by thread groups to assure we have a number of particles
-  // factors of groupWidth, this method is safe but prevents continuous emission.
-  const float group_rand = randbuffer[gl_WorkGroupID.x];
-  // [As the threadgroup are not full, some dead particles might appears if not
-  // skipped in following stages].
-  const float single_rand = randbuffer[gid];
-
-  const float age = mix( uParticleMinAge, uParticleMaxAge, single_rand);
-
-  PushParticle(pos, vel, age);
-}
-
-// ----------------------------------------------------------------------------
-
 layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
 void main() {
   const uint gid = gl_GlobalInvocationID.x;
 
-  if (gid < uEmitCount) {
-    CreateParticle(gid);
+  const bool emit = (gid < GetEmitCount());
+
+  TParticle p;
+  if (emit) {
+    p = CreateParticle(gid);
   }
+
+  // Reached by every invocation, the append is group-wide.
+  PushParticle(p, emit);
 }
 
@@ -0,0 +1,84 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Clamp the particles emitted this frame to the free slots of the pool, and
+ * write the emission dispatch arguments.
+ *
+ * The alive count is read on device, so that the emission does not wait for
+ * its readback by the host. The rate particles cut from each emitter are
+ * given back to its accumulator, its burst ones are dropped.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+
+// ----------------------------------------------------------------------------
+
+uniform uint uNumEmitters;
+// Particles the host allows to emit this frame, for all emitters.
+uniform uint uEmitCount;
+uniform uint uMaxParticleCount;
+
+// Particles alive from the previous frame.
+layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
+uniform atomic_uint alive_count;
+
+// Scanned emitters counts, the last slot holds their total.
+layout(std430, binding = STORAGE_BINDING_EMITTER_OFFSETS)
+buffer EmitterOffsetBuffer {
+  uint emitter_offsets[];
+};
+
+// Particles of the rates not emitted yet, kept between frames.
+layout(std430, binding = STORAGE_BINDING_EMITTER_ACCUMULATORS)
+buffer EmitterAccumulatorBuffer {
+  float accumulators[];
+};
+
+// One shot particles set by the host, consumed here.
+layout(std430, binding = STORAGE_BINDING_EMITTER_BURSTS)
+buffer EmitterBurstBuffer {
+  uint bursts[];
+};
+
+layout(std430, binding = STORAGE_BINDING_EMISSION_ARGS)
+writeonly buffer EmissionArgs {
+  uint dispatch_x;
+  uint dispatch_y;
+  uint dispatch_z;
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_LocalInvocationID.x;
+
+  const uint num_alive = min(atomicCounter(alive_count), uMaxParticleCount);
+  const uint num_free = uMaxParticleCount - num_alive;
+  const uint scanned_total = emitter_offsets[uNumEmitters];
+  const uint total = min(min(scanned_total, uEmitCount), num_free);
+
+  // Emitters past the total are cut (see FindEmitter), an emitter rate
+  // particles coming before its burst ones.
+  for (uint i = tid; i < uNumEmitters; i += gl_WorkGroupSize.x) {
+    const uint first = emitter_offsets[i];
+    const uint last = (i + 1u < uNumEmitters) ? emitter_offsets[i + 1u] : scanned_total;
+    const uint rate_count = last - first - bursts[i];
+    const uint emitted = clamp(total, first, last) - first;
+    accumulators[i] += float(rate_count - min(emitted, rate_count));
+    bursts[i] = 0u;
+  }
+  barrier();
+
+  if (tid == 0u) {
+    emitter_offsets[uNumEmitters] = total;
+
+    dispatch_x = (total + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+    dispatch_y = 1u;
+    dispatch_z = 1u;
+  }
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,73 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Number of particles each emitter creates this frame, from its rate and its
+ * pending burst. The counts are then scanned into the emitters offsets (see
+ * inc_emission), and their total clamped by cs_emission_args, which gives
+ * back the rate particles it cuts to the accumulators and clears the bursts.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+
+// ----------------------------------------------------------------------------
+
+uniform uint uNumEmitters;
+uniform float uTimeStep;
+// Particles an emitter rate creates per frame at most, bursts excepted.
+uniform uint uBatchCount;
+
+layout(std430, binding = STORAGE_BINDING_EMITTERS)
+readonly buffer EmitterBuffer {
+  TEmitter emitters[];
+};
+
+// One more slot than emitters, which receives the total once scanned.
+layout(std430, binding = STORAGE_BINDING_EMITTER_OFFSETS)
+writeonly buffer EmitterOffsetBuffer {
+  uint emit_counts[];
+};
+
+// Particles of the rates not emitted yet, kept between frames.
+layout(std430, binding = STORAGE_BINDING_EMITTER_ACCUMULATORS)
+buffer EmitterAccumulatorBuffer {
+  float accumulators[];
+};
+
+// One shot particles set by the host.
+layout(std430, binding = STORAGE_BINDING_EMITTER_BURSTS)
+readonly buffer EmitterBurstBuffer {
+  uint bursts[];
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint gid = gl_GlobalInvocationID.x;
+
+  if (gid == 0u) {
+    emit_counts[uNumEmitters] = 0u;
+  }
+  if (gid >= uNumEmitters) {
+    return;
+  }
+
+  const float rate = emitters[gid].rate;
+
+  // Particles above the batch are emitted on the next frames, up to a batch
+  // late, so that a rate reached in average is kept.
+  uint count = uBatchCount;
+  float remainder = 0.0f;
+  if (rate > 0.0f) {
+    const float expected = accumulators[gid] + rate * max(uTimeStep, 0.0f);
+    count = min(uint(expected), uBatchCount);
+    remainder = min(expected - float(count), float(uBatchCount));
+  }
+
+  accumulators[gid] = remainder;
+  emit_counts[gid] = count + bursts[gid];
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,46 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * First pass of the fluid : density and velocity of every grid particle,
+ * read by the neighbours sweep of the simulation (see inc_fluid).
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_storage.glsl"
+#include "sparkle/inc_grid.glsl"
+#include "sparkle/inc_fluid.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= GridParticleCount()) {
+    return;
+  }
+
+  const uvec4 entry = grid_particles[tid];
+  const uint index = GridParticleIndex(entry);
+
+  // Slot of the particle, as read by the grid build.
+#if SPARKLE_USE_FREE_LIST
+  const uint slot = alive_indices_a[index];
+#elif SPARKLE_USE_RING
+  const uint slot = RingSlot(index);
+#else
+  const uint slot = index;
+#endif
+  const vec3 velocity = LoadParticleA(slot).velocity.xyz;
+
+  fluid_states[tid] = vec4(velocity, FluidDensity(GridParticlePosition(entry), index));
+}
+
+// ----------------------------------------------------------------------------
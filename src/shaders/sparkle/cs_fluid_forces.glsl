@@ -0,0 +1,39 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Fluid acceleration of every grid particle, as applied by the simulation,
+ * written in grid order. Used by the bench to time the fluid forces alone and
+ * to check them against its host reference.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_grid.glsl"
+#include "sparkle/inc_fluid.glsl"
+
+// ----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_FLUID_ACCELERATIONS)
+writeonly buffer FluidAccelerations {
+  vec4 fluid_accelerations[];
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= GridParticleCount()) {
+    return;
+  }
+
+  const uvec4 entry = grid_particles[tid];
+  const vec3 velocity = fluid_states[tid].xyz;
+  const vec3 acceleration = FluidAcceleration(GridParticlePosition(entry), velocity, GridParticleIndex(entry));
+
+  fluid_accelerations[tid] = vec4(acceleration, 0.0f);
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,60 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * First stage of the spatial grid build : count the particles of each cell,
+ * keeping the rank of each particle in its cell for the scatter.
+ *
+ * Particles are read as the simulation does, up to the first counter. The
+ * masked particles of the ring pool are left out of the grid.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_storage.glsl"
+#include "sparkle/inc_grid.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
+
+// ----------------------------------------------------------------------------
+
+layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
+uniform atomic_uint read_count;
+
+// Cell and rank in the cell of each read particle.
+layout(std430, binding = STORAGE_BINDING_GRID_PARTICLE_KEYS)
+writeonly buffer GridParticleKeys {
+  uvec2 grid_keys[];
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= atomicCounter(read_count)) {
+    return;
+  }
+
+#if SPARKLE_USE_FREE_LIST
+  const vec3 position = LoadPositionA(alive_indices_a[tid]);
+#elif SPARKLE_USE_RING
+  const TParticle p = LoadParticleA(RingSlot(tid));
+  if (p.age <= 0.0f) {
+    grid_keys[tid] = uvec2(0xFFFFFFFFu);
+    return;
+  }
+  const vec3 position = p.position.xyz;
+#else
+  const vec3 position = LoadPositionA(tid);
+#endif
+
+  const uint cell = GridCellIndex(GridCellCoords(position));
+  grid_keys[tid] = uvec2(cell, atomicAdd(grid_cell_offsets[cell], 1u));
+}
+
+// ----------------------------------------------------------------------------
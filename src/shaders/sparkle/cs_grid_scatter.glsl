@@ -0,0 +1,55 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Last stage of the spatial grid build : once the cells counts are scanned to
+ * offsets, write each particle position and read index at its sorted place.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_storage.glsl"
+#include "sparkle/inc_grid.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
+
+// ----------------------------------------------------------------------------
+
+layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
+uniform atomic_uint read_count;
+
+layout(std430, binding = STORAGE_BINDING_GRID_PARTICLE_KEYS)
+readonly buffer GridParticleKeys {
+  uvec2 grid_keys[];
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= atomicCounter(read_count)) {
+    return;
+  }
+
+  const uvec2 key = grid_keys[tid];
+  if (key.x == 0xFFFFFFFFu) {
+    return;
+  }
+
+#if SPARKLE_USE_FREE_LIST
+  const vec3 position = LoadPositionA(alive_indices_a[tid]);
+#elif SPARKLE_USE_RING
+  const vec3 position = LoadPositionA(RingSlot(tid));
+#else
+  const vec3 position = LoadPositionA(tid);
+#endif
+
+  grid_particles[grid_cell_offsets[key.x] + key.y] = GridParticleEntry(position, tid);
+}
+
+// ----------------------------------------------------------------------------
@@ -0,0 +1,62 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Count the neighbours closer than a radius of every grid particle, sweeping
+ * its 27 neighbour cells as the simulation does.
+ *
+ * Grid particles are visited in their sorted order, each group adding its
+ * count once to the total.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_grid.glsl"
+
+// ----------------------------------------------------------------------------
+
+uniform float uRadius;
+
+layout(std430, binding = STORAGE_BINDING_GRID_NEIGHBOURS)
+buffer GridNeighbours {
+  uint num_neighbours;
+};
+
+shared uint s_num_neighbours;
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (gl_LocalInvocationID.x == 0u) {
+    s_num_neighbours = 0u;
+  }
+  barrier();
+
+  if (tid < GridParticleCount()) {
+    const vec3 position = GridParticlePosition(grid_particles[tid]);
+    const float radius_squared = uRadius * uRadius;
+    uint count = 0u;
+
+    const ivec3 cell = GridCellCoords(position);
+    for (int dz = -1; dz <= 1; ++dz) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        const uvec2 range = GridRowRange(cell, dy, dz);
+        for (uint i = range.x; i < range.y; ++i) {
+          const vec3 d = GridParticlePosition(grid_particles[i]) - position;
+          count += ((i != tid) && (dot(d, d) < radius_squared)) ? 1u : 0u;
+        }
+      }
+    }
+    atomicAdd(s_num_neighbours, count);
+  }
+  barrier();
+
+  if (gl_LocalInvocationID.x == 0u) {
+    atomicAdd(num_neighbours, s_num_neighbours);
+  }
+}
+
+// ----------------------------------------------------------------------------
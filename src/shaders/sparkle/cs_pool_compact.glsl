@@ -0,0 +1,49 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Move the alive particles of a free list or ring pool to the first slots of
+ * a new one, when the pool is resized.
+ *
+ * The previous storage is bound as B, and its alive list as the B one, the
+ * new pool storage as A. The new free list starts from its first unused slot,
+ * the new ring from its first slot.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_storage.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#endif
+
+// ----------------------------------------------------------------------------
+
+// Particles kept, the last ones are dropped when shrinking.
+uniform uint uNumParticles;
+
+#if SPARKLE_USE_RING
+// Tail and capacity of the previous ring.
+uniform uint uRingTail;
+uniform uint uRingCapacity;
+#endif
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= uNumParticles) {
+    return;
+  }
+
+#if SPARKLE_USE_RING
+  CopyParticleBToA((uRingTail + tid) % uRingCapacity, tid);
+#else
+  CopyParticleBToA(alive_indices_b[tid], tid);
+  alive_indices_a[tid] = tid;
+#endif
+}
+
+// ----------------------------------------------------------------------------
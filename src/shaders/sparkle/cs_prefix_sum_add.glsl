@@ -0,0 +1,33 @@
+#version 430 core
+
+/*
+ * Last stage of the prefix sum : add the scanned block totals to their
+ * block values.
+*/
+
+#include "sparkle/interop.h"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_PREFIX_SUM_DATA)
+buffer Values {
+  uint values[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PREFIX_SUM_BLOCKS)
+readonly buffer BlockSums {
+  uint block_sums[];
+};
+
+uniform uint uNumElements;
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid < uNumElements) {
+    values[tid] += block_sums[gl_WorkGroupID.x];
+  }
+}
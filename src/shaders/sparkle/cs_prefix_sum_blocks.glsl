@@ -0,0 +1,42 @@
+#version 430 core
+
+/*
+ * First stage of the prefix sum : exclusive scan of each block of values, in
+ * place, storing the block totals to be scanned next.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_scan.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_PREFIX_SUM_DATA)
+buffer Values {
+  uint values[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PREFIX_SUM_BLOCKS)
+writeonly buffer BlockSums {
+  uint block_sums[];
+};
+
+uniform uint uNumElements;
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  const uint value = (tid < uNumElements) ? values[tid] : 0u;
+
+  uint total;
+  const uint offset = GroupExclusiveScan(value, total);
+
+  if (tid < uNumElements) {
+    values[tid] = offset;
+  }
+  if (gl_LocalInvocationID.x == 0u) {
+    block_sums[gl_WorkGroupID.x] = total;
+  }
+}
@@ -0,0 +1,49 @@
+#version 430 core
+
+/*
+ * Second stage of the prefix sum : exclusive scan of the block totals, in
+ * place.
+ *
+ * Dispatched as a single group, each invocation serially handles a
+ * contiguous range of totals.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_scan.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_PREFIX_SUM_BLOCKS)
+buffer BlockSums {
+  uint block_sums[];
+};
+
+uniform uint uNumBlocks;
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint lid = gl_LocalInvocationID.x;
+
+  const uint range_width = (uNumBlocks + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+  const uint first = min(lid * range_width, uNumBlocks);
+  const uint last  = min(first + range_width, uNumBlocks);
+
+  // Sum the range.
+  uint range_sum = 0u;
+  for (uint i = first; i < last; ++i) {
+    range_sum += block_sums[i];
+  }
+
+  // Offset of the range.
+  uint total;
+  uint offset = GroupExclusiveScan(range_sum, total);
+
+  // Write the exclusive prefix sum of the range.
+  for (uint i = first; i < last; ++i) {
+    const uint sum = block_sums[i];
+    block_sums[i] = offset;
+    offset += sum;
+  }
+}
@@ -0,0 +1,52 @@
+#version 430 core
+
+/*
+ * First stage of a radix sort pass : count the digits of each block of keys.
+ *
+ * Histograms are stored digit major (all blocks for digit 0, then digit 1..)
+ * so that their exclusive prefix sum gives the scatter offset of each
+ * (digit, block) pair.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_radix_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_SORT_KEYS_FIRST)
+readonly buffer ReadKeys {
+  uint read_keys[];
+};
+
+layout(std430, binding = STORAGE_BINDING_RADIX_HISTOGRAMS)
+writeonly buffer Histograms {
+  uint histograms[];
+};
+
+//-----------------------------------------------------------------------------
+
+shared uint s_histogram[RADIX_SORT_NUM_BUCKETS];
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+  const uint lid = gl_LocalInvocationID.x;
+
+  if (lid < RADIX_SORT_NUM_BUCKETS) {
+    s_histogram[lid] = 0u;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if (tid < uNumElements) {
+    uint key = read_keys[tid];
+    key = (uFloatKeys) ? FlipFloatKey(uintBitsToFloat(key)) : key;
+    atomicAdd(s_histogram[GetDigit(key)], 1u);
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if (lid < RADIX_SORT_NUM_BUCKETS) {
+    histograms[lid * gl_NumWorkGroups.x + gl_WorkGroupID.x] = s_histogram[lid];
+  }
+}
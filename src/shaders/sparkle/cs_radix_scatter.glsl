@@ -0,0 +1,110 @@
+#version 430 core
+
+/*
+ * Last stage of a radix sort pass : move keys and indices to their sorted
+ * position for the current digit.
+ *
+ * Each group first sorts its block by digit with one split per digit bit,
+ * which keeps the order of keys sharing a digit (the sort must be stable).
+ * An element rank among its digit is then its distance to the first element
+ * of the same digit, added to the scanned (digit, block) offset.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_radix_sort.glsl"
+#include "sparkle/inc_scan.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_SORT_KEYS_FIRST)
+readonly buffer ReadKeys {
+  uint read_keys[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_KEYS_SECOND)
+writeonly buffer WriteKeys {
+  uint write_keys[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+readonly buffer ReadIndices {
+  uint read_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_SECOND)
+writeonly buffer WriteIndices {
+  uint write_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_RADIX_HISTOGRAMS)
+readonly buffer Histograms {
+  uint offsets[];
+};
+
+//-----------------------------------------------------------------------------
+
+// Marks the padding elements of the last block, they are never written.
+#define INVALID_INDEX   0xFFFFFFFFu
+
+shared uint s_keys[PARTICLES_KERNEL_GROUP_WIDTH];
+shared uint s_indices[PARTICLES_KERNEL_GROUP_WIDTH];
+shared uint s_digits[PARTICLES_KERNEL_GROUP_WIDTH];
+shared uint s_digit_start[RADIX_SORT_NUM_BUCKETS];
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+  const uint lid = gl_LocalInvocationID.x;
+
+  // Load the element, the first pass reads the depths in particles order.
+  uint key = 0u;
+  uint index = INVALID_INDEX;
+  if (tid < uNumElements) {
+    key = read_keys[tid];
+    key = (uFloatKeys) ? FlipFloatKey(uintBitsToFloat(key)) : key;
+    index = (uFloatKeys) ? tid : read_indices[tid];
+  }
+
+  // Padding uses the last digit, being after the valid elements it does not
+  // change their rank.
+  uint digit = (index != INVALID_INDEX) ? GetDigit(key) : (RADIX_SORT_NUM_BUCKETS - 1u);
+
+  // Sort the block by digit, one stable split per bit.
+  for (uint bit = 0u; bit < RADIX_SORT_DIGIT_BITS; ++bit) {
+    const uint is_zero = 1u - ((digit >> bit) & 1u);
+
+    uint num_zeros;
+    const uint zeros_before = GroupExclusiveScan(is_zero, num_zeros);
+    const uint dst = (is_zero != 0u) ? zeros_before
+                                     : num_zeros + (lid - zeros_before);
+
+    s_keys[dst]    = key;
+    s_indices[dst] = index;
+    s_digits[dst]  = digit;
+    memoryBarrierShared();
+    barrier();
+
+    key   = s_keys[lid];
+    index = s_indices[lid];
+    digit = s_digits[lid];
+    memoryBarrierShared();
+    barrier();
+  }
+
+  // Find where each digit starts in the sorted block (s_digits holds it).
+  if ((lid == 0u) || (s_digits[lid - 1u] != digit)) {
+    s_digit_start[digit] = lid;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  if (index == INVALID_INDEX) {
+    return;
+  }
+
+  const uint rank = lid - s_digit_start[digit];
+  const uint dst = offsets[digit * gl_NumWorkGroups.x + gl_WorkGroupID.x] + rank;
+
+  write_keys[dst]    = key;
+  write_indices[dst] = index;
+}
@@ -0,0 +1,47 @@
+#version 430 core
+
+// ============================================================================
+/*
+ * Move the tail of a ring pool past the particles dead before the first alive
+ * one, once simulated, and write the ring draw commands.
+ *
+ * The simulated particles count is read from the first counter, the ring
+ * particles count is written to the second one, bound as a storage buffer.
+ */
+// ============================================================================
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_ring.glsl"
+
+// ----------------------------------------------------------------------------
+
+// Particles of the ring when simulated, newborns included.
+layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
+uniform atomic_uint read_count;
+
+layout(std430, binding = STORAGE_BINDING_APPEND_COUNTER)
+writeonly buffer AppendCounter {
+  uint write_count;
+};
+
+// ----------------------------------------------------------------------------
+
+layout(local_size_x = 1u) in;
+void main() {
+  const uint num_read = min(atomicCounter(read_count), ring.capacity);
+
+  // Without alive particles the whole ring is released.
+  const uint num_released = min(ring.first_alive, num_read);
+  const uint count = num_read - num_released;
+
+  ring.tail = RingSlot(num_released);
+  ring.first_alive = 0xFFFFFFFFu;
+  write_count = count;
+
+  // Particles from the tail to the end of the pool, then from its start.
+  const uint first_count = min(count, ring.capacity - ring.tail);
+  ring.draws[0] = uvec4(first_count, 1u, ring.tail, 0u);
+  ring.draws[1] = uvec4(count - first_count, 1u, 0u, 0u);
+}
+
+// ----------------------------------------------------------------------------
@@ -1,9 +1,13 @@
 #version 430 core
+#extension GL_KHR_shader_subgroup_ballot : enable
+#extension GL_ARB_shader_ballot : enable
+#extension GL_ARB_gpu_shader_int64 : enable
 
 // ============================================================================
 
 /* Second Stage of the particle system :
- * - Calculate forces (eg. curl noise, vector field, ..),
+ * - Calculate forces (eg. curl noise, vector field, ..), with the parameters
+ *   of the particle system (see TSystem),
  * - Performs time integration,
  * - Handle collision detection,
  * - Update particle position and velocity,
@@ -13,6 +17,17 @@
 
 #include "sparkle/interop.h"
 #include "sparkle/inc_curlnoise.glsl"
+#include "sparkle/inc_random.glsl"
+#include "sparkle/inc_emission.glsl"
+#include "sparkle/inc_append.glsl"
+#include "sparkle/inc_storage.glsl"
+#include "sparkle/inc_grid.glsl"
+#include "sparkle/inc_fluid.glsl"
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -22,116 +37,127 @@ uniform float uTimeStep;
 // Vector field sampler.
 uniform sampler3D uVectorFieldSampler;
 
-// Simulation volume.
-uniform int uBoundingVolume;
-uniform float uBBoxSize;
+// Baked curl noise sampler and its half size.
+uniform sampler3D uCurlNoiseSampler;
+uniform float uCurlNoiseExtent;
 
-uniform float uScatteringFactor;
-uniform float uVectorFieldFactor;
-uniform float uCurlNoiseFactor;
+// Curl noise field, shared by every system.
 uniform float uCurlNoiseScale;
-uniform float uVelocityFactor;
+uniform int uCurlNoiseMethod;
+
+// Distance under which particles repel each other, at most a grid cell.
+uniform float uRepulsionRadius;
+
+// Downward acceleration of the fluid particles.
+uniform float uFluidGravity;
 
-uniform bool uEnableScattering;
-uniform bool uEnableVectorField;
-uniform bool uEnableCurlNoise;
-uniform bool uEnableVelocityControl;
+// Record the read position of each written particle, for the coherent sort.
+uniform bool uWritePreviousRanks;
+
+// Fused pipeline : the emitted particles are created past the read ones
+// (capped by the pool size) and the view depths are written for sorting,
+// replacing the emission and calculate_dp kernels.
+uniform uint uMaxParticleCount;
+uniform bool uWriteDepthKeys;
+uniform mat4 uViewMatrix;
 
 // ----------------------------------------------------------------------------
 
+// Particles to simulate, the host resets it once the kernel is done.
 layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
 uniform atomic_uint read_count;
 
-layout(binding = ATOMIC_COUNTER_BINDING_SECOND)
-uniform atomic_uint write_count;
-
 // ----------------------------------------------------------------------------
 
-#if SPARKLE_USE_SOA_LAYOUT
+// Particles are read from A and written to B, or updated in place in A with
+// the free list and ring pools (see inc_free_list and inc_ring).
 
-// READ
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_A)
-readonly buffer PositionBufferA {
-  vec4 read_positions[];
-};
-layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_A)
-readonly buffer VelocityBufferA {
-  vec4 read_velocities[];
-};
-layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A)
-readonly buffer AttributeBufferA {
-  vec4 read_attributes[];
+layout(std430, binding = STORAGE_BINDING_SYSTEMS)
+readonly buffer SystemBuffer {
+  TSystem systems[];
 };
 
-// WRITE
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_B)
-writeonly buffer PositionBufferB {
-  vec4 write_positions[];
+layout(std430, binding = STORAGE_BINDING_PREVIOUS_RANKS)
+writeonly buffer PreviousRanks {
+  uint previous_ranks[];
 };
-layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_B)
-writeonly buffer VelocityBufferB {
-  vec4 write_velocities[];
-};
-layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_B)
-writeonly buffer AttributeBufferB {
-  vec4 write_attributes[];
+
+layout(std430, binding = STORAGE_BINDING_DOT_PRODUCTS)
+writeonly buffer DotProducts {
+  float dp[];
 };
 
+// ----------------------------------------------------------------------------
+
+TParticle PopParticle(out uint slot) {
+  const uint index = gl_GlobalInvocationID.x;
+#if SPARKLE_USE_FREE_LIST
+  slot = alive_indices_a[index];
+#elif SPARKLE_USE_RING
+  slot = RingSlot(index);
 #else
+  slot = index;
+#endif
+  return LoadParticleA(slot);
+}
 
-// READ
-layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
-readonly buffer ParticleBufferA {
-  TParticle read_particles[];
-};
+#if SPARKLE_USE_RING
 
-// WRITE
-layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
-writeonly buffer ParticleBufferB {
-  TParticle write_particles[];
-};
+shared uint s_first_alive;
 
-#endif  // SPARKLE_USE_SOA_LAYOUT
+void PushParticle(in TParticle p, in bool alive, in uint slot) {
+  // The particle keeps its slot, and nothing is appended : the group only
+  // reports its first alive particle, for the tail to move past the dead
+  // ones before it (see cs_ring_advance).
+  const uint lid = gl_LocalInvocationID.x;
 
-layout(std430, binding = STORAGE_BINDING_RANDOM_VALUES)
-readonly buffer RandomBuffer {
-  float randbuffer[];
-};
+  if (lid == 0u) {
+    s_first_alive = 0xFFFFFFFFu;
+  }
+  barrier();
 
-// ----------------------------------------------------------------------------
+  if (alive) {
+    StoreParticleA(slot, p);
+    atomicMin(s_first_alive, gl_GlobalInvocationID.x);
+  }
+  barrier();
 
-TParticle PopParticle() {
-  const uint index = gl_GlobalInvocationID.x;
-  atomicCounterDecrement(read_count);
+  if ((lid == 0u) && (s_first_alive != 0xFFFFFFFFu)) {
+    atomicMin(ring.first_alive, s_first_alive);
+  }
+}
 
-  TParticle p;
+#else
 
-#if SPARKLE_USE_SOA_LAYOUT
-  p.position   = read_positions[index];
-  p.velocity   = read_velocities[index];
-  vec4 attribs = read_attributes[index];
+void PushParticle(in TParticle p, in bool alive, in uint slot) {
+  // Written particles never outnumber the read ones, no cap is needed.
+  const uint index = GroupAppend(alive, 0xFFFFFFFFu);
 
-  p.start_age  = attribs.x;
-  p.age        = attribs.y;
-  p.id         = floatBitsToUint(attribs.w);
+  if (!alive) {
+    return;
+  }
+
+#if SPARKLE_USE_FREE_LIST
+  // The particle keeps its slot, only its index moves to the next list.
+  StoreParticleA(slot, p);
+  alive_indices_b[index] = slot;
 #else
-  p = read_particles[index];
+  StoreParticleB(index, p);
 #endif
 
-  return p;
-}
+  // Particles are read in the previous frame sorted order.
+  if (uWritePreviousRanks) {
+    previous_ranks[index] = gl_GlobalInvocationID.x;
+  }
 
-void PushParticle(in TParticle p) {
-  const uint index = atomicCounterIncrement(write_count);
+  // Distance of the particle from the camera, as cs_calculate_dp.
+  if (uWriteDepthKeys) {
+    const vec4 positionVS = uViewMatrix * vec4(p.position.xyz, 1.0f);
+    dp[index] = dot(vec3(0.0f, 0.0f, -1.0f), positionVS.xyz);
+  }
+}
 
-#if SPARKLE_USE_SOA_LAYOUT
-  write_positions[index]  = p.position;
-  write_velocities[index] = p.velocity;
-  write_attributes[index] = vec4(p.start_age, p.age, 0.0f, uintBitsToFloat(p.id));
-#else
-  write_particles[index] = p;
 #endif
-}
 
 // ----------------------------------------------------------------------------
 
@@ -152,36 +178,66 @@ void UpdateParticle(inout TParticle p,
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateScattering() {
-  if (!uEnableScattering) {
+bool HasFlag(in const TSystem system, in uint flag) {
+  return (system.flags & flag) != 0u;
+}
+
+// ----------------------------------------------------------------------------
+
+vec3 CalculateScattering(in const TSystem system) {
+  if (!HasFlag(system, SYSTEM_FLAG_SCATTERING)) {
     return vec3(0.0f);
   }
   const uint gid = gl_GlobalInvocationID.x;
-  vec3 randforce = vec3(randbuffer[gid], randbuffer[gid+1u], randbuffer[gid+2u]);
+  vec3 randforce = random4(gid, RANDOM_STREAM_SCATTERING).xyz;
        randforce = 2.0f * randforce - 1.0f;
-  return uScatteringFactor * randforce;
+  return system.scattering_factor * randforce;
 }
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateRepulsion(in const TParticle p) {
-  vec3 push = vec3(0.0f);
+vec3 CalculateRepulsion(in const TParticle p, in const TSystem system) {
+  if (!HasFlag(system, SYSTEM_FLAG_REPULSION)) {
+    return vec3(0.0f);
+  }
 
-  /*
-  // IDEA
-  const vec3 vel = p.velocity.xyz;
+  // Neighbours closer than the radius push the particle away, linearly with
+  // their proximity. The grid was built from the particles as read, the
+  // particle itself is found there by its read index.
+  const uint self = gl_GlobalInvocationID.x;
   const vec3 pos = p.position.xyz;
-  const float MAX_INFLUENCE_DISTANCE = 8.0f;
-
-  vec3 n;
-  float d = compute_gradient(pos, n);
-  float coeff = smoothstep(0.0f, MAX_INFLUENCE_DISTANCE, abs(d));
-  push = coeff * (n);
-  //vec3 side = cross(cross(n, normalize(vel + vec3(1e-5))), n);
-  //push = mix(push, side, coeff*coeff);
-  */
+  const float radius_squared = uRepulsionRadius * uRepulsionRadius;
+  vec3 push = vec3(0.0f);
+
+  const ivec3 cell = GridCellCoords(pos);
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      const uvec2 range = GridRowRange(cell, dy, dz);
+      for (uint i = range.x; i < range.y; ++i) {
+        const uvec4 neighbour = grid_particles[i];
+        const vec3 d = pos - GridParticlePosition(neighbour);
+        const float d2 = dot(d, d);
+
+        if ((d2 < radius_squared) && (d2 > 0.0f) && (GridParticleIndex(neighbour) != self)) {
+          const float inv_dist = inversesqrt(d2);
+          push += (1.0f - d2 * inv_dist / uRepulsionRadius) * inv_dist * d;
+        }
+      }
+    }
+  }
 
-  return push;
+  return system.repulsion_factor * push;
+}
+
+// ----------------------------------------------------------------------------
+
+vec3 CalculateFluid(in const TParticle p, in const TSystem system) {
+  if (!HasFlag(system, SYSTEM_FLAG_FLUID)) {
+    return vec3(0.0f);
+  }
+  // The grid densities were computed before the simulation (cs_fluid_density).
+  const vec3 acceleration = FluidAcceleration(p.position.xyz, p.velocity.xyz, gl_GlobalInvocationID.x);
+  return acceleration - vec3(0.0f, uFluidGravity, 0.0f);
 }
 
 // ----------------------------------------------------------------------------
@@ -206,8 +262,8 @@ vec3 CalculateTargetMesh(in const TParticle p) {
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateVectorField(in const TParticle p) {
-  if (!uEnableVectorField) {
+vec3 CalculateVectorField(in const TParticle p, in const TSystem system) {
+  if (!HasFlag(system, SYSTEM_FLAG_VECTORFIELD)) {
     return vec3(0.0f);
   }
 
@@ -215,37 +271,46 @@ vec3 CalculateVectorField(in const TParticle p) {
   const vec3 texcoord = (p.position.xyz + extent) / (2.0f * extent);
   vec3 vfield = texture(uVectorFieldSampler, texcoord).xyz;
 
-  return uVectorFieldFactor * vfield;
+  return system.vectorfield_factor * vfield;
 }
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateCurlNoise(in const TParticle p) {
-  if (!uEnableCurlNoise) {
+vec3 CalculateCurlNoise(in const TParticle p, in const TSystem system) {
+  if (!HasFlag(system, SYSTEM_FLAG_CURLNOISE)) {
     return vec3(0.0f);
   }
-  vec3 curl_velocity = compute_curl(p.position.xyz * uCurlNoiseScale);
-  return uCurlNoiseFactor * curl_velocity;
+  vec3 curl_velocity;
+  if (uCurlNoiseMethod == 2) {
+    const vec3 texcoord = 0.5f * (p.position.xyz / uCurlNoiseExtent + 1.0f);
+    curl_velocity = texture(uCurlNoiseSampler, texcoord).xyz;
+  } else {
+    const vec3 pos = p.position.xyz * uCurlNoiseScale;
+    curl_velocity = (uCurlNoiseMethod == 0) ? compute_curl_analytic(pos)
+                                            : compute_curl(pos);
+  }
+  return system.curlnoise_factor * curl_velocity;
 }
 
 
 // ----------------------------------------------------------------------------
 
-vec3 CalculateForces(in const TParticle p) {
+vec3 CalculateForces(in const TParticle p, in const TSystem system) {
   vec3 force = vec3(0.0f);
 
-  force += CalculateScattering();
-  force += CalculateRepulsion(p);
+  force += CalculateScattering(system);
+  force += CalculateRepulsion(p, system);
+  force += CalculateFluid(p, system);
   force += CalculateTargetMesh(p);
-  force += CalculateVectorField(p);
-  force += CalculateCurlNoise(p);
+  force += CalculateVectorField(p, system);
+  force += CalculateCurlNoise(p, system);
 
   return force;
 }
 
 // ----------------------------------------------------------------------------
 
-void CollideSphere(float r, in vec3 center, inout vec3 pos, inout vec3 vel) {
+bool CollideSphere(float r, in vec3 center, inout vec3 pos, inout vec3 vel) {
   const vec3 p = pos - center;
 
   const float dp = dot(p, p);
@@ -256,11 +321,14 @@ void CollideSphere(float r, in vec3 center, inout vec3 pos, inout vec3 vel) {
     vel = reflect(vel, n);
 
     pos = center - r*n;
+    return true;
   }
+  return false;
 }
 
-void CollideBox(in vec3 corner, in vec3 center, inout vec3 pos, inout vec3 vel) {
+bool CollideBox(in vec3 corner, in vec3 center, inout vec3 pos, inout vec3 vel) {
   vec3 p = pos - center;
+  const bool collided = any(greaterThan(abs(p), corner));
 
   if (p.x < -corner.x) {
     p.x = -corner.x;
@@ -293,51 +361,97 @@ void CollideBox(in vec3 corner, in vec3 center, inout vec3 pos, inout vec3 vel)
   }
 
   pos = p + center;
+  return collided;
 }
 
-void CollisionHandling(inout vec3 pos, inout vec3 vel) {
-  const float r = 0.5f * uBBoxSize;
+// Return true when the particle bounced on its system volume.
+bool CollisionHandling(in const TSystem system, inout vec3 pos, inout vec3 vel) {
+  const float r = 0.5f * system.bbox_size;
 
-  if (uBoundingVolume == 0) CollideSphere(r, vec3(0.0f), pos, vel);
+  if (system.bounding_volume == 0) return CollideSphere(r, vec3(0.0f), pos, vel);
   else
-  if (uBoundingVolume == 1) CollideBox(vec3(r), vec3(0.0f), pos, vel);
+  if (system.bounding_volume == 1) return CollideBox(vec3(r), vec3(0.0f), pos, vel);
+  return false;
 }
 
 // ----------------------------------------------------------------------------
 
 layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
 void main() {
-  // Local copy of the particle.
-  TParticle p = PopParticle();
+  const uint gid = gl_GlobalInvocationID.x;
+  const uint num_read = atomicCounter(read_count);
+  const uint num_emitted = min(GetEmitCount(), uMaxParticleCount - min(num_read, uMaxParticleCount));
+
+  // Local copy of the particle, read or newly emitted. The last group goes
+  // past the particles count.
+  TParticle p;
+  uint slot = gid;
+  bool valid = false;
+  bool alive = false;
+
+  if (gid < num_read) {
+    p = PopParticle(slot);
+#if SPARKLE_USE_RING
+    // Masked particles are left as they are.
+    valid = (p.age > 0.0f);
+#else
+    valid = true;
+#endif
+  } else if (gid - num_read < num_emitted) {
+    p = CreateParticle(gid - num_read);
+    p.id = gid;
+    valid = true;
+  }
 
-  float age = GetUpdatedAge(p);
+  if (valid) {
+    const float age = GetUpdatedAge(p);
+    alive = (age > 0.0f);
 
-  if (age > 0.0f) {
-    // Calculate external forces.
-    vec3 force = CalculateForces(p);
+    if (alive) {
+      const TSystem system = systems[p.system];
 
-    // Integrations vectors.
-    const vec3 dt = vec3(uTimeStep);
-    vec3 velocity = p.velocity.xyz;
-    vec3 position = p.position.xyz;
+      // Calculate external forces.
+      vec3 force = CalculateForces(p, system);
 
-    // Integrate velocity.
-    velocity = fma(force, dt, velocity);
+      // Integrations vectors.
+      const vec3 dt = vec3(uTimeStep);
+      vec3 velocity = p.velocity.xyz;
+      vec3 position = p.position.xyz;
 
-    if (uEnableVelocityControl) {
-      velocity = uVelocityFactor * normalize(velocity);
-    }
+      // Integrate velocity.
+      velocity = fma(force, dt, velocity);
 
-    // Integrate position.
-    position = fma(velocity, dt, position);
+      if (HasFlag(system, SYSTEM_FLAG_VELOCITY_CONTROL)) {
+        velocity = system.velocity_factor * normalize(velocity);
+      }
 
-    // Handle collisions.
-    CollisionHandling(position, velocity);
+      // Integrate position.
+      position = fma(velocity, dt, position);
 
-    // Update the particle.
-    UpdateParticle(p, position, velocity, age);
+      // Handle collisions.
+      const bool collided = CollisionHandling(system, position, velocity);
+
+      // Update the particle. The position w is the rewind weight used for
+      // rendering between steps : a bounced particle can't be moved back
+      // along its reflected velocity, it is shown at its last position.
+      UpdateParticle(p, position, velocity, age);
+      p.position.w = collided ? 0.0f : 1.0f;
+    }
+  }
 
-    // Save it in buffer.
-    PushParticle(p);
+#if SPARKLE_USE_FREE_LIST
+  // The slots of dead particles are reused by the next emissions.
+  if (valid && !alive) {
+    PushFreeSlot(slot, num_read, uMaxParticleCount);
+  }
+#elif SPARKLE_USE_RING
+  // Particles dying out of order are masked in place, until the tail passes them.
+  if (valid && !alive) {
+    p.age = 0.0f;
+    StoreParticleA(slot, p);
   }
+#endif
+
+  // Save it in buffer, reached by every invocation as the append is group-wide.
+  PushParticle(p, alive, slot);
 }
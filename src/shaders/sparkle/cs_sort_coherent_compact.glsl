@@ -0,0 +1,49 @@
+#version 430 core
+
+/*
+ * Coherent sort, second stage : compact the alive ranks, giving the previous
+ * frame order of the survivors followed by the emitted particles.
+ *
+ * Run on uNumElements + 1 invocations, the offsets being the exclusive prefix
+ * sum of the rank flags.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_coherent_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_RANK_SLOTS)
+readonly buffer RankSlots {
+  uint rank_slots[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_OFFSETS)
+readonly buffer RankOffsets {
+  uint offsets[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_SECOND)
+writeonly buffer WriteIndices {
+  uint write_indices[];
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint rank = gl_GlobalInvocationID.x;
+
+  if (rank > uNumElements) {
+    return;
+  }
+
+  // Ranks past the previous sorted count belong to emitted particles.
+  if (rank == min(state.sorted_count, uNumElements)) {
+    state.num_survivors = offsets[rank];
+  }
+
+  if ((rank < uNumElements) && (offsets[rank + 1u] != offsets[rank])) {
+    write_indices[offsets[rank]] = rank_slots[rank];
+  }
+}
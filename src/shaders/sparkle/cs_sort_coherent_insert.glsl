@@ -0,0 +1,61 @@
+#version 430 core
+
+/*
+ * Coherent sort, third stage : find where each emitted particle goes among
+ * the survivors, assumed sorted, and count the insertions per position.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_coherent_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_DOT_PRODUCTS)
+readonly buffer DotProducts {
+  float dp[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+readonly buffer ReadIndices {
+  uint read_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_OFFSETS)
+buffer InsertionCounts {
+  uint insertion_counts[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_INSERTIONS)
+writeonly buffer Insertions {
+  uvec2 insertions[];
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+  const uint num_survivors = state.num_survivors;
+
+  if ((tid < num_survivors) || (tid >= atomicCounter(write_count))) {
+    return;
+  }
+
+  const float key = dp[read_indices[tid]];
+
+  // Number of survivors placed before the particle (the farther ones).
+  uint first = 0u;
+  uint last = num_survivors;
+  while (first < last) {
+    const uint mid = (first + last) / 2u;
+    if (dp[read_indices[mid]] >= key) {
+      first = mid + 1u;
+    } else {
+      last = mid;
+    }
+  }
+
+  // Particles inserted at the same position are ordered arbitrarily.
+  const uint slot = atomicAdd(insertion_counts[first], 1u);
+  insertions[tid - num_survivors] = uvec2(first, slot);
+}
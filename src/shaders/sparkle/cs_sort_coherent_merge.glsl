@@ -0,0 +1,57 @@
+#version 430 core
+
+/*
+ * Coherent sort, fourth stage : merge the emitted particles into the
+ * survivors, the offsets being the exclusive prefix sum of the insertion
+ * counts.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_coherent_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+readonly buffer ReadIndices {
+  uint read_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_SECOND)
+writeonly buffer WriteIndices {
+  uint write_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_OFFSETS)
+readonly buffer InsertionOffsets {
+  uint offsets[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_INSERTIONS)
+readonly buffer Insertions {
+  uvec2 insertions[];
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+  const uint num_survivors = state.num_survivors;
+  const uint num_particles = atomicCounter(write_count);
+
+  if (tid >= uNumElements) {
+    return;
+  }
+
+  if (tid < num_survivors) {
+    // Shifted by the particles inserted up to its position.
+    write_indices[tid + offsets[tid + 1u]] = read_indices[tid];
+  } else if (tid < num_particles) {
+    const uvec2 insertion = insertions[tid - num_survivors];
+    const uint position = insertion.x;
+    write_indices[position + offsets[position] + insertion.y] = read_indices[tid];
+  } else {
+    // Slots past the simulated particles are not drawn, keep them in range.
+    write_indices[tid] = tid;
+  }
+}
@@ -0,0 +1,62 @@
+#version 430 core
+
+/*
+ * Coherent sort, refinement pass : sort blocks of the nearly sorted indices
+ * in shared memory, in place.
+ *
+ * Passes alternate blocks offset by half their width, so that particles
+ * can cross block boundaries.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_bitonic_sort.glsl"
+#include "sparkle/inc_coherent_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+buffer Indices {
+  uint indices[];
+};
+
+uniform uint uBlockOffset;
+
+//-----------------------------------------------------------------------------
+
+// Out of range elements are sorted last and never written back.
+#define PADDING_DEPTH   (-3.402823466e+38f)
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint lid = gl_LocalInvocationID.x;
+  const uint block_offset = uBlockOffset + gl_WorkGroupID.x * SORT_LOCAL_BLOCK_WIDTH;
+  const uint num_particles = atomicCounter(write_count);
+
+  if (block_offset >= num_particles) {
+    return;
+  }
+
+  // Load two elements per invocation.
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    const uint id = block_offset + i;
+    const uint index = (id < num_particles) ? indices[id] : 0u;
+    s_indices[i] = index;
+    s_dp[i] = (id < num_particles) ? dp[index] : PADDING_DEPTH;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  // Full sort of the block, every block in the same order.
+  for (uint max_block_width = 2u; max_block_width <= SORT_LOCAL_BLOCK_WIDTH; max_block_width <<= 1u) {
+    for (uint block_width = max_block_width; block_width >= 2u; block_width >>= 1u) {
+      LocalSortStage(block_width, max_block_width, 0u);
+    }
+  }
+
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    const uint id = block_offset + i;
+    if (id < num_particles) {
+      indices[id] = s_indices[i];
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#version 430 core
+
+/*
+ * Coherent sort, first stage : map the previous frame ranks to the
+ * particles holding them, and flag the ranks still alive.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_coherent_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_PREVIOUS_RANKS)
+readonly buffer PreviousRanks {
+  uint previous_ranks[];
+};
+
+layout(std430, binding = STORAGE_BINDING_RANK_SLOTS)
+writeonly buffer RankSlots {
+  uint rank_slots[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_OFFSETS)
+writeonly buffer RankFlags {
+  uint rank_flags[];
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid >= atomicCounter(write_count)) {
+    return;
+  }
+
+  const uint rank = previous_ranks[tid];
+  rank_slots[rank] = tid;
+  rank_flags[rank] = 1u;
+}
@@ -0,0 +1,44 @@
+#version 430 core
+
+/*
+ * Count the adjacent pairs of sorted indices in the wrong order, used to
+ * measure the quality of the approximate sorting engines.
+*/
+
+#include "sparkle/interop.h"
+
+//-----------------------------------------------------------------------------
+
+layout(binding = ATOMIC_COUNTER_BINDING_SECOND)
+uniform atomic_uint write_count;
+
+layout(std430, binding = STORAGE_BINDING_DOT_PRODUCTS)
+readonly buffer DotProducts {
+  float dp[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+readonly buffer ReadIndices {
+  uint read_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_SORT_STATE)
+coherent buffer SortState {
+  TSortState state;
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint tid = gl_GlobalInvocationID.x;
+
+  if (tid + 1u >= atomicCounter(write_count)) {
+    return;
+  }
+
+  // Farther particles come first.
+  if (dp[read_indices[tid + 1u]] > dp[read_indices[tid]]) {
+    atomicAdd(state.out_of_order, 1u);
+  }
+}
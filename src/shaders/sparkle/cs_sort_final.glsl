@@ -19,59 +19,28 @@
 
 #include "sparkle/interop.h"
 
-#if SPARKLE_USE_SOA_LAYOUT
-
-// READ BUFFERs
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_B)
-readonly buffer PositionBufferB {
-  vec4 read_positions[];
-};
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_B)
-readonly buffer VelocityBufferB {
-  vec4 read_velocities[];
-};
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_B)
-readonly buffer AttributeBufferB {
-  vec4 read_attributes[];
-};
-
-// WRITE BUFFERs
-
-layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_A)
-writeonly buffer PositionBufferA {
-  vec4 write_positions[];
-};
-layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_A)
-writeonly buffer VelocityBufferA {
-  vec4 write_velocities[];
-};
-layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A)
-writeonly buffer AttributeBufferA {
-  vec4 write_attributes[];
-};
-
+// Particles are gathered from B to A, as stored. With the free list pool
+// only their indices are, from the B alive list to the A one, and with the
+// ring pool their slots are listed in order.
+#if SPARKLE_USE_FREE_LIST
+#include "sparkle/inc_free_list.glsl"
+#elif SPARKLE_USE_RING
+#include "sparkle/inc_ring.glsl"
 #else
-
-layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
-readonly buffer ParticleBufferB {
-  TParticle read_particles[];
-};
-
-layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
-writeonly buffer ParticleBufferA {
-  TParticle write_particles[];
-};
-
-#endif  // SPARKLE_USE_SOA_LAYOUT
+#include "sparkle/inc_storage.glsl"
+#endif
 
 layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
 readonly buffer IndexBuffer {
   uint indices[];
 };
 
+#if SPARKLE_USE_RING
+// Particles of the ring, the sorted indices past them are not listed.
+layout(binding = ATOMIC_COUNTER_BINDING_SECOND)
+uniform atomic_uint write_count;
+#endif
+
 // ----------------------------------------------------------------------------
 
 layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
@@ -80,12 +49,18 @@ void main() {
 
   uint read_id = indices[tid];
 
-#if SPARKLE_USE_SOA_LAYOUT
-  write_positions[tid]  = read_positions[read_id];
-  write_velocities[tid] = read_velocities[read_id];
-  write_attributes[tid] = read_attributes[read_id];
+#if SPARKLE_USE_FREE_LIST
+  alive_indices_a[tid] = alive_indices_b[read_id];
+#elif SPARKLE_USE_RING
+  // Masked particles are sorted before the keys past the ring, which keeps
+  // the ranks of the ring slots unique.
+  if (tid < atomicCounter(write_count)) {
+    const uint slot = RingSlot(read_id);
+    sorted_slots[tid] = slot;
+    slot_ranks[slot] = tid;
+  }
 #else
-  write_particles[tid] = read_particles[read_id];
+  CopyParticleBToA(read_id, tid);
 #endif
 }
 
@@ -0,0 +1,45 @@
+#version 430 core
+
+/* First steps of the bitonic sort, run in shared memory.
+ *
+ * Each group sorts its block of SORT_LOCAL_BLOCK_WIDTH particles with every
+ * steps whose width fits in it, in a single dispatch. Indices are generated
+ * here, so no initialization pass is needed.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_bitonic_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_INDICES_SECOND)
+writeonly buffer WriteIndices {
+  uint write_indices[];
+};
+
+//-----------------------------------------------------------------------------
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint lid = gl_LocalInvocationID.x;
+  const uint block_offset = gl_WorkGroupID.x * SORT_LOCAL_BLOCK_WIDTH;
+
+  // Load two elements per invocation.
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    const uint index = block_offset + i;
+    s_indices[i] = index;
+    s_dp[i] = dp[index];
+  }
+  memoryBarrierShared();
+  barrier();
+
+  for (uint max_block_width = 2u; max_block_width <= SORT_LOCAL_BLOCK_WIDTH; max_block_width <<= 1u) {
+    for (uint block_width = max_block_width; block_width >= 2u; block_width >>= 1u) {
+      LocalSortStage(block_width, max_block_width, block_offset);
+    }
+  }
+
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    write_indices[block_offset + i] = s_indices[i];
+  }
+}
@@ -0,0 +1,49 @@
+#version 430 core
+
+/* Last stages of a bitonic sort step, run in shared memory.
+ *
+ * Once the pairs distance of a step fits in a group block, its remaining
+ * stages only exchange elements inside the block and run in one dispatch.
+*/
+
+#include "sparkle/interop.h"
+#include "sparkle/inc_bitonic_sort.glsl"
+
+//-----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_INDICES_FIRST)
+readonly buffer ReadIndices {
+  uint read_indices[];
+};
+
+layout(std430, binding = STORAGE_BINDING_INDICES_SECOND)
+writeonly buffer WriteIndices {
+  uint write_indices[];
+};
+
+//-----------------------------------------------------------------------------
+
+uniform uint uMaxBlockWidth;
+
+layout(local_size_x = PARTICLES_KERNEL_GROUP_WIDTH) in;
+void main() {
+  const uint lid = gl_LocalInvocationID.x;
+  const uint block_offset = gl_WorkGroupID.x * SORT_LOCAL_BLOCK_WIDTH;
+
+  // Load two elements per invocation.
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    const uint index = read_indices[block_offset + i];
+    s_indices[i] = index;
+    s_dp[i] = dp[index];
+  }
+  memoryBarrierShared();
+  barrier();
+
+  for (uint block_width = SORT_LOCAL_BLOCK_WIDTH; block_width >= 2u; block_width >>= 1u) {
+    LocalSortStage(block_width, uMaxBlockWidth, block_offset);
+  }
+
+  for (uint i = lid; i < SORT_LOCAL_BLOCK_WIDTH; i += PARTICLES_KERNEL_GROUP_WIDTH) {
+    write_indices[block_offset + i] = s_indices[i];
+  }
+}
@@ -11,6 +11,9 @@
 
 #include "sparkle/interop.h"
 
+// Particles emitted by the fused simulation, past the read ones.
+uniform uint uEmitCount;
+
 layout(binding = ATOMIC_COUNTER_BINDING_FIRST)
 uniform atomic_uint read_count;
 
@@ -28,7 +31,7 @@ writeonly buffer IndirectArgs {
 layout(local_size_x = 1u) in;
 void main() {
   const uint num_particles = atomicCounter(read_count);
-  dispatch_x = (num_particles + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
+  dispatch_x = (num_particles + uEmitCount + PARTICLES_KERNEL_GROUP_WIDTH - 1u) / PARTICLES_KERNEL_GROUP_WIDTH;
 
   /// @note
   /// not the real value (one frame of accuracy lost), but way cheaper than using
@@ -22,6 +22,11 @@ out GDataBlock {
 } OUT;
 
 void main() {
+  // Masked particles of the ring pool (see vs_generic).
+  if (IN[0].decay < 0.0f) {
+    return;
+  }
+
   const mat3 view = mat3(uView);
 
   // view space velocity
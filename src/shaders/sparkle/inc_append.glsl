@@ -0,0 +1,124 @@
+#ifndef SHADER_APPEND_GLSL_
+#define SHADER_APPEND_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Group-aggregated append (stream compaction).
+//
+//      Instead of one atomic per appended element, invocations are counted
+//      within their group and the group reserves its output range with a
+//      single atomic. Slots follow the invocations order within a group.
+//
+//      Subgroup ballots are used when the kernel enabled one of the
+//      extensions below, otherwise a shared memory scan :
+//        #extension GL_KHR_shader_subgroup_ballot : enable
+//        #extension GL_ARB_shader_ballot : enable
+//        #extension GL_ARB_gpu_shader_int64 : enable
+//
+// ----------------------------------------------------------------------------
+
+// Atomic counter buffer appended to, bound as a storage buffer to be
+// incremented by any value.
+layout(std430, binding = STORAGE_BINDING_APPEND_COUNTER)
+coherent buffer AppendCounter {
+  uint append_count;
+};
+
+#if defined(GL_KHR_shader_subgroup_ballot)
+# define APPEND_USE_SUBGROUP    1
+#elif defined(GL_ARB_shader_ballot) && defined(GL_ARB_gpu_shader_int64)
+# define APPEND_USE_SUBGROUP    1
+#else
+# define APPEND_USE_SUBGROUP    0
+#endif
+
+#if !APPEND_USE_SUBGROUP
+#include "sparkle/inc_scan.glsl"
+#endif
+
+shared uint s_append_base;
+
+#if APPEND_USE_SUBGROUP
+// Elements appended by each subgroup, then their offsets in the group.
+shared uint s_append_subgroup[PARTICLES_KERNEL_GROUP_WIDTH];
+#endif
+
+// ----------------------------------------------------------------------------
+
+// Reserve the group slots, capping the counter to max_count.
+// Return the group first slot, only valid for its first invocation.
+uint ReserveGroupSlots(in uint total, in uint max_count) {
+  const uint base = (total > 0u) ? atomicAdd(append_count, total) : 0u;
+
+  // Slots past max_count are dropped by the caller.
+  if (base + total > max_count) {
+    atomicMin(append_count, max_count);
+  }
+  return base;
+}
+
+// Return the output slot of invocations whose predicate is true.
+// Must be reached once by every invocation of the group.
+uint GroupAppend(in bool predicate, in uint max_count) {
+  const uint lid = gl_LocalInvocationID.x;
+
+#if APPEND_USE_SUBGROUP
+
+#if defined(GL_KHR_shader_subgroup_ballot)
+  const uvec4 ballot = subgroupBallot(predicate);
+  const uint local_offset = subgroupBallotExclusiveBitCount(ballot);
+  const uint local_count = subgroupBallotBitCount(ballot);
+  const uint subgroup_id = gl_SubgroupID;
+  const uint num_subgroups = gl_NumSubgroups;
+  const bool is_leader = subgroupElect();
+#else
+  // Subgroups are assumed to span consecutive invocations.
+  const uvec2 ballot = unpackUint2x32(ballotARB(predicate));
+  const uvec2 lt_mask = unpackUint2x32(gl_SubGroupLtMaskARB);
+  const uint local_offset = bitCount(ballot.x & lt_mask.x) + bitCount(ballot.y & lt_mask.y);
+  const uint local_count = bitCount(ballot.x) + bitCount(ballot.y);
+  const uint subgroup_id = lid / gl_SubGroupSizeARB;
+  const uint num_subgroups = (PARTICLES_KERNEL_GROUP_WIDTH + gl_SubGroupSizeARB - 1u) / gl_SubGroupSizeARB;
+  const bool is_leader = (gl_SubGroupInvocationARB == 0u);
+#endif
+
+  if (is_leader) {
+    s_append_subgroup[subgroup_id] = local_count;
+  }
+  memoryBarrierShared();
+  barrier();
+
+  // Subgroups are few, scan their counts serially.
+  if (lid == 0u) {
+    uint total = 0u;
+    for (uint i = 0u; i < num_subgroups; ++i) {
+      const uint count = s_append_subgroup[i];
+      s_append_subgroup[i] = total;
+      total += count;
+    }
+    s_append_base = ReserveGroupSlots(total, max_count);
+  }
+  memoryBarrierShared();
+  barrier();
+
+  return s_append_base + s_append_subgroup[subgroup_id] + local_offset;
+
+#else
+
+  uint total;
+  const uint local_offset = GroupExclusiveScan(predicate ? 1u : 0u, total);
+
+  if (lid == 0u) {
+    s_append_base = ReserveGroupSlots(total, max_count);
+  }
+  memoryBarrierShared();
+  barrier();
+
+  return s_append_base + local_offset;
+
+#endif  // APPEND_USE_SUBGROUP
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_APPEND_GLSL_
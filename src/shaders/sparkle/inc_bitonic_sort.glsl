@@ -0,0 +1,56 @@
+#ifndef SHADER_BITONIC_SORT_GLSL_
+#define SHADER_BITONIC_SORT_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Shared memory stages of the bitonic sort.
+//
+//      A group holds SORT_LOCAL_BLOCK_WIDTH indices with their dot products,
+//      each invocation handling one compare-and-swap pair per stage.
+//
+// ----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_DOT_PRODUCTS)
+readonly buffer DotProducts {
+  float dp[];
+};
+
+shared float s_dp[SORT_LOCAL_BLOCK_WIDTH];
+shared uint s_indices[SORT_LOCAL_BLOCK_WIDTH];
+
+// ----------------------------------------------------------------------------
+
+bool cmp(float a, float b) {
+  return a > b;
+}
+
+// Run one stage of the sort on the group block, with the same pairs and
+// orders the global sort step would use for a block starting at block_offset.
+void LocalSortStage(in uint block_width, in uint max_block_width, in uint block_offset) {
+  const uint lid = gl_LocalInvocationID.x;
+  const uint pair_distance = block_width / 2u;
+
+  const uint left_id = (lid / pair_distance) * block_width + (lid % pair_distance);
+  const uint right_id = left_id + pair_distance;
+
+  // The order alternates on global blocks.
+  const uint order = ((block_offset + left_id) / max_block_width) & 1u;
+
+  const float left_dp = s_dp[left_id];
+  const float right_dp = s_dp[right_id];
+  if (bool(order) == cmp(left_dp, right_dp)) {
+    s_dp[left_id]  = right_dp;
+    s_dp[right_id] = left_dp;
+
+    const uint left_index = s_indices[left_id];
+    s_indices[left_id]  = s_indices[right_id];
+    s_indices[right_id] = left_index;
+  }
+
+  memoryBarrierShared();
+  barrier();
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_BITONIC_SORT_GLSL_
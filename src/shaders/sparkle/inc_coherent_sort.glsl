@@ -0,0 +1,28 @@
+#ifndef SHADER_COHERENT_SORT_GLSL_
+#define SHADER_COHERENT_SORT_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Shared declarations of the temporally coherent sort kernels.
+//
+//      The previous frame order is rebuilt from the rank each simulated
+//      particle had in the sorted buffer, emitted particles are then merged
+//      into it and a few local passes fix the particles that moved.
+//
+// ----------------------------------------------------------------------------
+
+// Particles written by the simulation stage.
+layout(binding = ATOMIC_COUNTER_BINDING_SECOND)
+uniform atomic_uint write_count;
+
+layout(std430, binding = STORAGE_BINDING_SORT_STATE)
+coherent buffer SortState {
+  TSortState state;
+};
+
+// Upper bound of the number of particles, known by the host.
+uniform uint uNumElements;
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_COHERENT_SORT_GLSL_
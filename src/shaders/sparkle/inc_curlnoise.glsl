@@ -19,16 +19,26 @@
 
 // ----------------------------------------------------------------------------
 
+// Curl from finite differences over six potential samples.
 vec3 compute_curl(in vec3 p);
+// Curl from the analytic jacobian of a single potential sample.
+vec3 compute_curl_analytic(in vec3 p);
+
 vec3 sample_potential(in vec3 p);
+vec3 sample_potential(in vec3 p, out mat3 jacobian);
 void match_boundary(in float inv_noise_scale, in float d, in vec3 normal, inout vec3 psi);
+void match_boundary(in float inv_noise_scale, in float d, in vec3 normal, inout vec3 psi, inout mat3 jacobian);
 
 // higher order smoothstep.
 float smoothstep_2(float edge0, float edge1, float x);
 // smoothed a value in [-1, 1]
 float ramp(float x);
+// derivative of ramp.
+float dramp(float x);
 // return a vector of noise values.
 vec3 noise3d(in vec3 seed);
+// return a vector of noise values and their gradients (one per column).
+vec3 dnoise3d(in vec3 seed, out mat3 gradients);
 
 // ----------------------------------------------------------------------------
 
@@ -55,6 +65,20 @@ vec3 compute_curl(in vec3 p) {
   return v;
 }
 
+vec3 compute_curl_analytic(in vec3 p) {
+  mat3 jacobian;
+  sample_potential(p, jacobian);
+
+  // jacobian[i] is the gradient of the i-th potential component,
+  // signs match the finite differences version.
+  vec3 v;
+  v.x = jacobian[1].z - jacobian[2].y;
+  v.y = jacobian[2].x - jacobian[0].z;
+  v.z = jacobian[0].y - jacobian[1].x;
+
+  return v;
+}
+
 // [ User customized sampling function ]
 vec3 sample_potential(in vec3 p) {
   const uint num_octaves = 4u;
@@ -118,12 +142,60 @@ vec3 sample_potential(in vec3 p) {
   return psi;
 }
 
+// Same as sample_potential(p) but also returns the potential jacobian,
+// it must be kept in sync with it.
+vec3 sample_potential(in vec3 p, out mat3 jacobian) {
+  const uint num_octaves = 4u;
+
+  // Potential
+  vec3 psi = vec3(0.0f);
+  jacobian = mat3(0.0f);
+
+  // Compute normal and retrieve distance from colliders.
+  vec3 normal;
+  float distance = compute_gradient(p, normal);
+
+  // Add turbulence octaves that respects boundaries.
+  float noise_gain = 1.0f;
+  for(uint i=0u; i < num_octaves; ++i, noise_gain *= 0.5f) {
+    const float inv_noise_scale = 1.0f / noise_gain;
+
+    vec3 s = p * inv_noise_scale;
+    mat3 dn;
+    vec3 n = dnoise3d(s, dn);
+
+    match_boundary(inv_noise_scale, distance, normal, psi, jacobian);
+    psi += noise_gain * n;
+
+    // Chain rule on s gives a factor inv_noise_scale, cancelling noise_gain.
+    jacobian += dn;
+  }
+
+  return psi;
+}
+
 void match_boundary(in float inv_noise_scale, in float d, in vec3 normal, inout vec3 psi) {
    float alpha = ramp(abs(d) * inv_noise_scale);
    float dp = dot(psi, normal);
    psi = mix(dp * normal, psi, alpha);
 }
 
+// The normal is considered locally constant (exact for planar colliders).
+void match_boundary(in float inv_noise_scale, in float d, in vec3 normal, inout vec3 psi, inout mat3 jacobian) {
+   float x = abs(d) * inv_noise_scale;
+   float alpha = ramp(x);
+   vec3 dalpha = (dramp(x) * inv_noise_scale * sign(d)) * normal;
+
+   float dp = dot(psi, normal);
+   vec3 ddp = jacobian * normal;
+   vec3 tangent = psi - dp * normal;
+
+   for (int i = 0; i < 3; ++i) {
+     jacobian[i] = mix(normal[i] * ddp, jacobian[i], alpha) + tangent[i] * dalpha;
+   }
+   psi = mix(dp * normal, psi, alpha);
+}
+
 // ----------------------------------------------------------------------------
 
 float smoothstep_2(float edge0, float edge1, float x) {
@@ -135,6 +207,11 @@ float ramp(float x) {
   return smoothstep_2(-1.0f, 1.0f, x) * 2.0f - 1.0f;
 }
 
+float dramp(float x) {
+  float t = clamp(0.5f * (x + 1.0f), 0.0f, 1.0f);
+  return 30.0f * t * t * (1.0f - t) * (1.0f - t);
+}
+
 vec3 noise3d(in vec3 seed) {
   return vec3(
     pnoise(seed),
@@ -143,6 +220,15 @@ vec3 noise3d(in vec3 seed) {
   );
 }
 
+vec3 dnoise3d(in vec3 seed, out mat3 gradients) {
+  vec4 n0 = dpnoise(seed);
+  vec4 n1 = dpnoise(seed + vec3(31.416f, -47.853f, 12.793f));
+  vec4 n2 = dpnoise(seed + vec3(-233.145f, -113.408f, -185.31f));
+
+  gradients = mat3(n0.yzw, n1.yzw, n2.yzw);
+  return vec3(n0.x, n1.x, n2.x);
+}
+
 // ----------------------------------------------------------------------------
 
 #endif  // SHADER_CURLNOISE_GLSL_
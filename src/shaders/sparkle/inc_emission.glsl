@@ -0,0 +1,96 @@
+#ifndef SHADER_EMISSION_GLSL_
+#define SHADER_EMISSION_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Particles creation, shared by the emission and the fused simulation
+//      kernels, from the emitters table. Requires inc_random.
+//
+// ----------------------------------------------------------------------------
+
+#include "sparkle/inc_math.glsl"
+
+// ----------------------------------------------------------------------------
+
+// Particles the host allows to emit this frame, for all emitters.
+uniform uint uEmitCount;
+uniform uint uNumEmitters;
+
+layout(std430, binding = STORAGE_BINDING_EMITTERS)
+readonly buffer EmitterBuffer {
+  TEmitter emitters[];
+};
+
+// Exclusive scan of the emitters counts, the last slot holds their total.
+layout(std430, binding = STORAGE_BINDING_EMITTER_OFFSETS)
+readonly buffer EmitterOffsetBuffer {
+  uint emitter_offsets[];
+};
+
+// ----------------------------------------------------------------------------
+
+// Particles emitted this frame by all emitters.
+uint GetEmitCount() {
+  return (uEmitCount > 0u) ? min(emitter_offsets[uNumEmitters], uEmitCount) : 0u;
+}
+
+// Emitter of the gid-th particle emitted this frame : the last one whose
+// offset is not past gid, which skips the emitters creating no particles.
+uint FindEmitter(const uint gid) {
+  uint first = 0u;
+  uint last = uNumEmitters;
+  while (last - first > 1u) {
+    const uint mid = (first + last) / 2u;
+    if (emitter_offsets[mid] <= gid) {
+      first = mid;
+    } else {
+      last = mid;
+    }
+  }
+  return first;
+}
+
+// Create the gid-th particle emitted this frame.
+TParticle CreateParticle(const uint gid) {
+  const uint emitter_id = FindEmitter(gid);
+  const TEmitter emitter = emitters[emitter_id];
+
+  // Index and count of the particle in its emitter.
+  const uint first = emitter_offsets[emitter_id];
+  const uint count = emitter_offsets[emitter_id + 1u] - first;
+  const uint local_id = gid - first;
+
+  // Random vector.
+  const vec4 rn = random4(gid, RANDOM_STREAM_EMISSION);
+
+  // Position
+  const float radius = emitter.position.w;
+  vec3 pos = emitter.position.xyz;
+  if (emitter.type == 1) {
+    //pos += disk_distribution(radius, rn.xy);
+    pos += disk_even_distribution(radius, local_id, count);
+  } else if (emitter.type == 2) {
+    pos += sphere_distribution(radius, rn.xy);
+  } else if (emitter.type == 3) {
+    pos += ball_distribution(radius, rn.xyz);
+  }
+
+  // Velocity
+  vec3 vel = emitter.direction.xyz;
+
+  // Age
+  const float age = mix(emitter.min_age, emitter.max_age, rn.w);
+
+  TParticle p;
+  p.position = vec4(pos, 1.0f);
+  p.velocity = vec4(vel, 0.0f);
+  p.start_age = age;
+  p.age = age;
+  p.system = emitter.system;
+
+  return p;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_EMISSION_GLSL_
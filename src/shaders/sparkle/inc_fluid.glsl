@@ -0,0 +1,126 @@
+#ifndef SHADER_FLUID_GLSL_
+#define SHADER_FLUID_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Smoothed particle hydrodynamics, from the neighbours in the spatial
+//      grid (see inc_grid), with the kernels of [Müller et al. 2003] :
+//      poly6 for the density, spiky gradient for the pressure and the
+//      viscosity laplacian.
+//
+//      Particles have a unit mass, densities are in particles per unit
+//      volume. The density of each grid particle is computed first
+//      (see cs_fluid_density), with its velocity, in the grid order.
+//
+//      The host reference of the bench mirrors these functions.
+//
+// ----------------------------------------------------------------------------
+
+#include "sparkle/inc_math.glsl"
+
+// Smoothing radius, at most a grid cell.
+uniform float uFluidRadius;
+uniform float uFluidRestDensity;
+uniform float uFluidStiffness;
+uniform float uFluidViscosity;
+
+// Velocity and density of the grid particles, in grid order.
+layout(std430, binding = STORAGE_BINDING_FLUID_STATES)
+buffer FluidStates {
+  vec4 fluid_states[];
+};
+
+// ----------------------------------------------------------------------------
+
+float FluidKernel(in float r2) {
+  const float h2 = uFluidRadius * uFluidRadius;
+  const float x = h2 - r2;
+  return 315.0f / (64.0f * Pi() * pow(uFluidRadius, 9.0f)) * x * x * x;
+}
+
+// Gradient of the spiky kernel, d being the distance vector of length r.
+vec3 FluidKernelGradient(in vec3 d, in float r) {
+  const float x = uFluidRadius - r;
+  return -45.0f / (Pi() * pow(uFluidRadius, 6.0f)) * x * x * (d / r);
+}
+
+float FluidKernelLaplacian(in float r) {
+  return 45.0f / (Pi() * pow(uFluidRadius, 6.0f)) * (uFluidRadius - r);
+}
+
+// Equation of state, without attraction under the rest density.
+float FluidPressure(in float density) {
+  return uFluidStiffness * max(density - uFluidRestDensity, 0.0f);
+}
+
+// ----------------------------------------------------------------------------
+
+// Density at a particle, self being its read index.
+float FluidDensity(in vec3 position, in uint self) {
+  const float h2 = uFluidRadius * uFluidRadius;
+  float density = FluidKernel(0.0f);
+
+  const ivec3 cell = GridCellCoords(position);
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      const uvec2 range = GridRowRange(cell, dy, dz);
+      for (uint i = range.x; i < range.y; ++i) {
+        const uvec4 neighbour = grid_particles[i];
+        const vec3 d = position - GridParticlePosition(neighbour);
+        const float r2 = dot(d, d);
+
+        if ((r2 < h2) && (GridParticleIndex(neighbour) != self)) {
+          density += FluidKernel(r2);
+        }
+      }
+    }
+  }
+
+  return density;
+}
+
+// Pressure and viscosity acceleration of a particle, self being its read
+// index. Its own density is gathered in the same sweep, the pressure term
+// being split as its own pressure times a sum and a sum of the neighbours
+// ones.
+vec3 FluidAcceleration(in vec3 position, in vec3 velocity, in uint self) {
+  const float h2 = uFluidRadius * uFluidRadius;
+  float density = FluidKernel(0.0f);
+  vec3 pressure_sum = vec3(0.0f);
+  vec3 neighbours_pressure_sum = vec3(0.0f);
+  vec3 viscosity_sum = vec3(0.0f);
+
+  const ivec3 cell = GridCellCoords(position);
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      const uvec2 range = GridRowRange(cell, dy, dz);
+      for (uint i = range.x; i < range.y; ++i) {
+        const uvec4 neighbour = grid_particles[i];
+        const vec3 d = position - GridParticlePosition(neighbour);
+        const float r2 = dot(d, d);
+
+        if ((r2 < h2) && (GridParticleIndex(neighbour) != self)) {
+          const vec4 state = fluid_states[i];
+          const float inv_density = 1.0f / state.w;
+          density += FluidKernel(r2);
+
+          // Particles at the same place push each other in no direction.
+          if (r2 > 0.0f) {
+            const float r = sqrt(r2);
+            const vec3 gradient = (0.5f * inv_density) * FluidKernelGradient(d, r);
+            pressure_sum += gradient;
+            neighbours_pressure_sum += FluidPressure(state.w) * gradient;
+            viscosity_sum += (inv_density * FluidKernelLaplacian(r)) * (state.xyz - velocity);
+          }
+        }
+      }
+    }
+  }
+
+  const vec3 pressure = -(FluidPressure(density) * pressure_sum + neighbours_pressure_sum);
+  return (pressure + uFluidViscosity * viscosity_sum) / density;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_FLUID_GLSL_
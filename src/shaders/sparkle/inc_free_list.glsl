@@ -0,0 +1,52 @@
+#ifndef SHADER_FREE_LIST_GLSL_
+#define SHADER_FREE_LIST_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Free list pool : particles stay in their slot of the first storage
+//      buffer, and are listed by index.
+//
+//      The 'A' alive list holds the slots read by the simulation, which
+//      writes the survivors slots to the 'B' one.
+//
+//      Free slots are kept as a stack of (capacity - alive count) entries, so
+//      its top is known from the alive counter : the emission pops the slot of
+//      its i-th particle below it, and the simulation pushes the dead slots
+//      back above the slots popped this frame.
+//
+// ----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_ALIVE_INDICES_FIRST)
+buffer AliveIndicesA {
+  uint alive_indices_a[];
+};
+
+layout(std430, binding = STORAGE_BINDING_ALIVE_INDICES_SECOND)
+buffer AliveIndicesB {
+  uint alive_indices_b[];
+};
+
+// The host resets the pushes counter before each simulation.
+layout(std430, binding = STORAGE_BINDING_FREE_LIST)
+buffer FreeList {
+  uint num_freed;
+  uint free_slots[];
+};
+
+// ----------------------------------------------------------------------------
+
+// Slot of the particle appended at alive_index, the previous ones being
+// alive or already emitted.
+uint PopFreeSlot(in uint alive_index, in uint max_count) {
+  return free_slots[max_count - 1u - alive_index];
+}
+
+// Give back the slot of a dead particle, num_read being the particles
+// simulated this frame.
+void PushFreeSlot(in uint slot, in uint num_read, in uint max_count) {
+  free_slots[max_count - num_read + atomicAdd(num_freed, 1u)] = slot;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_FREE_LIST_GLSL_
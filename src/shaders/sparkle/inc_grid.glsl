@@ -0,0 +1,97 @@
+#ifndef SHADER_GRID_GLSL_
+#define SHADER_GRID_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Spatial grid : uniform cells over the cube of half size uGridExtent,
+//      centered on the origin, with uGridResolution cells per axis. Particles
+//      outside are clamped to the border cells.
+//
+//      The grid particles are sorted by cell (see SpatialGrid), each entry
+//      holding the particle position bits and its read index, and the cells
+//      hold the offset of their first particle, the last offset being the
+//      total. Indices are kept as integers, as small ones would be denormal
+//      floats that drivers may flush to zero.
+//
+//      Cells are ordered along x first, so the three cells of a row around a
+//      particle are contiguous and the 27 neighbour cells are swept as nine
+//      ranges :
+//
+//        const ivec3 cell = GridCellCoords(position);
+//        for (int dz = -1; dz <= 1; ++dz) {
+//          for (int dy = -1; dy <= 1; ++dy) {
+//            const uvec2 range = GridRowRange(cell, dy, dz);
+//            for (uint i = range.x; i < range.y; ++i) {
+//              const uvec4 neighbour = grid_particles[i];
+//              const vec3 d = GridParticlePosition(neighbour) - position;
+//              ...
+//
+//      Particles closer than a cell size are always found. The buffers are
+//      only written by the build kernels.
+//
+// ----------------------------------------------------------------------------
+
+uniform float uGridExtent;
+uniform uint uGridResolution;
+
+layout(std430, binding = STORAGE_BINDING_GRID_CELL_OFFSETS)
+buffer GridCellOffsets {
+  uint grid_cell_offsets[];
+};
+
+layout(std430, binding = STORAGE_BINDING_GRID_PARTICLES)
+buffer GridParticles {
+  uvec4 grid_particles[];
+};
+
+// ----------------------------------------------------------------------------
+
+ivec3 GridCellCoords(in vec3 position) {
+  const float cells_per_unit = float(uGridResolution) / (2.0f * uGridExtent);
+  const ivec3 coords = ivec3(floor((position + uGridExtent) * cells_per_unit));
+  return clamp(coords, ivec3(0), ivec3(int(uGridResolution) - 1));
+}
+
+uint GridCellIndex(in ivec3 coords) {
+  return uint(coords.x) + uGridResolution * (uint(coords.y) + uGridResolution * uint(coords.z));
+}
+
+uint GridNumCells() {
+  return uGridResolution * uGridResolution * uGridResolution;
+}
+
+uint GridParticleCount() {
+  return grid_cell_offsets[GridNumCells()];
+}
+
+// Sorted range of the particles in the cells (x-1, x, x+1) of a neighbour row,
+// empty when the row is outside the grid.
+uvec2 GridRowRange(in ivec3 cell, in int dy, in int dz) {
+  const int last = int(uGridResolution) - 1;
+  const ivec2 yz = cell.yz + ivec2(dy, dz);
+
+  if (any(lessThan(yz, ivec2(0))) || any(greaterThan(yz, ivec2(last)))) {
+    return uvec2(0u);
+  }
+  const uint first_cell = GridCellIndex(ivec3(max(cell.x - 1, 0), yz));
+  const uint last_cell  = GridCellIndex(ivec3(min(cell.x + 1, last), yz));
+
+  return uvec2(grid_cell_offsets[first_cell], grid_cell_offsets[last_cell + 1u]);
+}
+
+uvec4 GridParticleEntry(in vec3 position, in uint index) {
+  return uvec4(floatBitsToUint(position), index);
+}
+
+vec3 GridParticlePosition(in uvec4 entry) {
+  return uintBitsToFloat(entry.xyz);
+}
+
+// Index the particle was read at by the grid build.
+uint GridParticleIndex(in uvec4 entry) {
+  return entry.w;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_GRID_GLSL_
@@ -2,7 +2,7 @@
 #define SHADERS_MATH_GLSL_
 
 float Pi() {
-  return 3.141564f;
+  return 3.141593f;
 }
 
 float TwoPi() {
@@ -0,0 +1,69 @@
+#ifndef SHADER_PACKING_GLSL_
+#define SHADER_PACKING_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Conversion between TParticle and its 16 bytes packed form.
+//
+//      data.x  position.xy   16bit unorm, in the PACKED_POSITION_EXTENT cube
+//      data.y  position.z    16bit unorm   | velocity.x  half float
+//      data.z  velocity.yz   half floats
+//      data.w  start_age     half float    | age / start_age  16bit unorm
+//
+//      Byte offsets match the vertex formats set by GPUParticle for rendering.
+//      The particle id is not stored, it is set to the particle index.
+//      Neither is its system, every packed particle uses the first one, the
+//      host refusing other systems with this layout.
+//
+// ----------------------------------------------------------------------------
+
+// Pack a particle.
+uvec4 PackParticle(in TParticle p);
+
+// Unpack a particle stored at the given index.
+TParticle UnpackParticle(in uvec4 data, in uint index);
+
+// Unpack the position only.
+vec3 UnpackPosition(in uvec4 data);
+
+// ----------------------------------------------------------------------------
+
+uvec4 PackParticle(in TParticle p) {
+  const vec3 position = clamp(0.5f * p.position.xyz / PACKED_POSITION_EXTENT + 0.5f, 0.0f, 1.0f);
+
+  // The age is truncated, so that it decreases on every step even when the
+  // time step is below the quantization.
+  const float age_ratio = (p.start_age > 0.0f) ? clamp(p.age / p.start_age, 0.0f, 1.0f) : 0.0f;
+  const uint age_bits = uint(floor(age_ratio * 65535.0f));
+
+  uvec4 data;
+  data.x = packUnorm2x16(position.xy);
+  data.y = (packUnorm2x16(vec2(position.z, 0.0f)) & 0xFFFFu)
+         | (packHalf2x16(vec2(p.velocity.x, 0.0f)) << 16u);
+  data.z = packHalf2x16(p.velocity.yz);
+  data.w = (packHalf2x16(vec2(p.start_age, 0.0f)) & 0xFFFFu)
+         | (age_bits << 16u);
+  return data;
+}
+
+TParticle UnpackParticle(in uvec4 data, in uint index) {
+  TParticle p;
+
+  p.position  = vec4(UnpackPosition(data), 1.0f);
+  p.velocity  = vec4(unpackHalf2x16(data.y >> 16u).x, unpackHalf2x16(data.z), 0.0f);
+  p.start_age = unpackHalf2x16(data.w).x;
+  p.age       = unpackUnorm2x16(data.w).y * p.start_age;
+  p.system    = 0u;
+  p.id        = index;
+
+  return p;
+}
+
+vec3 UnpackPosition(in uvec4 data) {
+  const vec3 position = vec3(unpackUnorm2x16(data.x), unpackUnorm2x16(data.y).x);
+  return (2.0f * position - 1.0f) * PACKED_POSITION_EXTENT;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_PACKING_GLSL_
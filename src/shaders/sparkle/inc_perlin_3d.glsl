@@ -5,10 +5,20 @@
 
 // ----------------------------------------------------------------------------
 
+// Compute the 8 corners normalized gradients and the fractional part of pt.
+void pnoise_gradients(in  vec3 pt,
+                      in  vec3 scaledTileRes,
+                      out vec3 gradients[8],
+                      out vec3 fpt);
+
 // Classical Perlin Noise 3D
 float pnoise(in vec3 pt, in vec3 scaledTileRes);
 float pnoise(in vec3 pt);
 
+// Derivative Perlin Noise 3D, returns (noise, d/dx, d/dy, d/dz).
+vec4 dpnoise(in vec3 pt, in vec3 scaledTileRes);
+vec4 dpnoise(in vec3 pt);
+
 // Classical Perlin Noise 2D + time
 float pnoise_loop(in vec2 u, float dt);
 
@@ -25,8 +35,11 @@ float fbm_3d(in vec3 ws);
 // ----------------------------------------------------------------------------
 
 
-// Classical Perlin Noise 3D
-float pnoise(in vec3 pt, in vec3 scaledTileRes) {
+// Gradients are ordered as 000, 100, 010, 110, 001, 101, 011, 111.
+void pnoise_gradients(in  vec3 pt,
+                      in  vec3 scaledTileRes,
+                      out vec3 gradients[8],
+                      out vec3 fpt) {
   // Retrieve the integral part (for indexation)
   vec3 ipt0 = floor(pt);
   vec3 ipt1 = ipt0 + vec3(1.0f);
@@ -78,31 +91,38 @@ float pnoise(in vec3 pt, in vec3 scaledTileRes) {
   // 'Fast' normalization
   vec4 dp = vec4(dot(g000, g000), dot(g100, g100), dot(g010, g010), dot(g110, g110));
   vec4 norm = inversesqrt(dp);
-  g000 *= norm.x;
-  g100 *= norm.y;
-  g010 *= norm.z;
-  g110 *= norm.w;
+  gradients[0] = g000 * norm.x;
+  gradients[1] = g100 * norm.y;
+  gradients[2] = g010 * norm.z;
+  gradients[3] = g110 * norm.w;
 
   dp = vec4(dot(g001, g001), dot(g101, g101), dot(g011, g011), dot(g111, g111));
   norm = inversesqrt(dp);
-  g001 *= norm.x;
-  g101 *= norm.y;
-  g011 *= norm.z;
-  g111 *= norm.w;
+  gradients[4] = g001 * norm.x;
+  gradients[5] = g101 * norm.y;
+  gradients[6] = g011 * norm.z;
+  gradients[7] = g111 * norm.w;
 
   // Retrieve the fractional part (for interpolation)
-  vec3 fpt0 = fract(pt);
+  fpt = fract(pt);
+}
+
+// Classical Perlin Noise 3D
+float pnoise(in vec3 pt, in vec3 scaledTileRes) {
+  vec3 g[8];
+  vec3 fpt0;
+  pnoise_gradients(pt, scaledTileRes, g, fpt0);
   vec3 fpt1 = fpt0 - vec3(1.0f);
 
   // Calculate gradient's influence
-  float n000 = dot(g000, fpt0);
-  float n100 = dot(g100, vec3(fpt1.x, fpt0.yz));
-  float n010 = dot(g010, vec3(fpt0.x, fpt1.y, fpt0.z));
-  float n110 = dot(g110, vec3(fpt1.xy, fpt0.z));
-  float n001 = dot(g001, vec3(fpt0.xy, fpt1.z));
-  float n101 = dot(g101, vec3(fpt1.x, fpt0.y, fpt1.z));
-  float n011 = dot(g011, vec3(fpt0.x, fpt1.yz));
-  float n111 = dot(g111, fpt1);
+  float n000 = dot(g[0], fpt0);
+  float n100 = dot(g[1], vec3(fpt1.x, fpt0.yz));
+  float n010 = dot(g[2], vec3(fpt0.x, fpt1.y, fpt0.z));
+  float n110 = dot(g[3], vec3(fpt1.xy, fpt0.z));
+  float n001 = dot(g[4], vec3(fpt0.xy, fpt1.z));
+  float n101 = dot(g[5], vec3(fpt1.x, fpt0.y, fpt1.z));
+  float n011 = dot(g[6], vec3(fpt0.x, fpt1.yz));
+  float n111 = dot(g[7], fpt1);
 
   // Interpolate gradients
   vec3 u = fade(fpt0);
@@ -117,6 +137,63 @@ float pnoise(in vec3 pt) {
   return pnoise(pt, vec3(0.0f));
 }
 
+// Derivative Perlin Noise 3D
+// The noise is expanded as a trilinear polynomial in the fade weights u, its
+// derivative is the interpolated corners gradients plus the weights derivatives.
+vec4 dpnoise(in vec3 pt, in vec3 scaledTileRes) {
+  vec3 g[8];
+  vec3 fpt0;
+  pnoise_gradients(pt, scaledTileRes, g, fpt0);
+  vec3 fpt1 = fpt0 - vec3(1.0f);
+
+  // Calculate gradient's influence
+  float n000 = dot(g[0], fpt0);
+  float n100 = dot(g[1], vec3(fpt1.x, fpt0.yz));
+  float n010 = dot(g[2], vec3(fpt0.x, fpt1.y, fpt0.z));
+  float n110 = dot(g[3], vec3(fpt1.xy, fpt0.z));
+  float n001 = dot(g[4], vec3(fpt0.xy, fpt1.z));
+  float n101 = dot(g[5], vec3(fpt1.x, fpt0.y, fpt1.z));
+  float n011 = dot(g[6], vec3(fpt0.x, fpt1.yz));
+  float n111 = dot(g[7], fpt1);
+
+  float k0 = n000;
+  float k1 = n100 - n000;
+  float k2 = n010 - n000;
+  float k3 = n001 - n000;
+  float k4 = n000 - n100 - n010 + n110;
+  float k5 = n000 - n010 - n001 + n011;
+  float k6 = n000 - n100 - n001 + n101;
+  float k7 = - n000 + n100 + n010 - n110 + n001 - n101 - n011 + n111;
+
+  vec3 ga = g[0];
+  vec3 gb = g[1] - g[0];
+  vec3 gc = g[2] - g[0];
+  vec3 gd = g[4] - g[0];
+  vec3 ge = g[0] - g[1] - g[2] + g[3];
+  vec3 gf = g[0] - g[2] - g[4] + g[6];
+  vec3 gg = g[0] - g[1] - g[4] + g[5];
+  vec3 gh = - g[0] + g[1] + g[2] - g[3] + g[4] - g[5] - g[6] + g[7];
+
+  vec3 u = fade(fpt0);
+  vec3 du = 30.0f*fpt0*fpt0*(fpt0*(fpt0-2.0f)+1.0f);
+
+  vec4 res;
+  res.x = k0 + k1*u.x + k2*u.y + k3*u.z
+      + k4*u.x*u.y + k5*u.y*u.z + k6*u.z*u.x + k7*u.x*u.y*u.z;
+
+  res.yzw = ga + gb*u.x + gc*u.y + gd*u.z
+          + ge*u.x*u.y + gf*u.y*u.z + gg*u.z*u.x + gh*u.x*u.y*u.z
+          + du * vec3(k1 + k4*u.y + k6*u.z + k7*u.y*u.z,
+                      k2 + k5*u.z + k4*u.x + k7*u.z*u.x,
+                      k3 + k6*u.x + k5*u.y + k7*u.x*u.y);
+
+  return res;
+}
+
+vec4 dpnoise(in vec3 pt) {
+  return dpnoise(pt, vec3(0.0f));
+}
+
 // Classical Perlin Noise 2D + time
 float pnoise_loop(in vec2 u, float dt) {
   vec3 pt1 = vec3(u, dt);
@@ -0,0 +1,38 @@
+#ifndef SHADER_RADIX_SORT_GLSL_
+#define SHADER_RADIX_SORT_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Shared helpers of the LSD radix sort kernels.
+//
+//      Keys are sorted in ascending order, one digit per pass starting from
+//      the least significant one. The first pass reads the raw view depths
+//      and flips them to integer keys.
+//
+// ----------------------------------------------------------------------------
+
+// Number of keys to sort.
+uniform uint uNumElements;
+// Position of the digit sorted by this pass.
+uniform uint uDigitShift;
+// True when the keys are the view depths written by the calculate_dp kernel.
+uniform bool uFloatKeys;
+
+// ----------------------------------------------------------------------------
+
+// Map a float to an uint whose ascending order matches the float descending
+// order, so that farther particles come first (back-to-front).
+uint FlipFloatKey(in float value) {
+  const uint bits = floatBitsToUint(value);
+  const uint mask = ((bits & 0x80000000u) != 0u) ? 0xFFFFFFFFu : 0x80000000u;
+  return ~(bits ^ mask);
+}
+
+// Digit of a key for the current pass.
+uint GetDigit(in uint key) {
+  return (key >> uDigitShift) & (RADIX_SORT_NUM_BUCKETS - 1u);
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_RADIX_SORT_GLSL_
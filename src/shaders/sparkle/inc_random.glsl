@@ -0,0 +1,63 @@
+#ifndef SHADER_RANDOM_GLSL_
+#define SHADER_RANDOM_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Counter-based random numbers.
+//
+//      Values are hashed from a (id, frame, stream, seed) key, so no state
+//      nor buffer is needed and a run is reproducible from its seed.
+//
+//      ref : 'Hash Functions for GPU Rendering' - Jarzynski & Olano, JCGT 2020
+//
+// ----------------------------------------------------------------------------
+
+// Seed of the run.
+uniform uint uRandomSeed;
+// Simulation step counter.
+uniform uint uFrameIndex;
+
+// Independent sequences, to decorrelate values used by different features.
+#define RANDOM_STREAM_EMISSION        0u
+#define RANDOM_STREAM_SCATTERING      1u
+// Drawn once on the host, for the perlin noise permutation (see api/random.h).
+#define RANDOM_STREAM_PERLIN_SEED     2u
+
+// ----------------------------------------------------------------------------
+
+// 4D PCG hash.
+uvec4 pcg4d(in uvec4 v);
+
+// Return four uniform values in [0, 1) for an element id on the given stream.
+vec4 random4(in uint id, in uint stream);
+
+// ----------------------------------------------------------------------------
+
+uvec4 pcg4d(in uvec4 v) {
+  v = v * 1664525u + 1013904223u;
+
+  v.x += v.y*v.w;
+  v.y += v.z*v.x;
+  v.z += v.x*v.y;
+  v.w += v.y*v.z;
+
+  v ^= v >> 16u;
+
+  v.x += v.y*v.w;
+  v.y += v.z*v.x;
+  v.z += v.x*v.y;
+  v.w += v.y*v.z;
+
+  return v;
+}
+
+vec4 random4(in uint id, in uint stream) {
+  const uvec4 h = pcg4d(uvec4(id, uFrameIndex, stream, uRandomSeed));
+
+  // Keep the 24 high bits to be exactly representable as float.
+  return vec4(h >> 8u) * (1.0f / 16777216.0f);
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_RANDOM_GLSL_
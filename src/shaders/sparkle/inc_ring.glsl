@@ -0,0 +1,47 @@
+#ifndef SHADER_RING_GLSL_
+#define SHADER_RING_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Ring pool : particles stay in their slot of the first storage buffer,
+//      in emission order from the ring tail.
+//
+//      Emission appends at the head, past the alive count. As lifetimes are
+//      bounded particles mostly die in that order, so the simulation only
+//      finds the first alive one and the tail moves past the dead ones before
+//      it (see cs_ring_advance). Particles dying out of order are masked by a
+//      null age until the tail passes them, instead of being compacted.
+//
+//      Sorting lists the slots in depth order, and the rank of each slot for
+//      the coherent sort.
+//
+// ----------------------------------------------------------------------------
+
+layout(std430, binding = STORAGE_BINDING_RING_STATE)
+coherent buffer RingState {
+  TRingState ring;
+};
+
+layout(std430, binding = STORAGE_BINDING_ALIVE_INDICES_FIRST)
+buffer SortedSlots {
+  uint sorted_slots[];
+};
+
+layout(std430, binding = STORAGE_BINDING_ALIVE_INDICES_SECOND)
+buffer SlotRanks {
+  uint slot_ranks[];
+};
+
+// Depth key of the masked particles, sorted after the alive ones but before
+// the cleared keys past the ring.
+const float kMaskedDepth = -1.0e38f;
+
+// ----------------------------------------------------------------------------
+
+uint RingSlot(in uint index) {
+  return (ring.tail + index) % ring.capacity;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_RING_GLSL_
@@ -0,0 +1,44 @@
+#ifndef SHADER_SCAN_GLSL_
+#define SHADER_SCAN_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Group-wide prefix sum, in shared memory.
+//
+// ----------------------------------------------------------------------------
+
+shared uint s_scan[PARTICLES_KERNEL_GROUP_WIDTH];
+
+// Exclusive prefix sum of one value per invocation over the whole group,
+// total receives the sum of all values.
+// Must be reached by every invocation of the group.
+uint GroupExclusiveScan(in uint value, out uint total) {
+  const uint lid = gl_LocalInvocationID.x;
+
+  s_scan[lid] = value;
+  memoryBarrierShared();
+  barrier();
+
+  // Hillis-Steele inclusive scan.
+  for (uint offset = 1u; offset < PARTICLES_KERNEL_GROUP_WIDTH; offset <<= 1u) {
+    const uint prev = (lid >= offset) ? s_scan[lid - offset] : 0u;
+    memoryBarrierShared();
+    barrier();
+    s_scan[lid] += prev;
+    memoryBarrierShared();
+    barrier();
+  }
+
+  total = s_scan[PARTICLES_KERNEL_GROUP_WIDTH - 1u];
+  const uint inclusive = s_scan[lid];
+
+  // Let every invocation read the results before the array is reused.
+  memoryBarrierShared();
+  barrier();
+
+  return inclusive - value;
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_SCAN_GLSL_
@@ -0,0 +1,226 @@
+#ifndef SHADER_STORAGE_GLSL_
+#define SHADER_STORAGE_GLSL_
+
+// ----------------------------------------------------------------------------
+//
+//      Particles storage, for the layout selected by the host.
+//
+//      AoS     TParticle particles[]
+//      SoA     vec4 positions[], velocities[], attributes[]
+//      AoSoA   vec4 streams[], the three attributes streams interleaved by
+//              blocks of SPARKLE_AOSOA_BLOCK_WIDTH particles
+//      Packed  uvec4 particles[], see inc_packing
+//
+//      The 'A' buffers are the first storage ones, 'B' the second ones.
+//      The attributes stream holds (start_age, age, system bits, id bits).
+//
+// ----------------------------------------------------------------------------
+
+#if SPARKLE_USE_PACKED_LAYOUT
+#include "sparkle/inc_packing.glsl"
+#endif
+
+// Load a particle stored in A.
+TParticle LoadParticleA(in uint index);
+
+// Store a particle in A / B.
+void StoreParticleA(in uint index, in TParticle p);
+void StoreParticleB(in uint index, in TParticle p);
+
+// Load the position of a particle stored in A / B.
+vec3 LoadPositionA(in uint index);
+vec3 LoadPositionB(in uint index);
+
+// Copy a particle from B to A, without conversion.
+void CopyParticleBToA(in uint src_index, in uint dst_index);
+
+// ----------------------------------------------------------------------------
+
+#if SPARKLE_USE_SOA_LAYOUT
+
+layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_A)
+buffer PositionBufferA {
+  vec4 positions_a[];
+};
+layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_A)
+buffer VelocityBufferA {
+  vec4 velocities_a[];
+};
+layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_A)
+buffer AttributeBufferA {
+  vec4 attributes_a[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PARTICLE_POSITIONS_B)
+buffer PositionBufferB {
+  vec4 positions_b[];
+};
+layout(std430, binding = STORAGE_BINDING_PARTICLE_VELOCITIES_B)
+buffer VelocityBufferB {
+  vec4 velocities_b[];
+};
+layout(std430, binding = STORAGE_BINDING_PARTICLE_ATTRIBUTES_B)
+buffer AttributeBufferB {
+  vec4 attributes_b[];
+};
+
+#elif SPARKLE_USE_AOSOA_LAYOUT
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
+buffer ParticleBufferA {
+  vec4 streams_a[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
+buffer ParticleBufferB {
+  vec4 streams_b[];
+};
+
+#elif SPARKLE_USE_PACKED_LAYOUT
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
+buffer ParticleBufferA {
+  uvec4 particles_a[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
+buffer ParticleBufferB {
+  uvec4 particles_b[];
+};
+
+#else
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_FIRST)
+buffer ParticleBufferA {
+  TParticle particles_a[];
+};
+
+layout(std430, binding = STORAGE_BINDING_PARTICLES_SECOND)
+buffer ParticleBufferB {
+  TParticle particles_b[];
+};
+
+#endif
+
+// ----------------------------------------------------------------------------
+
+#if SPARKLE_USE_AOSOA_LAYOUT
+
+#define STREAM_POSITION       0u
+#define STREAM_VELOCITY       1u
+#define STREAM_ATTRIBUTES     2u
+#define NUM_STREAMS           3u
+
+// Index of a particle attribute in its block.
+uint GetStreamIndex(in uint stream, in uint index) {
+  const uint block = index / SPARKLE_AOSOA_BLOCK_WIDTH;
+  const uint lane  = index % SPARKLE_AOSOA_BLOCK_WIDTH;
+  return (block * NUM_STREAMS + stream) * SPARKLE_AOSOA_BLOCK_WIDTH + lane;
+}
+
+#endif
+
+TParticle MakeParticle(in vec4 position, in vec4 velocity, in vec4 attribs) {
+  TParticle p;
+  p.position  = position;
+  p.velocity  = velocity;
+  p.start_age = attribs.x;
+  p.age       = attribs.y;
+  p.system    = floatBitsToUint(attribs.z);
+  p.id        = floatBitsToUint(attribs.w);
+  return p;
+}
+
+vec4 GetAttributes(in TParticle p) {
+  return vec4(p.start_age, p.age, uintBitsToFloat(p.system), uintBitsToFloat(p.id));
+}
+
+// ----------------------------------------------------------------------------
+
+TParticle LoadParticleA(in uint index) {
+#if SPARKLE_USE_SOA_LAYOUT
+  return MakeParticle(positions_a[index], velocities_a[index], attributes_a[index]);
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  return MakeParticle(streams_a[GetStreamIndex(STREAM_POSITION, index)],
+                      streams_a[GetStreamIndex(STREAM_VELOCITY, index)],
+                      streams_a[GetStreamIndex(STREAM_ATTRIBUTES, index)]);
+#elif SPARKLE_USE_PACKED_LAYOUT
+  return UnpackParticle(particles_a[index], index);
+#else
+  return particles_a[index];
+#endif
+}
+
+void StoreParticleA(in uint index, in TParticle p) {
+#if SPARKLE_USE_SOA_LAYOUT
+  positions_a[index]  = p.position;
+  velocities_a[index] = p.velocity;
+  attributes_a[index] = GetAttributes(p);
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  streams_a[GetStreamIndex(STREAM_POSITION, index)]   = p.position;
+  streams_a[GetStreamIndex(STREAM_VELOCITY, index)]   = p.velocity;
+  streams_a[GetStreamIndex(STREAM_ATTRIBUTES, index)] = GetAttributes(p);
+#elif SPARKLE_USE_PACKED_LAYOUT
+  particles_a[index] = PackParticle(p);
+#else
+  particles_a[index] = p;
+#endif
+}
+
+void StoreParticleB(in uint index, in TParticle p) {
+#if SPARKLE_USE_SOA_LAYOUT
+  positions_b[index]  = p.position;
+  velocities_b[index] = p.velocity;
+  attributes_b[index] = GetAttributes(p);
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  streams_b[GetStreamIndex(STREAM_POSITION, index)]   = p.position;
+  streams_b[GetStreamIndex(STREAM_VELOCITY, index)]   = p.velocity;
+  streams_b[GetStreamIndex(STREAM_ATTRIBUTES, index)] = GetAttributes(p);
+#elif SPARKLE_USE_PACKED_LAYOUT
+  particles_b[index] = PackParticle(p);
+#else
+  particles_b[index] = p;
+#endif
+}
+
+vec3 LoadPositionA(in uint index) {
+#if SPARKLE_USE_SOA_LAYOUT
+  return positions_a[index].xyz;
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  return streams_a[GetStreamIndex(STREAM_POSITION, index)].xyz;
+#elif SPARKLE_USE_PACKED_LAYOUT
+  return UnpackPosition(particles_a[index]);
+#else
+  return particles_a[index].position.xyz;
+#endif
+}
+
+vec3 LoadPositionB(in uint index) {
+#if SPARKLE_USE_SOA_LAYOUT
+  return positions_b[index].xyz;
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  return streams_b[GetStreamIndex(STREAM_POSITION, index)].xyz;
+#elif SPARKLE_USE_PACKED_LAYOUT
+  return UnpackPosition(particles_b[index]);
+#else
+  return particles_b[index].position.xyz;
+#endif
+}
+
+void CopyParticleBToA(in uint src_index, in uint dst_index) {
+#if SPARKLE_USE_SOA_LAYOUT
+  positions_a[dst_index]  = positions_b[src_index];
+  velocities_a[dst_index] = velocities_b[src_index];
+  attributes_a[dst_index] = attributes_b[src_index];
+#elif SPARKLE_USE_AOSOA_LAYOUT
+  for (uint stream = 0u; stream < NUM_STREAMS; ++stream) {
+    streams_a[GetStreamIndex(stream, dst_index)] = streams_b[GetStreamIndex(stream, src_index)];
+  }
+#else
+  particles_a[dst_index] = particles_b[src_index];
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+#endif  // SHADER_STORAGE_GLSL_
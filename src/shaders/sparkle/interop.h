@@ -15,17 +15,89 @@
 // Kernel group width used across the particles pipeline.
 #define PARTICLES_KERNEL_GROUP_WIDTH        512u
 
+// Kernel group width (per dimension) used to bake the curl noise texture.
+#define CURLNOISE_BAKE_GROUP_WIDTH          8u
+
+// Elements sorted in shared memory by a bitonic sort group (two per invocation).
+#define SORT_LOCAL_BLOCK_WIDTH              (2u * PARTICLES_KERNEL_GROUP_WIDTH)
+
+// Emitters in the table, the first one is set by the simulation parameters.
+#define MAX_EMITTER_COUNT                   1024u
+
+// Particle systems sharing the pool, the first one is set by the simulation parameters.
+#define MAX_SYSTEM_COUNT                    256u
+
+// TSystem flags, the forces enabled for a system.
+#define SYSTEM_FLAG_SCATTERING              (1u << 0u)
+#define SYSTEM_FLAG_VECTORFIELD             (1u << 1u)
+#define SYSTEM_FLAG_CURLNOISE               (1u << 2u)
+#define SYSTEM_FLAG_VELOCITY_CONTROL        (1u << 3u)
+#define SYSTEM_FLAG_REPULSION               (1u << 4u)
+#define SYSTEM_FLAG_FLUID                   (1u << 5u)
+
+// Radix sort digit size, the 32bit keys are sorted in 32 / RADIX_SORT_DIGIT_BITS passes.
+#define RADIX_SORT_DIGIT_BITS               8u
+#define RADIX_SORT_NUM_BUCKETS              (1u << RADIX_SORT_DIGIT_BITS)
+
+// Cells per axis of the spatial grid at most, its particles being clamped to
+// the border cells when the volume is larger (see SpatialGrid).
+#define SPATIAL_GRID_MAX_RESOLUTION         128u
+
 // ----------------------------------------------------------------------------
 
-// Decide which structure layout to use.
+// Particles storage layout, selected at runtime by the host which prepends
+// one of these to the kernels (see GPUParticle::ParticleLayout).
+// Defaults to an array of structures.
 #ifndef SPARKLE_USE_SOA_LAYOUT
-#define SPARKLE_USE_SOA_LAYOUT              FALSE
+#define SPARKLE_USE_SOA_LAYOUT              0
+#endif
+
+// Array of structures of arrays : attributes streams are interleaved by
+// blocks of SPARKLE_AOSOA_BLOCK_WIDTH particles (see inc_storage).
+#ifndef SPARKLE_USE_AOSOA_LAYOUT
+#define SPARKLE_USE_AOSOA_LAYOUT            0
+#endif
+
+#ifndef SPARKLE_AOSOA_BLOCK_WIDTH
+#define SPARKLE_AOSOA_BLOCK_WIDTH           32u
+#endif
+
+// Particles packed in 16 bytes (see inc_packing), as an array of structures.
+#ifndef SPARKLE_USE_PACKED_LAYOUT
+#define SPARKLE_USE_PACKED_LAYOUT           0
+#endif
+
+#if (SPARKLE_USE_SOA_LAYOUT + SPARKLE_USE_AOSOA_LAYOUT + SPARKLE_USE_PACKED_LAYOUT) > 1
+#error Only one particles layout can be used.
+#endif
+
+// Particles pool, selected at runtime as the layout (see GPUParticle::ParticlePool).
+// The free list pool updates particles in place in the first storage buffer,
+// the alive ones and the free slots being tracked by index lists (see
+// inc_free_list). Defaults to the append / consume pool.
+#ifndef SPARKLE_USE_FREE_LIST
+#define SPARKLE_USE_FREE_LIST               0
+#endif
+
+// The ring pool updates them in place too, in emission order from a tail
+// following the oldest particles, the dead ones being masked until the tail
+// passes them (see inc_ring).
+#ifndef SPARKLE_USE_RING
+#define SPARKLE_USE_RING                    0
+#endif
+
+#if (SPARKLE_USE_FREE_LIST + SPARKLE_USE_RING) > 1
+#error Only one particles pool can be used.
 #endif
 
+// Half size of the cube packed positions are quantized in.
+#define PACKED_POSITION_EXTENT              256.0f
+
 /// @note
 /// GPUParticle should hold all the main buffer objects it uses and give
 /// references to subclasses.
-#if SPARKLE_USE_SOA_LAYOUT
+/// Whole particles buffers share the bindings of the positions streams,
+/// so that every layout uses the same numbering.
 
 #define STORAGE_BINDING_PARTICLE_POSITIONS_A             0
 #define STORAGE_BINDING_PARTICLE_VELOCITIES_A            1
@@ -35,28 +107,42 @@
 #define STORAGE_BINDING_PARTICLE_VELOCITIES_B            4
 #define STORAGE_BINDING_PARTICLE_ATTRIBUTES_B            5
 
-#define STORAGE_BINDING_RANDOM_VALUES                    6
-#define STORAGE_BINDING_INDIRECT_ARGS                    7
-#define STORAGE_BINDING_DOT_PRODUCTS                     8
-#define STORAGE_BINDING_INDICES_FIRST                    9
-#define STORAGE_BINDING_INDICES_SECOND                  10
-
-#define COUNT_STORAGE_BINDING                           11
-
-#else
-
-#define STORAGE_BINDING_PARTICLES_FIRST                  0
-#define STORAGE_BINDING_PARTICLES_SECOND                 1
-
-#define STORAGE_BINDING_RANDOM_VALUES                    2
-#define STORAGE_BINDING_INDIRECT_ARGS                    3
-#define STORAGE_BINDING_DOT_PRODUCTS                     4
-#define STORAGE_BINDING_INDICES_FIRST                    5
-#define STORAGE_BINDING_INDICES_SECOND                   6
-
-#define COUNT_STORAGE_BINDING                            7
-
-#endif
+#define STORAGE_BINDING_PARTICLES_FIRST                  STORAGE_BINDING_PARTICLE_POSITIONS_A
+#define STORAGE_BINDING_PARTICLES_SECOND                 STORAGE_BINDING_PARTICLE_POSITIONS_B
+
+#define STORAGE_BINDING_INDIRECT_ARGS                    6
+#define STORAGE_BINDING_DOT_PRODUCTS                     7
+#define STORAGE_BINDING_INDICES_FIRST                    8
+#define STORAGE_BINDING_INDICES_SECOND                   9
+#define STORAGE_BINDING_SORT_KEYS_FIRST                 10
+#define STORAGE_BINDING_SORT_KEYS_SECOND                11
+#define STORAGE_BINDING_RADIX_HISTOGRAMS                12
+#define STORAGE_BINDING_PREFIX_SUM_DATA                 13
+#define STORAGE_BINDING_PREFIX_SUM_BLOCKS               14
+#define STORAGE_BINDING_PREVIOUS_RANKS                  15
+#define STORAGE_BINDING_RANK_SLOTS                      16
+#define STORAGE_BINDING_SORT_OFFSETS                    17
+#define STORAGE_BINDING_SORT_INSERTIONS                 18
+#define STORAGE_BINDING_SORT_STATE                      19
+#define STORAGE_BINDING_APPEND_COUNTER                  20
+#define STORAGE_BINDING_EMITTERS                        21
+#define STORAGE_BINDING_EMITTER_OFFSETS                 22
+#define STORAGE_BINDING_EMITTER_ACCUMULATORS            23
+#define STORAGE_BINDING_SYSTEMS                         24
+#define STORAGE_BINDING_EMITTER_BURSTS                  25
+#define STORAGE_BINDING_EMISSION_ARGS                   26
+#define STORAGE_BINDING_ALIVE_INDICES_FIRST             27
+#define STORAGE_BINDING_ALIVE_INDICES_SECOND            28
+#define STORAGE_BINDING_FREE_LIST                       29
+#define STORAGE_BINDING_RING_STATE                      30
+#define STORAGE_BINDING_GRID_CELL_OFFSETS               31
+#define STORAGE_BINDING_GRID_PARTICLE_KEYS              32
+#define STORAGE_BINDING_GRID_PARTICLES                  33
+#define STORAGE_BINDING_GRID_NEIGHBOURS                 34
+#define STORAGE_BINDING_FLUID_STATES                    35
+#define STORAGE_BINDING_FLUID_ACCELERATIONS             36
+
+#define COUNT_STORAGE_BINDING                           37
 
 // ----------------------------------------------------------------------------
 
@@ -65,6 +151,10 @@
 
 // ----------------------------------------------------------------------------
 
+#define IMAGE_BINDING_CURLNOISE                          0
+
+// ----------------------------------------------------------------------------
+
 /*
 * [ IMPORTANT ]
 * Data in a ShaderStorage buffer must be layed out using atomic type,
@@ -83,10 +173,58 @@ struct TParticle {
   vec4 velocity;
   float start_age;
   float age;
-  float _padding0;
+  uint system;          //< index in the systems table.
   uint id;
 };
 
+// Quantized particle, see inc_packing for its layout.
+struct TPackedParticle {
+  uvec4 data;
+};
+
+// Entry of the emitters table.
+struct TEmitter {
+  vec4 position;        //< xyz : center, w : radius.
+  vec4 direction;       //< xyz : initial velocity.
+  float rate;           //< particles per second, 0 or less emits the whole budget.
+  float min_age;
+  float max_age;
+  uint type;            //< GPUParticle::EmitterType.
+  uint system;          //< system of the emitted particles.
+  uint _padding0;
+  uint _padding1;
+  uint _padding2;
+};
+
+// Entry of the systems table, parameters of the forces applied to its particles.
+struct TSystem {
+  float scattering_factor;
+  float vectorfield_factor;
+  float curlnoise_factor;
+  float velocity_factor;
+  float bbox_size;
+  int bounding_volume;  //< GPUParticle::SimulationVolume.
+  uint flags;           //< SYSTEM_FLAG_* bits.
+  float repulsion_factor;
+};
+
+// State kept between frames by the temporally coherent sort.
+struct TSortState {
+  uint sorted_count;    //< particles sorted by the previous frame.
+  uint num_survivors;   //< those still alive, placed before the emitted ones.
+  uint out_of_order;    //< adjacent pairs in the wrong order (error metric).
+  uint _padding0;
+};
+
+// State of the ring pool, the particles span from its tail to the alive count.
+struct TRingState {
+  uint tail;            //< slot of the oldest particle.
+  uint capacity;        //< slots of the pool.
+  uint first_alive;     //< ring index of the first alive particle, reduced by the simulation.
+  uint _padding0;
+  uvec4 draws[2];       //< DrawArraysIndirect commands, the ring being split where it wraps.
+};
+
 #undef SHADER_UINT
 
 // ----------------------------------------------------------------------------
@@ -2,9 +2,19 @@
 
 // ----------------------------------------------------------------------------
 
-layout(location=0) in vec3 position;
+// The particles layout is set by the host (see interop), the default one
+// is also used by the CPU backend.
+#include "sparkle/interop.h"
+
+#if SPARKLE_USE_AOSOA_LAYOUT
+// Interleaved blocks can't be described by vertex formats, particles are
+// pulled from the storage buffer instead.
+#include "sparkle/inc_storage.glsl"
+#else
+layout(location=0) in vec4 position;  // w : rewind weight (see cs_simulation).
 layout(location=1) in vec3 velocity;
 layout(location=2) in vec2 age_info;
+#endif
 
 uniform mat4 uMVP;
 uniform float uMinParticleSize = 1.0f; //
@@ -12,6 +22,14 @@ uniform float uMaxParticleSize = 6.0f; //
 uniform float uColorMode = 0;
 uniform vec3 uBirthGradient = vec3(1.0f, 0.0f, 0.0f);
 uniform vec3 uDeathGradient = vec3(0.0f);
+// Simulation time between the last simulated state and the rendered one.
+uniform float uRewindTime = 0.0f;
+
+#if SPARKLE_USE_PACKED_LAYOUT
+// Volume of the main system, the only one of packed particles.
+uniform int uBoundingVolume = 0;
+uniform float uBoundingVolumeSize = 1.0f;
+#endif
 
 out VDataBlock {
   vec3 position;
@@ -23,6 +41,20 @@ out VDataBlock {
 
 // ----------------------------------------------------------------------------
 
+#if SPARKLE_USE_PACKED_LAYOUT
+/* Keep a position inside the simulation volume, as the collisions do. */
+vec3 clamp_to_volume(in vec3 p) {
+  const float r = 0.5f * uBoundingVolumeSize;
+  if (uBoundingVolume == 0) {
+    const float d = length(p);
+    return (d > r) ? (r / d) * p : p;
+  }
+  return clamp(p, vec3(-r), vec3(r));
+}
+#endif
+
+// ----------------------------------------------------------------------------
+
 /* Map a range from [edge0, edge1] to [0, 1]. */
 float maprange(float edge0, float edge1, float x) {
   return clamp((x - edge0) / (edge1 - edge0), 0.0, 1.0);
@@ -75,10 +107,51 @@ vec3 base_color(in vec3 position, in float decay) {
 // ----------------------------------------------------------------------------
 
 void main() {
-  const vec3 p = position.xyz;
-
-  // Time alived in [0, 1].
-  const float dAge = 1.0f - maprange(0.0f, age_info.x, age_info.y);
+#if SPARKLE_USE_AOSOA_LAYOUT
+  const TParticle particle = LoadParticleA(uint(gl_VertexID));
+  const vec4 position = particle.position;
+  const vec3 velocity = particle.velocity.xyz;
+  const vec2 age_info = vec2(particle.start_age, particle.age);
+#endif
+
+#if SPARKLE_USE_RING
+  // Particles dead out of order are masked in the ring pool by a null age,
+  // they are sent out of the clip volume (and skipped by the geometry shader).
+#if SPARKLE_USE_PACKED_LAYOUT
+  const bool masked = (age_info.x <= 0.0f);
+#else
+  const bool masked = (age_info.y <= 0.0f);
+#endif
+  if (masked) {
+    gl_Position = vec4(0.0f, 0.0f, 2.0f, 1.0f);
+    OUT.decay = -1.0f;
+    return;
+  }
+#endif
+
+#if SPARKLE_USE_PACKED_LAYOUT
+  // Packed particles (see inc_packing) give their position in [0, 1] and
+  // age_info.x as the age to start age ratio.
+  const vec3 last_position = (2.0f * position.xyz - 1.0f) * PACKED_POSITION_EXTENT;
+  const float rewind_weight = 1.0f;
+  const float dAge = 1.0f - age_info.x;
+#else
+  const vec3 last_position = position.xyz;
+  const float rewind_weight = position.w;
+
+  // Time alived in [0, 1], ages count down.
+  const float dAge = 1.0f - maprange(0.0f, age_info.x, age_info.y + uRewindTime);
+#endif
+
+  // Positions are integrated with the updated velocity, so stepping back
+  // along it interpolates between the last two simulated states, unless the
+  // particle bounced on its volume during the last step : its rewind weight
+  // is then null and it is shown at its last position. Packed particles
+  // keep no weight and are clamped to the volume instead.
+  vec3 p = last_position - (uRewindTime * rewind_weight) * velocity.xyz;
+#if SPARKLE_USE_PACKED_LAYOUT
+  p = clamp_to_volume(p);
+#endif
   const float decay = curve_inout(dAge, 0.55f);
 
   // Vertex attributes.
@@ -88,7 +161,7 @@ void main() {
   // Output parameters.
   OUT.position = p;
   OUT.velocity = velocity.xyz;
-  OUT.color = base_color(position, decay);
+  OUT.color = base_color(p, decay);
   OUT.decay = decay;
   OUT.pointSize = gl_PointSize;
 }
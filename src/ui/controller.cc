@@ -4,6 +4,7 @@
 #include "imgui.h"
 #include "glfw.h"
 #include "opengl.h"
+#include "api/cpu_trace.h"
 #include "ui/view.h"
 
 
@@ -59,6 +60,8 @@ void UIController::deinit() {
 }
 
 void UIController::update() {
+  CPU_TRACE_SCOPE("UIController::update");
+
   if (!device_.fontTexture) {
     create_device_objects();
   }
@@ -148,6 +151,8 @@ void UIController::update() {
 }
 
 void UIController::render() {
+  CPU_TRACE_SCOPE("UIController::render");
+
   if (!mainview_ptr_) {
     return;
   }
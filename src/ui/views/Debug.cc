@@ -1,8 +1,12 @@
 #include "ui/views/Debug.h"
 #include "imgui.h"
+#include "api/cpu_trace.h"
 
 namespace views {
 
+constexpr int Debug::kMinPoolCapacityLog2;
+constexpr int Debug::kMaxPoolCapacityLog2;
+
 void Debug::render() {
   if (!ImGui::CollapsingHeader("Debug")) {
     return;
@@ -12,6 +16,73 @@ void Debug::render() {
   ImGui::Checkbox("Show emitter", &params_.show_emitter);
   ImGui::Checkbox("Show simulation volume", &params_.show_simulation_volume);
   ImGui::Checkbox("Freeze", &params_.freeze);
+  ImGui::Checkbox("Synchronous readback", &params_.sync_readback);
+  ImGui::Checkbox("Benchmark sorting", &params_.benchmark_sorting);
+  ImGui::Checkbox("Fused pipeline", &params_.fused_pipeline);
+  ImGui::SliderInt("Extra emitters", &params_.extra_emitters, 0, static_cast<int>(GPUParticle::kMaxEmitterCount) - 1);
+  ImGui::SliderInt("Extra systems", &params_.extra_systems, 0, static_cast<int>(GPUParticle::kMaxSystemCount) - 1);
+  if (params_.gpu_simulation) {
+    // Power of two stepped, each change reallocates the pool. The initial
+    // capacity is kept until edited, even outside the range.
+    if (ImGui::InputInt("Pool capacity (log2)", &params_.pool_capacity_log2)) {
+      Clamp(params_.pool_capacity_log2, kMinPoolCapacityLog2, kMaxPoolCapacityLog2);
+    }
+    ImGui::SameLine();
+    ImGui::Text("%u", 1u << params_.pool_capacity_log2);
+  }
+
+#if USE_CPU_TRACE
+  // CPU zones, viewable in chrome://tracing or Perfetto.
+  ImGui::Checkbox("CPU trace", &params_.cpu_trace);
+  ImGui::SameLine();
+  if (ImGui::Button("Dump trace")) {
+    DumpCPUTrace("cpu_trace.json");
+    ClearCPUTrace();
+  }
+  if (GetCPUTraceDroppedCount() > 0u) {
+    ImGui::Text("%u zones dropped", GetCPUTraceDroppedCount());
+  }
+#endif
+
+  // Estimated memory traffic per frame of both pipelines, and the pool memory.
+  {
+    double const kBytesToMB = 1.0 / (1024.0 * 1024.0);
+    auto const& traffic = params_.pipeline_traffic;
+    ImGui::Text("Split %.2f MB | Fused %.2f MB", traffic.split_bytes * kBytesToMB, traffic.fused_bytes * kBytesToMB);
+    ImGui::Text("Saved %.2f MB/frame", (traffic.split_bytes - traffic.fused_bytes) * kBytesToMB);
+    ImGui::Text("Pool %.2f MB", traffic.pool_bytes * kBytesToMB);
+  }
+
+  // GPU timings per stage, over the last samples.
+  GPUProfiler *profiler = params_.profiler;
+  if (profiler && ImGui::TreeNode("GPU profiler")) {
+    ImGui::Columns(4, "profiler");
+    ImGui::Text("stage"); ImGui::NextColumn();
+    ImGui::Text("min ms"); ImGui::NextColumn();
+    ImGui::Text("avg ms"); ImGui::NextColumn();
+    ImGui::Text("p99 ms"); ImGui::NextColumn();
+    ImGui::Separator();
+    for (unsigned int i = 0u; i < profiler->num_sections(); ++i) {
+      auto const& stats = profiler->statistics(i);
+      if (stats.num_samples == 0u) {
+        continue;
+      }
+      ImGui::Text("%s", profiler->name(i)); ImGui::NextColumn();
+      ImGui::Text("%.3f", stats.min_ms); ImGui::NextColumn();
+      ImGui::Text("%.3f", stats.avg_ms); ImGui::NextColumn();
+      ImGui::Text("%.3f", stats.p99_ms); ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    if (ImGui::Button("Dump CSV")) {
+      profiler->dump_csv("gpu_profile.csv");
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Dump JSON")) {
+      profiler->dump_json("gpu_profile.json");
+    }
+    ImGui::TreePop();
+  }
 }
 
 }  // namespace views
@@ -11,6 +11,10 @@ class Debug : public ParametrizedUIView<Scene::DebugParameters_t> {
   Debug(TParameters &params) : ParametrizedUIView(params) {}
 
   void render() override;
+
+ private:
+  static constexpr int kMinPoolCapacityLog2 = 12;
+  static constexpr int kMaxPoolCapacityLog2 = 22;
 };
 
 }  // namespace views
@@ -23,6 +23,12 @@ const char *Rendering::kColorModeDescriptions[] = {
   "Gradient"
 };
 
+const char *Rendering::kSortEngineDescriptions[] = {
+  "Bitonic",
+  "Radix",
+  "Coherent"
+};
+
 void Rendering::render() {
   if (!ImGui::CollapsingHeader("Rendering")) {
     return;
@@ -67,6 +73,19 @@ void Rendering::render() {
     ImGui::TreePop();
   }
 
+  if (ImGui::TreeNode("Blending")) {
+    ImGui::Checkbox("Alpha blending", &params_.enable_alpha_blending);
+    if (params_.enable_alpha_blending) {
+      ImGui::Combo("Sorting", reinterpret_cast<int*>(&params_.sort_engine),
+        kSortEngineDescriptions, IM_ARRAYSIZE(kSortEngineDescriptions));
+      if (GPUParticle::SORT_COHERENT == params_.sort_engine) {
+        ImGui::SliderInt("Passes", &params_.coherent_sort_passes,
+          kCoherentSortPassesMin, kCoherentSortPassesMax);
+      }
+    }
+    ImGui::TreePop();
+  }
+
 }
 
 }  // namespace views
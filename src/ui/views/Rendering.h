@@ -15,6 +15,7 @@ class Rendering : public ParametrizedUIView<GPUParticle::RenderingParameters_t>
 private:
   static const char *kRenderModeDescriptions[GPUParticle::kNumRenderMode];
   static const char *kColorModeDescriptions[GPUParticle::kNumColorMode];
+  static const char *kSortEngineDescriptions[GPUParticle::kNumSortEngine];
 
   static constexpr float kParticleSizeStep = 0.25f;
   static constexpr float kParticleSizeMin = 0.0f;
@@ -27,6 +28,9 @@ private:
   static constexpr float kFadingFactorStep = 0.005f;
   static constexpr float kFadingFactorMin = 0.005f;
   static constexpr float kFadingFactorMax = 1.0f;
+
+  static constexpr int kCoherentSortPassesMin = 0;
+  static constexpr int kCoherentSortPassesMax = 16;
 };
 
 }  // namespace views
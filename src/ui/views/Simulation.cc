@@ -16,12 +16,31 @@ const char *Simulation::kSimulationVolumeDescriptions[] = {
   "None"
 };
 
+const char *Simulation::kCurlNoiseMethodDescriptions[] = {
+  "Analytic",
+  "Finite differences",
+  "Baked texture"
+};
+
 constexpr float Simulation::kTimestepFactorStep;
 constexpr float Simulation::kTimestepFactorMin;
 constexpr float Simulation::kTimestepFactorMax;
+constexpr int Simulation::kSimulationRateMax;
+constexpr int Simulation::kMaxSubstepsMax;
+constexpr float Simulation::kSimulationSizeMin;
+constexpr float Simulation::kSimulationSizeMax;
 constexpr float Simulation::kForceFactorStep;
 constexpr float Simulation::kForceFactorMin;
 constexpr float Simulation::kForceFactorMax;
+constexpr float Simulation::kRepulsionRadiusStep;
+constexpr float Simulation::kRepulsionRadiusMin;
+constexpr float Simulation::kRepulsionRadiusMax;
+constexpr float Simulation::kFluidRadiusStep;
+constexpr float Simulation::kFluidRadiusMin;
+constexpr float Simulation::kFluidRadiusMax;
+constexpr float Simulation::kFluidParameterStep;
+constexpr float Simulation::kFluidParameterMin;
+constexpr float Simulation::kFluidParameterMax;
 
 void Simulation::render() {
   if (!ImGui::CollapsingHeader("Simulation")) {
@@ -32,9 +51,23 @@ void Simulation::render() {
     kTimestepFactorStep, kTimestepFactorMin, kTimestepFactorMax);
   Clamp(params_.time_step_factor, kTimestepFactorMin, kTimestepFactorMax);
 
+  // Fixed simulation rate, 0 simulates once per frame.
+  ImGui::InputInt("Rate (Hz)", &params_.simulation_rate, 30, 60);
+  Clamp(params_.simulation_rate, 0, kSimulationRateMax);
+  if (params_.simulation_rate > 0) {
+    ImGui::SliderInt("Max substeps", &params_.max_substeps, 1, kMaxSubstepsMax);
+  }
+
+  ImGui::InputInt("Seed", &params_.random_seed);
+
   if (ImGui::TreeNode("Emitter")) {
     ImGui::Combo("Type", reinterpret_cast<int*>(&params_.emitter_type),
       kEmitterTypeDescriptions, IM_ARRAYSIZE(kEmitterTypeDescriptions));
+    ImGui::DragFloat("Rate", &params_.emission_rate, kEmissionRateStep, 0.0f, kEmissionRateMax,
+      (params_.emission_rate > 0.0f) ? "%.0f / s" : "budget");
+    if (ImGui::Button("Burst")) {
+      params_.burst_count += kBurstCount;
+    }
     ImGui::DragFloatRange2("Age range", &params_.min_age, &params_.max_age,
       kAgeRangeStep, kAgeRangeMin, kAgeRangeMax, "Min: %.2f", "Max: %.2f");
     ImGui::DragFloat3("Position", params_.emitter_position, 0.25f);
@@ -58,7 +91,8 @@ void Simulation::render() {
     ImGui::Combo("Type", reinterpret_cast<int*>(&params_.bounding_volume),
       kSimulationVolumeDescriptions, IM_ARRAYSIZE(kSimulationVolumeDescriptions));
     ImGui::DragFloat("Size", &params_.bounding_volume_size,
-      kSimulationSizeStep, kSimulationSizeMin, kSimulationSizeMax);
+      kSimulationSizeStep, kSimulationSizeMin, max_volume_size_);
+    Clamp(params_.bounding_volume_size, kSimulationSizeMin, max_volume_size_);
     ImGui::TreePop();
   }
 
@@ -81,6 +115,12 @@ void Simulation::render() {
         kForceFactorStep, kForceFactorMin, kForceFactorMax);
       ImGui::DragFloat("scale", &params_.curlnoise_scale,
         kCurlnoiseScaleStep, kCurlnoiseScaleMin, kCurlnoiseScaleMax);
+      ImGui::Combo("method", reinterpret_cast<int*>(&params_.curlnoise_method),
+        kCurlNoiseMethodDescriptions, IM_ARRAYSIZE(kCurlNoiseMethodDescriptions));
+      if (params_.curlnoise_method == GPUParticle::CURLNOISE_BAKED) {
+        ImGui::SliderInt("resolution", &params_.curlnoise_resolution,
+          kCurlnoiseResolutionMin, kCurlnoiseResolutionMax);
+      }
     }
 
     ImGui::Checkbox("Velocity Control", &params_.enable_velocity_control);
@@ -89,6 +129,32 @@ void Simulation::render() {
         kForceFactorStep, kForceFactorMin, kForceFactorMax);
     }
 
+    // Neighbours are found through a grid whose cells are the radius.
+    ImGui::Checkbox("Repulsion", &params_.enable_repulsion);
+    if (params_.enable_repulsion) {
+      ImGui::DragFloat("repulsion factor", &params_.repulsion_factor,
+        kForceFactorStep, kForceFactorMin, kForceFactorMax);
+      ImGui::DragFloat("radius", &params_.repulsion_radius,
+        kRepulsionRadiusStep, kRepulsionRadiusMin, kRepulsionRadiusMax);
+      Clamp(params_.repulsion_radius, kRepulsionRadiusMin, kRepulsionRadiusMax);
+    }
+
+    // Shares the grid with the repulsion, its cells being the largest radius.
+    ImGui::Checkbox("Fluid (SPH)", &params_.enable_fluid);
+    if (params_.enable_fluid) {
+      ImGui::DragFloat("smoothing radius", &params_.fluid_radius,
+        kFluidRadiusStep, kFluidRadiusMin, kFluidRadiusMax);
+      Clamp(params_.fluid_radius, kFluidRadiusMin, kFluidRadiusMax);
+      ImGui::DragFloat("rest density", &params_.fluid_rest_density,
+        kFluidParameterStep, kFluidParameterMin, kFluidParameterMax);
+      ImGui::DragFloat("stiffness", &params_.fluid_stiffness,
+        kFluidParameterStep, kFluidParameterMin, kFluidParameterMax);
+      ImGui::DragFloat("viscosity", &params_.fluid_viscosity,
+        kFluidParameterStep, kFluidParameterMin, kFluidParameterMax);
+      ImGui::DragFloat("gravity", &params_.fluid_gravity,
+        kFluidParameterStep, -kFluidParameterMax, kFluidParameterMax);
+    }
+
     ImGui::TreePop();
   }
 }
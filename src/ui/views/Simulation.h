@@ -1,6 +1,7 @@
 #ifndef SPARKLE_UI_VIEWS_SIMULATION_H_
 #define SPARKLE_UI_VIEWS_SIMULATION_H_
 
+#include <algorithm>
 #include "ui/view.h"
 #include "api/gpu_particle.h"
 
@@ -8,17 +9,28 @@ namespace views {
 
 class Simulation : public ParametrizedUIView<GPUParticle::SimulationParameters_t> {
  public:
-  Simulation(TParameters &params) : ParametrizedUIView(params) {}
+  /// max_volume_size caps the bounding volume size, for layouts covering a
+  /// bounded domain (see GPUParticle::max_bounding_volume_size).
+  Simulation(TParameters &params, float const max_volume_size = kSimulationSizeMax)
+    : ParametrizedUIView(params),
+      max_volume_size_(std::min(max_volume_size, kSimulationSizeMax))
+  {}
 
   void render() override;
 
  private:
   static const char *kEmitterTypeDescriptions[GPUParticle::kNumEmitterType];
   static const char *kSimulationVolumeDescriptions[GPUParticle::kNumSimulationVolume];
+  static const char *kCurlNoiseMethodDescriptions[GPUParticle::kNumCurlNoiseMethod];
 
   static constexpr float kTimestepFactorStep = 0.025f;
   static constexpr float kTimestepFactorMin = -20.0f;
   static constexpr float kTimestepFactorMax = 20.0f;
+  static constexpr int kSimulationRateMax = 480;
+  static constexpr int kMaxSubstepsMax = 16;
+  static constexpr float kEmissionRateStep = 100.0f;
+  static constexpr float kEmissionRateMax = 1.0e6f;
+  static constexpr int kBurstCount = 16384;
   static constexpr float kAgeRangeStep = 0.05f;
   static constexpr float kAgeRangeMin = 0.05f;
   static constexpr float kAgeRangeMax = 50.0f;
@@ -33,9 +45,25 @@ class Simulation : public ParametrizedUIView<GPUParticle::SimulationParameters_t
   static constexpr float kForceFactorMin = 0.0f;
   static constexpr float kForceFactorMax = +50.0f;
 
+  static constexpr float kRepulsionRadiusStep = 0.05f;
+  static constexpr float kRepulsionRadiusMin = 0.5f;
+  static constexpr float kRepulsionRadiusMax = 32.0f;
+
+  static constexpr float kFluidRadiusStep = 0.05f;
+  static constexpr float kFluidRadiusMin = 0.5f;
+  static constexpr float kFluidRadiusMax = 32.0f;
+  static constexpr float kFluidParameterStep = 0.01f;
+  static constexpr float kFluidParameterMin = 0.0f;
+  static constexpr float kFluidParameterMax = 1000.0f;
+
   static constexpr float kCurlnoiseScaleStep = 0.005f;
   static constexpr float kCurlnoiseScaleMin = 1.0f;
   static constexpr float kCurlnoiseScaleMax = 1024.0f;
+
+  static constexpr int kCurlnoiseResolutionMin = static_cast<int>(CurlNoiseField::kMinResolution);
+  static constexpr int kCurlnoiseResolutionMax = static_cast<int>(CurlNoiseField::kMaxResolution);
+
+  float const max_volume_size_;
 };
 
 }  // namespace views